@@ -17,6 +17,14 @@
 #include "../src/sound.h"
 #include "../src/globals.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STEREO_SSE2 1
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define STEREO_NEON 1
+#endif
+
 static retro_log_printf_t log_cb;
 static retro_video_refresh_t video_cb;
 static retro_input_poll_t poll_cb;
@@ -34,6 +42,13 @@ uint8_t libretro_save_buf[0x20000 + 0x2000];	/* Workaround for broken-by-design
 
 static unsigned libretro_save_size = sizeof(libretro_save_buf);
 
+/* Core specific memory id of the 240x160 depth plane of the left eye, see
+ * depth_plane in gba.h for the meaning of each byte. Only available while
+ * the vbanext3d_depth_plane option is enabled. */
+#define RETRO_MEMORY_VBANEXT3D_DEPTH ((1 << 8) | RETRO_MEMORY_VIDEO_RAM)
+
+static bool depth_plane_exposed;
+
 void *retro_get_memory_data(unsigned id)
 {
    if (id == RETRO_MEMORY_SAVE_RAM)
@@ -42,6 +57,8 @@ void *retro_get_memory_data(unsigned id)
       return workRAM;
    if (id == RETRO_MEMORY_VIDEO_RAM)
       return vram;
+   if (id == RETRO_MEMORY_VBANEXT3D_DEPTH && depth_plane_exposed)
+      return depth_plane;
 
    return NULL;
 }
@@ -54,6 +71,8 @@ size_t retro_get_memory_size(unsigned id)
       return 0x40000;
    if (id == RETRO_MEMORY_VIDEO_RAM)
       return 0x20000;
+   if (id == RETRO_MEMORY_VBANEXT3D_DEPTH && depth_plane_exposed)
+      return sizeof(depth_plane);
 
    return 0;
 }
@@ -162,13 +181,60 @@ void retro_get_system_info(struct retro_system_info *info)
    info->block_extract = false;
 }
 
+enum
+{
+   STEREO_LAYOUT_SIDE_BY_SIDE = 0,
+   STEREO_LAYOUT_SIDE_BY_SIDE_HALF,
+   STEREO_LAYOUT_TOP_BOTTOM,
+   STEREO_LAYOUT_ROW_INTERLEAVED,
+   STEREO_LAYOUT_ANAGLYPH,
+   STEREO_LAYOUT_MONO,
+   STEREO_LAYOUT_MULTIVIEW
+};
+
+static unsigned stereo_layout = STEREO_LAYOUT_SIDE_BY_SIDE;
+static unsigned multiview_count = 4;
+static uint16_t stereo_frame[MAX_STEREO_VIEWS * 240 * 160];
+
+/* The multi-view atlas holds up to four views in one row and splits more
+ * over two rows, view 0 in the top left corner. */
+static unsigned multiview_columns(void)
+{
+   return multiview_count <= 4 ? multiview_count : (multiview_count + 1) / 2;
+}
+
+static unsigned multiview_rows(void)
+{
+   return multiview_count <= 4 ? 1 : 2;
+}
+
+static void get_stereo_geometry(struct retro_game_geometry *geometry)
+{
+   geometry->base_width = 240;
+   geometry->base_height = 160;
+   geometry->max_width = 240 * (MAX_STEREO_VIEWS / 2);
+   geometry->max_height = 320;
+   geometry->aspect_ratio = 3.0 / 2.0;
+
+   switch (stereo_layout)
+   {
+      case STEREO_LAYOUT_SIDE_BY_SIDE:
+         geometry->base_width = 480;
+         break;
+      case STEREO_LAYOUT_TOP_BOTTOM:
+      case STEREO_LAYOUT_ROW_INTERLEAVED:
+         geometry->base_height = 320;
+         break;
+      case STEREO_LAYOUT_MULTIVIEW:
+         geometry->base_width = 240 * multiview_columns();
+         geometry->base_height = 160 * multiview_rows();
+         break;
+   }
+}
+
 void retro_get_system_av_info(struct retro_system_av_info *info)
 {
-   info->geometry.base_width = 480;
-   info->geometry.base_height = 160;
-   info->geometry.max_width = 480;
-   info->geometry.max_height = 160;
-   info->geometry.aspect_ratio = 3.0 / 2.0;
+   get_stereo_geometry(&info->geometry);
    info->timing.fps =  16777216.0 / 280896.0;
    info->timing.sample_rate = 32000.0;
 }
@@ -415,6 +481,53 @@ static int get_parallax_code(void)
 	return 0;
 }
 
+static unsigned get_stereo_layout_code(void)
+{
+	struct retro_variable var;
+
+	var.key = "vbanext3d_stereo_layout";
+	var.value = NULL;
+
+	if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+	{
+		if (strcmp(var.value, "side-by-side-half") == 0) return STEREO_LAYOUT_SIDE_BY_SIDE_HALF;
+		if (strcmp(var.value, "top-bottom") == 0) return STEREO_LAYOUT_TOP_BOTTOM;
+		if (strcmp(var.value, "row-interleaved") == 0) return STEREO_LAYOUT_ROW_INTERLEAVED;
+		if (strcmp(var.value, "anaglyph") == 0) return STEREO_LAYOUT_ANAGLYPH;
+		if (strcmp(var.value, "mono") == 0) return STEREO_LAYOUT_MONO;
+		if (strcmp(var.value, "multi-view") == 0) return STEREO_LAYOUT_MULTIVIEW;
+	}
+	return STEREO_LAYOUT_SIDE_BY_SIDE;
+}
+
+static unsigned get_multiview_count_code(void)
+{
+	struct retro_variable var;
+
+	var.key = "vbanext3d_multiview_count";
+	var.value = NULL;
+
+	if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+	{
+		unsigned count = strtoul(var.value, NULL, 10);
+		if (count >= 4 && count <= MAX_STEREO_VIEWS)
+			return count;
+	}
+	return 4;
+}
+
+static bool get_depth_plane_code(void)
+{
+	struct retro_variable var;
+
+	var.key = "vbanext3d_depth_plane";
+	var.value = NULL;
+
+	if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+		return strcmp(var.value, "enabled") == 0;
+	return false;
+}
+
 #if USE_FRAME_SKIP
 static int get_frameskip_code(void)
 {
@@ -537,19 +650,43 @@ static const unsigned binds2[] = {
 
 static unsigned has_frame;
 
-static void update_variables(void)
+static void update_variables(bool startup)
 {
 #if USE_FRAME_SKIP
    SetFrameskip(get_frameskip_code());
 #endif
 	SetParallax(get_parallax_code());
+
+	depth_plane_exposed = get_depth_plane_code();
+	SetDepthPlane(depth_plane_exposed);
+
+	unsigned layout = get_stereo_layout_code();
+	unsigned count = get_multiview_count_code();
+	if (layout != stereo_layout || count != multiview_count || startup)
+	{
+		stereo_layout = layout;
+		multiview_count = count;
+		if (stereo_layout == STEREO_LAYOUT_MONO)
+			SetStereoViews(1);
+		else if (stereo_layout == STEREO_LAYOUT_MULTIVIEW)
+			SetStereoViews(multiview_count);
+		else
+			SetStereoViews(2);
+
+		if (!startup)
+		{
+			struct retro_game_geometry geometry;
+			get_stereo_geometry(&geometry);
+			environ_cb(RETRO_ENVIRONMENT_SET_GEOMETRY, &geometry);
+		}
+	}
 }
 
 void retro_run(void)
 {
    bool updated = false;
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &updated) && updated)
-      update_variables();
+      update_variables(false);
 
    poll_cb();
 
@@ -661,7 +798,7 @@ void retro_cheat_set(unsigned index, bool enabled, const char *code)
 
 bool retro_load_game(const struct retro_game_info *game)
 {
-   update_variables();
+   update_variables(true);
 
    struct retro_input_descriptor desc[] = {
       { 0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_LEFT,  "D-Pad Left" },
@@ -774,19 +911,131 @@ void systemOnWriteDataToSoundBuffer(int16_t *finalWave, int length)
    g_audio_frames += frames;
 }
 
+/* Per-channel average of two pixels; the mask drops each channel's lowest
+ * bit so the halved difference cannot borrow from its neighbour. */
+#define STEREO_AVERAGE_MASK ((RED_MASK | GREEN_MASK | BLUE_MASK) & ~((1 << RED_SHIFT) | (1 << GREEN_SHIFT) | (1 << BLUE_SHIFT)))
+#define STEREO_ANAGLYPH_CYAN_MASK (GREEN_MASK | BLUE_MASK)
+
+/* Squeezes one 240 pixel eye line into 120 pixels by averaging pixel pairs. */
+static void stereo_halve_line(uint16_t *dst, const uint16_t *src)
+{
+#if STEREO_SSE2
+   const __m128i mask = _mm_set1_epi16(STEREO_AVERAGE_MASK);
+   for (int x = 0; x < 240; x += 16, src += 16, dst += 8)
+   {
+      __m128i a    = _mm_loadu_si128((const __m128i*)src);
+      __m128i b    = _mm_loadu_si128((const __m128i*)(src + 8));
+      __m128i even = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+      __m128i odd  = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+      __m128i avg  = _mm_add_epi16(_mm_and_si128(even, odd), _mm_srli_epi16(_mm_and_si128(_mm_xor_si128(even, odd), mask), 1));
+      _mm_storeu_si128((__m128i*)dst, avg);
+   }
+#elif STEREO_NEON
+   const uint16x8_t mask = vdupq_n_u16(STEREO_AVERAGE_MASK);
+   for (int x = 0; x < 240; x += 16, src += 16, dst += 8)
+   {
+      uint16x8x2_t p = vld2q_u16(src);
+      uint16x8_t avg = vaddq_u16(vandq_u16(p.val[0], p.val[1]), vshrq_n_u16(vandq_u16(veorq_u16(p.val[0], p.val[1]), mask), 1));
+      vst1q_u16(dst, avg);
+   }
+#else
+   for (int x = 0; x < 120; x++, src += 2)
+      dst[x] = (src[0] & src[1]) + (((src[0] ^ src[1]) & STEREO_AVERAGE_MASK) >> 1);
+#endif
+}
+
+/* Red channel from the left eye, green and blue from the right eye. */
+static void stereo_anaglyph_line(uint16_t *dst, const uint16_t *left, const uint16_t *right)
+{
+#if STEREO_SSE2
+   const __m128i red  = _mm_set1_epi16(RED_MASK);
+   const __m128i cyan = _mm_set1_epi16(STEREO_ANAGLYPH_CYAN_MASK);
+   for (int x = 0; x < 240; x += 8)
+   {
+      __m128i l = _mm_loadu_si128((const __m128i*)(left + x));
+      __m128i r = _mm_loadu_si128((const __m128i*)(right + x));
+      _mm_storeu_si128((__m128i*)(dst + x), _mm_or_si128(_mm_and_si128(l, red), _mm_and_si128(r, cyan)));
+   }
+#elif STEREO_NEON
+   const uint16x8_t red  = vdupq_n_u16(RED_MASK);
+   const uint16x8_t cyan = vdupq_n_u16(STEREO_ANAGLYPH_CYAN_MASK);
+   for (int x = 0; x < 240; x += 8)
+      vst1q_u16(dst + x, vorrq_u16(vandq_u16(vld1q_u16(left + x), red), vandq_u16(vld1q_u16(right + x), cyan)));
+#else
+   for (int x = 0; x < 240; x++)
+      dst[x] = (left[x] & RED_MASK) | (right[x] & STEREO_ANAGLYPH_CYAN_MASK);
+#endif
+}
+
 void systemDrawScreen(void)
 {
-	for (int x = 0; x < 256; x++){
-	for (int y = 0; y < 160; y++){
-		
-			if (x < 240){
-			fix[((x) + (y * (512)))] = pix[0][((x) + (y * (256)))];
-			}
-			fix[(((x)+240) + (y * (512)))] = pix[1][((x) + (y * (256)))];
+   const size_t pitch = PIX_BUFFER_SCREEN_WIDTH * sizeof(uint16_t);
 
-		}
-	}
-   video_cb(fix, 480, 160, 1024); //last arg is pitch
+   switch (stereo_layout)
+   {
+      case STEREO_LAYOUT_SIDE_BY_SIDE:
+         video_cb(fix, 480, 160, pitch); //last arg is pitch
+         break;
+      case STEREO_LAYOUT_SIDE_BY_SIDE_HALF:
+         for (int y = 0; y < 160; y++)
+         {
+            const uint16_t *src = fix + y * PIX_BUFFER_SCREEN_WIDTH;
+            stereo_halve_line(stereo_frame + y * 240, src);
+            stereo_halve_line(stereo_frame + y * 240 + 120, src + 240);
+         }
+         video_cb(stereo_frame, 240, 160, 240 * sizeof(uint16_t));
+         break;
+      case STEREO_LAYOUT_TOP_BOTTOM:
+         for (int y = 0; y < 160; y++)
+         {
+            const uint16_t *src = fix + y * PIX_BUFFER_SCREEN_WIDTH;
+            memcpy(stereo_frame + y * 240, src, 240 * sizeof(uint16_t));
+            memcpy(stereo_frame + (y + 160) * 240, src + 240, 240 * sizeof(uint16_t));
+         }
+         video_cb(stereo_frame, 240, 320, 240 * sizeof(uint16_t));
+         break;
+      case STEREO_LAYOUT_ROW_INTERLEAVED:
+         for (int y = 0; y < 160; y++)
+         {
+            const uint16_t *src = fix + y * PIX_BUFFER_SCREEN_WIDTH;
+            memcpy(stereo_frame + (y * 2) * 240, src, 240 * sizeof(uint16_t));
+            memcpy(stereo_frame + (y * 2 + 1) * 240, src + 240, 240 * sizeof(uint16_t));
+         }
+         video_cb(stereo_frame, 240, 320, 240 * sizeof(uint16_t));
+         break;
+      case STEREO_LAYOUT_ANAGLYPH:
+         for (int y = 0; y < 160; y++)
+         {
+            const uint16_t *src = fix + y * PIX_BUFFER_SCREEN_WIDTH;
+            stereo_anaglyph_line(stereo_frame + y * 240, src, src + 240);
+         }
+         video_cb(stereo_frame, 240, 160, 240 * sizeof(uint16_t));
+         break;
+      case STEREO_LAYOUT_MONO:
+         /* only the left eye is rendered, hand its half of the frame over */
+         video_cb(fix, 240, 160, pitch);
+         break;
+      case STEREO_LAYOUT_MULTIVIEW:
+         {
+            const unsigned columns = multiview_columns();
+            const unsigned width = 240 * columns;
+            for (unsigned view = 0; view < columns * multiview_rows(); view++)
+            {
+               uint16_t *dst = stereo_frame + (view / columns) * 160 * width + (view % columns) * 240;
+               for (int y = 0; y < 160; y++, dst += width)
+               {
+                  if (view >= multiview_count)
+                     memset(dst, 0, 240 * sizeof(uint16_t));
+                  else if (view < 2)
+                     memcpy(dst, fix + y * PIX_BUFFER_SCREEN_WIDTH + view * 240, 240 * sizeof(uint16_t));
+                  else
+                     memcpy(dst, view_pix + ((view - 2) * 160 + y) * 240, 240 * sizeof(uint16_t));
+               }
+            }
+            video_cb(stereo_frame, width, 160 * multiview_rows(), width * sizeof(uint16_t));
+         }
+         break;
+   }
    
    g_video_frames++;
 	
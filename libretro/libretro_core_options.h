@@ -74,6 +74,47 @@ struct retro_core_option_definition option_defs_us[] = {
       },
       "-3"
    },
+   {
+      "vbanext3d_stereo_layout",
+      "3D Output Layout",
+      "How the two eyes are packed into the video output. Half-width and mono halve the frame sent to the frontend.",
+      {
+         { "side-by-side",      "Side-by-Side" },
+         { "side-by-side-half", "Half-Width Side-by-Side" },
+         { "top-bottom",        "Top-Bottom" },
+         { "row-interleaved",   "Row-Interleaved" },
+         { "anaglyph",          "Red/Cyan Anaglyph" },
+         { "mono",              "Mono (Left Eye)" },
+         { "multi-view",        "Multi-View Atlas" },
+         { NULL, NULL},
+      },
+      "side-by-side"
+   },
+   {
+      "vbanext3d_multiview_count",
+      "3D Multi-View Count",
+      "Number of views in the multi-view atlas, for lenticular displays. Up to four views are placed in one row, more fill two rows.",
+      {
+         { "4", NULL },
+         { "5", NULL },
+         { "6", NULL },
+         { "7", NULL },
+         { "8", NULL },
+         { NULL, NULL},
+      },
+      "4"
+   },
+   {
+      "vbanext3d_depth_plane",
+      "3D Depth Plane",
+      "Exposes the priority of every pixel of the left eye to the frontend, for reprojection or view synthesis.",
+      {
+         { "disabled", NULL },
+         { "enabled",  NULL },
+         { NULL, NULL},
+      },
+      "disabled"
+   },
    {
       "vbanext_bios",
       "Use BIOS if available (Restart)",
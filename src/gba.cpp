@@ -18,6 +18,19 @@
 #include "memory.h"
 #include "sound.h" 
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GFX_SSE2 1
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || __GNUC__ >= 5)
+#include <immintrin.h>
+#define GFX_AVX2 1
+#define GFX_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GFX_NEON 1
+#endif
+
 #ifdef ELF
 #include "elf.h"
 #endif
@@ -52,6 +65,61 @@
 // Used in R_WIN_* to indicate whether color effects are enabled
 #define LayerMask_SFX  (1 << 5)
 
+// Line buffers keep a margin on both sides of the 240 visible pixels so
+// backgrounds can be decoded once and read by each view at its own parallax
+// offset. View n sits n times the stereo shift away from view 0.
+#define LINE_BUFFER_MARGIN (16 * (MAX_STEREO_VIEWS - 1))
+#define LINE_BUFFER_WIDTH (LINE_BUFFER_MARGIN + 240 + LINE_BUFFER_MARGIN)
+
+/*
+Each layer line is split into a plane of 16 bit colours and a plane of one
+priority byte per pixel, so the compositor reads 16 keys in one vector and
+the colours are already the width it blends. The lower the byte the nearer
+the pixel; layers are compared with a plain unsigned byte compare.
+
+  bit 0     semi-transparent OBJ
+  bit 1     set for backgrounds, so they lose ties against sprites
+  bits 2-3  priority level
+  0x30      backdrop
+  0x80      and up, transparent
+
+Clearing a line only needs the priority plane set to 0xFF: transparent, at
+the lowest priority level.
+*/
+#define GFX_PRIO_SEMI 0x01
+#define GFX_PRIO_BG 0x02
+#define GFX_PRIO_LEVEL(level) ((level) << 2)
+#define GFX_PRIO_LEVEL_OF(prio) (((prio) >> 2) & 3)
+#define GFX_PRIO_BACKDROP 0x30
+#define GFX_PRIO_TRANSPARENT 0x80
+
+struct gfxLineBuffer {
+	u16 color[LINE_BUFFER_WIDTH];
+	u8 prio[LINE_BUFFER_WIDTH];
+};
+
+struct gfxLayerLine {
+	u16 *color;
+	u8 *prio;
+};
+
+static inline gfxLayerLine gfxLineAt(gfxLineBuffer& buffer, int offset)
+{
+	gfxLayerLine line = { buffer.color + LINE_BUFFER_MARGIN + offset, buffer.prio + LINE_BUFFER_MARGIN + offset };
+	return line;
+}
+
+static inline gfxLayerLine gfxLineFrom(const gfxLayerLine& line, int x)
+{
+	gfxLayerLine from = { line.color + x, line.prio + x };
+	return from;
+}
+
+static inline void gfxClearLineBuffer(gfxLineBuffer& buffer)
+{
+	memset(buffer.prio, -1, sizeof(buffer.prio));
+}
+
 #if USE_FRAME_SKIP
 
 int fs_count = 0;
@@ -75,6 +143,21 @@ void SetParallax(int code)
 	parallax_offset = code;
 }
 
+int stereo_views = 2;
+
+void SetStereoViews(int views)
+{
+	stereo_views = views;
+}
+
+bool depth_plane_enabled = false;
+uint8_t depth_plane[240 * 160];
+
+void SetDepthPlane(bool enabled)
+{
+	depth_plane_enabled = enabled;
+}
+
 int draw_right_screen = 0;
 typedef void (*renderfunc_t)(void);
 
@@ -93,8 +176,8 @@ inline static long min(long p, long q) { return p < q ? p : q; }
 uint8_t *rom = 0;
 uint8_t *bios = 0;
 uint8_t *vram = 0;
-uint16_t *pix[2];
 uint16_t *fix = 0;
+uint16_t *view_pix = 0;
 uint8_t *oam = 0;
 uint8_t *ioMem = 0;
 uint8_t *internalRAM = 0;
@@ -105,6 +188,11 @@ char cartridgeCode[4];
 int renderfunc_mode = 0;
 int renderfunc_type = 0;
 
+struct gfxCompositeArgs;
+typedef void (*gfxcompositefunc_t)(const gfxCompositeArgs&);
+static int renderfunc_layers = 0;
+static gfxcompositefunc_t renderfunc_composite = NULL;
+
 #if USE_MOTION_SENSOR
 hardware_t hardware;
 
@@ -119,46 +207,123 @@ static void hardware_reset() {
 }
 #endif
 
+//RENDERER_IO_REGISTER_COUNT: registers the renderer reads, DISPCNT to BLDY
+#define RENDERER_IO_REGISTER_COUNT 0x30
+//GFX_WIN_WORDS: words in the 240 bit mask of a window
+#define GFX_WIN_WORDS 8
+
+// per 5 bit channel results of the blend coefficients in BLDALPHA and BLDY
+struct gfxBlendTables {
+	u8 eva[32];
+	u8 evb[32];
+	u8 brighten[32];
+	u8 darken[32];
+};
+
 #if THREADED_RENDERER
 
+	//THREADED_RENDERER_SPLIT_EYES: every line goes to both contexts, context 0
+	//draws the left eye and context 1 the right eye. With more than two views
+	//each context takes half of them.
+	#ifndef THREADED_RENDERER_SPLIT_EYES
+		#define THREADED_RENDERER_SPLIT_EYES 1
+	#endif
+
+	//THREADED_RENDERER_DEFERRED: lines are only logged while the frame runs and
+	//the whole frame is drawn at VBlank, in bands of lines spread over
+	//THREADED_RENDERER_WORKERS contexts.
+	#ifndef THREADED_RENDERER_DEFERRED
+		#define THREADED_RENDERER_DEFERRED 0
+	#endif
+
 	//THREADED_RENDERER_COUNT: 1 to 4
-	#if VITA
+	#if THREADED_RENDERER_DEFERRED
+		#ifndef THREADED_RENDERER_WORKERS
+			#define THREADED_RENDERER_WORKERS 4
+		#endif
+		#define THREADED_RENDERER_COUNT THREADED_RENDERER_WORKERS
+	#elif THREADED_RENDERER_SPLIT_EYES || VITA
 		#define THREADED_RENDERER_COUNT 2
 	#else
 		#define THREADED_RENDERER_COUNT 1
 	#endif
+	#if THREADED_RENDERER_COUNT < 1 || THREADED_RENDERER_COUNT > 4
+		#error "THREADED_RENDERER_COUNT must be 1 to 4"
+	#endif
+
+	//THREADED_RENDERER_QUEUE_SIZE: lines a context may have queued, power of two
+	#ifndef THREADED_RENDERER_QUEUE_SIZE
+		#define THREADED_RENDERER_QUEUE_SIZE 4
+	#endif
+	#if THREADED_RENDERER_QUEUE_SIZE & (THREADED_RENDERER_QUEUE_SIZE - 1)
+		#error "THREADED_RENDERER_QUEUE_SIZE must be a power of two"
+	#endif
+
+	//THREADED_RENDERER_SPIN: polls before a waiting thread goes to sleep
+	#ifndef THREADED_RENDERER_SPIN
+		#define THREADED_RENDERER_SPIN 512
+	#endif
 
 	#include "thread.h"
 
 	static int threaded_renderer_idx = 0;
 	static uint32_t threaded_gfxinwin_ver[2] = {1, 1};
 	static volatile uint32_t threaded_background_ver = 0;
-	static volatile int threaded_renderer_ready = 0;
 
 	static void threaded_renderer_loop(void* p);
-	static void threaded_renderer_loop0(void* p);
+#if THREADED_RENDERER_DEFERRED
+	static void gfxDeferredRenderFrame(void);
+#endif
 
 	typedef struct {
 		thread_t renderer_thread_id;
 
 		volatile int renderer_control;
-		volatile int renderer_state;
+
+		//the emulation thread advances queue_tail, the renderer advances
+		//queue_head once the line is drawn; each side sets its sleeping flag
+		//before it waits on its semaphore
+		volatile int queue_head;
+		volatile int queue_tail;
+		volatile int renderer_sleeping;
+		volatile int producer_sleeping;
+		thread_sem_t renderer_sem;
+		thread_sem_t producer_sem;
+
 		int renderfunc_mode;
 		int renderfunc_type;
+		int renderfunc_layers;
+		gfxcompositefunc_t renderfunc_composite;
 		int vcount;
+		uint32_t video_gen;
+		int first_eye;
+		int last_eye;
 
 		uint32_t background_ver;
-		uint32_t gfxinwin_ver[2];
-
-		uint16_t io_registers[1024 * 16];
-		uint32_t line[6][240];
+		uint32_t gfxinwin_ver[2]; //last queued, emulation thread only
+
+		uint16_t io_registers[RENDERER_IO_REGISTER_COUNT];
+		gfxLineBuffer line_buffer[6];
+		gfxLayerLine line[6];
+		gfxLineBuffer line_obj_views[MAX_STEREO_VIEWS - 1];
+		int8_t obj_parallax[128];
+		bool obj_parallax_enabled;
+		bool obj_disparity;
+		int obj_parallax_vcount;
 		int lineOBJpixleft[128];
-		bool gfxInWin[2][240];
+		uint32_t oam_lines[160][4];
+		uint32_t oam_lines_ver;
+		uint32_t gfxInWin[2][GFX_WIN_WORDS];
 
 		bool draw_objwin;
 		bool draw_sprites;
+		int draw_right_screen;
 		uint16_t mosaic;
 		uint16_t bldmod;
+		uint16_t colev;
+		uint16_t coly;
+		gfxBlendTables blend;
+		uint32_t blend_key; //BLDALPHA | BLDY << 16 the tables were built for
 		uint16_t layers;
 
 		int bg2c;
@@ -176,22 +341,114 @@ static void hardware_reset() {
 		int bg3x_h;
 		int bg3y_l;
 		int bg3y_h;
+
+		//decoded tiles, each renderer keeps its own
+		uint8_t tile_cache4[0x20000 >> 5][64];
+		uint8_t tile_cache8[0x20000 >> 6][64];
+		uint8_t tile_dirty4[0x20000 >> 5];
+		uint8_t tile_dirty8[0x20000 >> 6];
+
+#if THREADED_RENDERER_DEFERRED
+		int first_line;
+		int last_line;
+
+		uint8_t vram[0x20000];
+		uint8_t oam[0x400];
+		uint16_t palette[512];
+#endif
 	} renderer_context;
 
 	static void init_renderer_context(renderer_context& ctx) {
 		ctx.renderer_control = 0;
-		ctx.renderer_state = 0;
+		ctx.queue_head = 0;
+		ctx.queue_tail = 0;
+		ctx.renderer_sleeping = 0;
+		ctx.producer_sleeping = 0;
+		ctx.first_eye = 0;
+		ctx.last_eye = 0;
 		ctx.background_ver = 0;
 		ctx.gfxinwin_ver[0] = 0;
 		ctx.gfxinwin_ver[1] = 0;
-		memset(ctx.line[Layer_BG0], -1, 240 * sizeof(u32));
-		memset(ctx.line[Layer_BG1], -1, 240 * sizeof(u32));
-		memset(ctx.line[Layer_BG2], -1, 240 * sizeof(u32));
-		memset(ctx.line[Layer_BG3], -1, 240 * sizeof(u32));
+		for(int i = 0; i < 6; ++i)
+			ctx.line[i] = gfxLineAt(ctx.line_buffer[i], 0);
+		ctx.obj_parallax_enabled = false;
+		ctx.obj_parallax_vcount = 160;
+		ctx.oam_lines_ver = 0;
+		ctx.blend_key = 0xFFFFFFFF;
+		memset(ctx.tile_dirty4, 1, sizeof(ctx.tile_dirty4));
+		memset(ctx.tile_dirty8, 1, sizeof(ctx.tile_dirty8));
+		gfxClearLineBuffer(ctx.line_buffer[Layer_BG0]);
+		gfxClearLineBuffer(ctx.line_buffer[Layer_BG1]);
+		gfxClearLineBuffer(ctx.line_buffer[Layer_BG2]);
+		gfxClearLineBuffer(ctx.line_buffer[Layer_BG3]);
 	}
 
 	static renderer_context threaded_renderer_contexts[THREADED_RENDERER_COUNT];
 
+	#define THREADED_QUEUE_PENDING(__ctx__) \
+		((unsigned)(__ctx__).queue_tail - (unsigned)thread_load_acquire(&(__ctx__).queue_head))
+	#define THREADED_QUEUE_SLOT(__index__) ((unsigned)(__index__) & (THREADED_RENDERER_QUEUE_SIZE - 1))
+
+	//emulation thread: wakes the renderer if it went to sleep
+	static void threaded_queue_wake(renderer_context& ctx) {
+		thread_memory_barrier();
+		if(thread_load_acquire(&ctx.renderer_sleeping) && thread_exchange(&ctx.renderer_sleeping, 0))
+			thread_sem_signal(ctx.renderer_sem);
+	}
+
+	//emulation thread: publishes the job in slot THREADED_QUEUE_SLOT(queue_tail)
+	static void threaded_queue_push(renderer_context& ctx) {
+		thread_store_release(&ctx.queue_tail, (int)((unsigned)ctx.queue_tail + 1));
+		threaded_queue_wake(ctx);
+	}
+
+	//emulation thread: waits until no more than `pending` jobs are left
+	static void threaded_queue_wait(renderer_context& ctx, unsigned pending) {
+		for(int spin = 0; spin < THREADED_RENDERER_SPIN; ++spin) {
+			if(THREADED_QUEUE_PENDING(ctx) <= pending) return;
+			thread_pause();
+		}
+		for(;;) {
+			thread_exchange(&ctx.producer_sleeping, 1);
+			thread_memory_barrier();
+			if(THREADED_QUEUE_PENDING(ctx) <= pending) {
+				//the renderer took the flag, so its signal is on the way
+				if(!thread_exchange(&ctx.producer_sleeping, 0))
+					thread_sem_wait(ctx.producer_sem);
+				return;
+			}
+			thread_sem_wait(ctx.producer_sem);
+		}
+	}
+
+	//renderer: waits for a job, returns false when asked to stop
+	static bool threaded_queue_next(renderer_context& ctx) {
+		for(int spin = 0; ; ++spin) {
+			if(thread_load_acquire(&ctx.renderer_control) != 1) return false;
+			if(thread_load_acquire(&ctx.queue_tail) != ctx.queue_head) return true;
+			if(spin < THREADED_RENDERER_SPIN) {
+				thread_pause();
+				continue;
+			}
+			thread_exchange(&ctx.renderer_sleeping, 1);
+			thread_memory_barrier();
+			if(thread_load_acquire(&ctx.renderer_control) != 1 || thread_load_acquire(&ctx.queue_tail) != ctx.queue_head) {
+				if(!thread_exchange(&ctx.renderer_sleeping, 0))
+					thread_sem_wait(ctx.renderer_sem);
+				continue;
+			}
+			thread_sem_wait(ctx.renderer_sem);
+		}
+	}
+
+	//renderer: retires the job at queue_head once it is drawn
+	static void threaded_queue_pop(renderer_context& ctx) {
+		thread_store_release(&ctx.queue_head, (int)((unsigned)ctx.queue_head + 1));
+		thread_memory_barrier();
+		if(thread_load_acquire(&ctx.producer_sleeping) && thread_exchange(&ctx.producer_sleeping, 0))
+			thread_sem_signal(ctx.producer_sem);
+	}
+
 	#define INIT_RENDERER_CONTEXT(__renderer_idx__) renderer_context& renderer_ctx = threaded_renderer_contexts[__renderer_idx__]
 
 	#define RENDERER_BG2C renderer_ctx.bg2c
@@ -211,19 +468,50 @@ static void hardware_reset() {
 	#define RENDERER_BG3Y_L renderer_ctx.bg3y_l
 	#define RENDERER_BG3Y_H renderer_ctx.bg3y_h
 
-	#define RENDERER_PALETTE paletteRAM
+#if THREADED_RENDERER_DEFERRED
+	#define RENDERER_VRAM renderer_ctx.vram
+	#define RENDERER_PALETTE renderer_ctx.palette
+	#define RENDERER_OAM renderer_ctx.oam
+#else
+	#define RENDERER_VRAM vram
+	#define RENDERER_PALETTE gfxPalette
 	#define RENDERER_OAM oam
+#endif
+	#define RENDERER_TILE_CACHE4 renderer_ctx.tile_cache4
+	#define RENDERER_TILE_CACHE8 renderer_ctx.tile_cache8
+	#define RENDERER_TILE_DIRTY4 renderer_ctx.tile_dirty4
+	#define RENDERER_TILE_DIRTY8 renderer_ctx.tile_dirty8
 
 	#define RENDERER_LINE renderer_ctx.line
+	#define RENDERER_LINE_BUFFER renderer_ctx.line_buffer
 	#define RENDERER_IO_REGISTERS renderer_ctx.io_registers
 	#define RENDERER_MOSAIC renderer_ctx.mosaic
 	#define RENDERER_BLDMOD renderer_ctx.bldmod
+	#define RENDERER_COLEV renderer_ctx.colev
+	#define RENDERER_COLY renderer_ctx.coly
+	#define RENDERER_BLEND renderer_ctx.blend
 	#define RENDERER_GRAPHICS_LAYERS renderer_ctx.layers
 	#define RENDERER_LINE_OBJ_PIX_LEFT renderer_ctx.lineOBJpixleft
+	#define RENDERER_OAM_LINES renderer_ctx.oam_lines
+	#define RENDERER_OAM_LINES_VER renderer_ctx.oam_lines_ver
+	#define RENDERER_LINE_OBJ_VIEWS renderer_ctx.line_obj_views
+	#define RENDERER_OBJ_PARALLAX renderer_ctx.obj_parallax
+	#define RENDERER_OBJ_PARALLAX_ENABLED renderer_ctx.obj_parallax_enabled
+	#define RENDERER_OBJ_DISPARITY renderer_ctx.obj_disparity
+	#define RENDERER_OBJ_PARALLAX_VCOUNT renderer_ctx.obj_parallax_vcount
+	#define RENDERER_VIDEO_GEN renderer_ctx.video_gen
 	#define RENDERER_GFX_IN_WIN renderer_ctx.gfxInWin
+	#define RENDERER_DRAW_RIGHT_SCREEN renderer_ctx.draw_right_screen
+	#define RENDERER_FIRST_EYE renderer_ctx.first_eye
+	#define RENDERER_LAST_EYE renderer_ctx.last_eye
+	#define RENDERER_DRAW_SPRITES renderer_ctx.draw_sprites
+	#define RENDERER_DRAW_OBJWIN renderer_ctx.draw_objwin
 
 	#define RENDERER_R_VCOUNT renderer_ctx.vcount
 	#define RENDERER_R_DISPCNT_Video_Mode renderer_ctx.renderfunc_mode
+	#define RENDERER_RENDERFUNC_TYPE renderer_ctx.renderfunc_type
+	#define RENDERER_RENDERFUNC_LAYERS renderer_ctx.renderfunc_layers
+	#define RENDERER_RENDERFUNC_COMPOSITE renderer_ctx.renderfunc_composite
 
 	#define RENDERER_R_DISPCNT_Screen_Display_BG0 (RENDERER_GRAPHICS_LAYERS & (1 <<  8))
 	#define RENDERER_R_DISPCNT_Screen_Display_BG1 (RENDERER_GRAPHICS_LAYERS & (1 <<  9))
@@ -269,18 +557,43 @@ static void hardware_reset() {
 	#define RENDERER_BG3Y_L BG3Y_L
 	#define RENDERER_BG3Y_H BG3Y_H
 
-	#define RENDERER_PALETTE paletteRAM
+	#define RENDERER_VRAM vram
+	#define RENDERER_PALETTE gfxPalette
+	#define RENDERER_TILE_CACHE4 gfxTileCache4
+	#define RENDERER_TILE_CACHE8 gfxTileCache8
+	#define RENDERER_TILE_DIRTY4 gfxTileDirty4
+	#define RENDERER_TILE_DIRTY8 gfxTileDirty8
 	#define RENDERER_IO_REGISTERS io_registers
 	#define RENDERER_LINE line
+	#define RENDERER_LINE_BUFFER line_buffer
 	#define RENDERER_OAM oam
 	#define RENDERER_MOSAIC MOSAIC
 	#define RENDERER_BLDMOD BLDMOD
+	#define RENDERER_COLEV COLEV
+	#define RENDERER_COLY COLY
+	#define RENDERER_BLEND gfxBlend
 	#define RENDERER_GRAPHICS_LAYERS graphics.layerEnable
 	#define RENDERER_LINE_OBJ_PIX_LEFT lineOBJpixleft
+	#define RENDERER_OAM_LINES oam_lines
+	#define RENDERER_OAM_LINES_VER oam_lines_ver
+	#define RENDERER_LINE_OBJ_VIEWS line_obj_views
+	#define RENDERER_OBJ_PARALLAX obj_parallax
+	#define RENDERER_OBJ_PARALLAX_ENABLED obj_parallax_enabled
+	#define RENDERER_OBJ_DISPARITY obj_disparity
+	#define RENDERER_OBJ_PARALLAX_VCOUNT obj_parallax_vcount
+	#define RENDERER_VIDEO_GEN gfxVideoGen
 	#define RENDERER_GFX_IN_WIN gfxInWin
+	#define RENDERER_DRAW_RIGHT_SCREEN draw_right_screen
+	#define RENDERER_FIRST_EYE 0
+	#define RENDERER_LAST_EYE (stereo_views - 1)
+	#define RENDERER_DRAW_SPRITES R_DISPCNT_Screen_Display_OBJ
+	#define RENDERER_DRAW_OBJWIN ((graphics.layerEnable & 0x9000) == 0x9000)
 
 	#define RENDERER_R_VCOUNT (RENDERER_IO_REGISTERS[REG_VCOUNT])
 	#define RENDERER_R_DISPCNT_Video_Mode (RENDERER_IO_REGISTERS[REG_DISPCNT] & 7)
+	#define RENDERER_RENDERFUNC_TYPE renderfunc_type
+	#define RENDERER_RENDERFUNC_LAYERS renderfunc_layers
+	#define RENDERER_RENDERFUNC_COMPOSITE renderfunc_composite
 
 	#define RENDERER_R_DISPCNT_Screen_Display_BG0 (RENDERER_GRAPHICS_LAYERS & (1 <<  8))
 	#define RENDERER_R_DISPCNT_Screen_Display_BG1 (RENDERER_GRAPHICS_LAYERS & (1 <<  9))
@@ -308,7 +621,7 @@ static void hardware_reset() {
 
 #endif
 
-#define RENDERER_BACKDROP (READ16LE(&reinterpret_cast<uint16_t*>(RENDERER_PALETTE)[0]) | 0x30000000)
+#define RENDERER_BACKDROP (RENDERER_PALETTE[0])
 #define RENDERER_R_BLDCNT_Color_Special_Effect ((RENDERER_BLDMOD >> 6) & 3)
 #define RENDERER_R_BLDCNT_IsTarget1(target) ((target) & (RENDERER_BLDMOD     ))
 #define RENDERER_R_BLDCNT_IsTarget2(target) ((target) & (RENDERER_BLDMOD >> 8))
@@ -337,21 +650,205 @@ static void hardware_reset() {
 	int m = 1; \
 	int i = 0; \
 	for (; i < 239; i++) { \
-		RENDERER_LINE[__layer__][i+1] = RENDERER_LINE[__layer__][i]; \
+		RENDERER_LINE[__layer__].color[i+1] = RENDERER_LINE[__layer__].color[i]; \
+		RENDERER_LINE[__layer__].prio[i+1] = RENDERER_LINE[__layer__].prio[i]; \
 		if (++m == __mosaicX__) { m = 1; i++; } \
 	} \
 }
 
-static INLINE u32 gfxIncreaseBrightness(u32 color, int coeff) {
-	color = (((color & 0xffff) << 16) | (color & 0xffff)) & 0x3E07C1F;
-	color += ((((0x3E07C1F - color) * coeff) >> 4) & 0x3E07C1F);
-	return (color >> 16) | color;
+/*
+Colours in the line buffers are already in the frontend pixel format. The
+channel with GBA red sits at GFX_SHIFT_R, green at GFX_SHIFT_G and blue at
+bit 0. RGB565 also repeats the top green bit into its sixth green bit.
+*/
+#ifdef FRONTEND_SUPPORTS_RGB565
+#define GFX_SHIFT_R 11
+#define GFX_SHIFT_G 6
+#define GFX_GREEN_LOW(color) (((color) >> 5) & 0x20)
+#else
+#define GFX_SHIFT_R 10
+#define GFX_SHIFT_G 5
+#define GFX_GREEN_LOW(color) 0
+#endif
+#define GFX_RGB(r, g, b) (((r) << GFX_SHIFT_R) | ((g) << GFX_SHIFT_G) | GFX_GREEN_LOW((g) << GFX_SHIFT_G) | (b))
+
+static INLINE u32 gfxMapChannels(u32 color, const u8 *table) {
+	return GFX_RGB(table[(color >> GFX_SHIFT_R) & 0x1F], table[(color >> GFX_SHIFT_G) & 0x1F], table[color & 0x1F]);
+}
+
+#define gfxIncreaseBrightness(color, tables) gfxMapChannels(color, (tables).brighten)
+#define gfxDecreaseBrightness(color, tables) gfxMapChannels(color, (tables).darken)
+
+/*
+Decoded tile cache for the text backgrounds.
+
+Tiles are kept as one palette index per pixel, 4bpp and 8bpp apart, so a
+tile row is ready to be looked up without unpacking VRAM again. Every VRAM
+write marks the tiles it lands in dirty and the next read decodes them.
+
+Renderer threads each keep their own cache in their context, so a thread
+never reads a row another one is still decoding. The deferred renderer
+marks its tiles dirty as it loads each VRAM page instead.
+*/
+#if !THREADED_RENDERER
+static u8 gfxTileCache4[0x20000 >> 5][64];
+static u8 gfxTileCache8[0x20000 >> 6][64];
+static u8 gfxTileDirty4[0x20000 >> 5];
+static u8 gfxTileDirty8[0x20000 >> 6];
+#endif
+
+// bumped whenever VRAM or the converted palette actually change
+static u32 gfxVideoGen = 1;
+
+static INLINE void gfxInvalidateTile(u32 address)
+{
+#if !THREADED_RENDERER
+	gfxTileDirty4[address >> 5] = 1;
+	gfxTileDirty8[address >> 6] = 1;
+#elif !THREADED_RENDERER_DEFERRED
+	for(int u = 0; u < THREADED_RENDERER_COUNT; ++u) {
+		threaded_renderer_contexts[u].tile_dirty4[address >> 5] = 1;
+		threaded_renderer_contexts[u].tile_dirty8[address >> 6] = 1;
+	}
+#endif
+	gfxVideoGen++;
+}
+
+static void gfxInvalidateAllTiles(void)
+{
+#if !THREADED_RENDERER
+	memset(gfxTileDirty4, 1, sizeof(gfxTileDirty4));
+	memset(gfxTileDirty8, 1, sizeof(gfxTileDirty8));
+#elif !THREADED_RENDERER_DEFERRED
+	for(int u = 0; u < THREADED_RENDERER_COUNT; ++u) {
+		memset(threaded_renderer_contexts[u].tile_dirty4, 1, sizeof(threaded_renderer_contexts[u].tile_dirty4));
+		memset(threaded_renderer_contexts[u].tile_dirty8, 1, sizeof(threaded_renderer_contexts[u].tile_dirty8));
+	}
+#endif
+	gfxVideoGen++;
+}
+
+// address is the VRAM offset of the tile, row the tile row after vertical flip
+template<int renderer_idx>
+static INLINE const u8 *gfxTileRow4(u32 address, int row)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+	u32 tile = address >> 5;
+	if(RENDERER_TILE_DIRTY4[tile]) {
+		RENDERER_TILE_DIRTY4[tile] = 0;
+		const u8 *src = RENDERER_VRAM + (tile << 5);
+		u8 *dst = RENDERER_TILE_CACHE4[tile];
+		for(int i = 0; i < 32; ++i) {
+			dst[i * 2] = src[i] & 0x0F;
+			dst[i * 2 + 1] = src[i] >> 4;
+		}
+	}
+	return RENDERER_TILE_CACHE4[tile] + row * 8;
+}
+
+template<int renderer_idx>
+static INLINE const u8 *gfxTileRow8(u32 address, int row)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+	u32 tile = address >> 6;
+	if(RENDERER_TILE_DIRTY8[tile]) {
+		RENDERER_TILE_DIRTY8[tile] = 0;
+		memcpy(RENDERER_TILE_CACHE8[tile], RENDERER_VRAM + (tile << 6), 64);
+	}
+	return RENDERER_TILE_CACHE8[tile] + row * 8;
+}
+
+/*
+Palette RAM converted to the frontend pixel format, kept up to date on every
+palette write so the renderer never converts a pixel.
+*/
+static u16 gfxPalette[512];
+
+/*
+Copy-on-write pages for the deferred renderer.
+
+VRAM, OAM, the converted palette and the window masks are split in 1 KB
+pages that the lines of the frame log refer to. gfxPageSlot holds the log
+entry that still points at the live memory of a page. The first write to it
+copies the old contents aside and moves that entry to the copy, so the lines
+logged before the write keep seeing what they saw.
+*/
+#define GFX_PAGE_SHIFT 10
+#define GFX_PAGE_SIZE (1 << GFX_PAGE_SHIFT)
+#define GFX_PAGE_OAM (0x20000 >> GFX_PAGE_SHIFT)
+#define GFX_PAGE_PALETTE (GFX_PAGE_OAM + 1)
+#define GFX_PAGE_WINDOW (GFX_PAGE_OAM + 2)
+#define GFX_PAGE_COUNT (GFX_PAGE_OAM + 3)
+#define GFX_PAGE_BYTES(page) ((page) == GFX_PAGE_WINDOW ? 2 * GFX_WIN_WORDS * sizeof(u32) : GFX_PAGE_SIZE)
+
+#if THREADED_RENDERER_DEFERRED
+static u8 **gfxPageSlot[GFX_PAGE_COUNT];
+static u16 gfxPageWritten[GFX_PAGE_COUNT];
+static int gfxPageWrittenCount = 0;
+static u8 **gfxPagePool = NULL;
+static int gfxPagePoolSize = 0;
+static int gfxPagePoolUsed = 0;
+
+static u8 *gfxAllocPage(void)
+{
+	if(gfxPagePoolUsed == gfxPagePoolSize) {
+		int size = gfxPagePoolSize ? gfxPagePoolSize * 2 : 256;
+		gfxPagePool = (u8 **)realloc(gfxPagePool, size * sizeof(u8 *));
+		for(int i = gfxPagePoolSize; i < size; ++i)
+			gfxPagePool[i] = (u8 *)malloc(GFX_PAGE_SIZE);
+		gfxPagePoolSize = size;
+	}
+	return gfxPagePool[gfxPagePoolUsed++];
+}
+
+static void gfxFreePages(void)
+{
+	for(int i = 0; i < gfxPagePoolSize; ++i)
+		free(gfxPagePool[i]);
+	free(gfxPagePool);
+	gfxPagePool = NULL;
+	gfxPagePoolSize = gfxPagePoolUsed = 0;
+}
+
+static INLINE void gfxDeferredWrite(int page)
+{
+	u8 **slot = gfxPageSlot[page];
+	if(slot == NULL)
+		return;
+	gfxPageSlot[page] = NULL;
+	u8 *copy = gfxAllocPage();
+	memcpy(copy, *slot, GFX_PAGE_BYTES(page));
+	*slot = copy;
+	gfxPageWritten[gfxPageWrittenCount++] = page;
+}
+
+static void gfxDeferredWriteRange(int first, int count)
+{
+	for(int page = first; page < first + count; ++page)
+		gfxDeferredWrite(page);
+}
+#else
+#define gfxDeferredWrite(page)
+#define gfxDeferredWriteRange(first, count)
+#endif
+
+static INLINE void gfxUpdatePalette(u32 address)
+{
+	u16 color = READ16LE(paletteRAM + (address & 0x3FE));
+	u16 converted = CONVERT_COLOR(color);
+	if(gfxPalette[(address & 0x3FE) >> 1] == converted)
+		return;
+	gfxDeferredWrite(GFX_PAGE_PALETTE);
+	gfxPalette[(address & 0x3FE) >> 1] = converted;
+	gfxVideoGen++;
 }
 
-static INLINE u32 gfxDecreaseBrightness(u32 color, int coeff) {
-	color = (((color & 0xffff) << 16) | (color & 0xffff)) & 0x3E07C1F;
-	color -= (((color * coeff) >> 4) & 0x3E07C1F);
-	return (color >> 16) | color;
+static void gfxUpdateAllPalette(void)
+{
+	for(u32 address = 0; address < 0x400; address += 2)
+		gfxUpdatePalette(address);
 }
 
 static u32 AlphaClampLUT[64] = 
@@ -362,25 +859,25 @@ static u32 AlphaClampLUT[64] =
 	0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F
 };  
 
-#define GFX_ALPHA_BLEND(color, color2, ca, cb) {                                                         \
-	int r = AlphaClampLUT[(((color & 0x1F) * ca) >> 4) + (((color2 & 0x1F) * cb) >> 4)];                 \
-	int g = AlphaClampLUT[((((color >> 5) & 0x1F) * ca) >> 4) + ((((color2 >> 5) & 0x1F) * cb) >> 4)];   \
-	int b = AlphaClampLUT[((((color >> 10) & 0x1F) * ca) >> 4) + ((((color2 >> 10) & 0x1F) * cb) >> 4)]; \
-	color = (color & 0xFFFF0000) | (b << 10) | (g << 5) | r;	\
+#define GFX_ALPHA_BLEND(color, color2, tables) {                                                          \
+	int r = AlphaClampLUT[(tables).eva[(color >> GFX_SHIFT_R) & 0x1F] + (tables).evb[(color2 >> GFX_SHIFT_R) & 0x1F]]; \
+	int g = AlphaClampLUT[(tables).eva[(color >> GFX_SHIFT_G) & 0x1F] + (tables).evb[(color2 >> GFX_SHIFT_G) & 0x1F]]; \
+	int b = AlphaClampLUT[(tables).eva[color & 0x1F] + (tables).evb[color2 & 0x1F]];                     \
+	color = GFX_RGB(r, g, b);	\
 }
 
 #define brightness_switch()                                                                \
 	switch(RENDERER_R_BLDCNT_Color_Special_Effect) { \
 		case SpecialEffect_Brightness_Increase:                                            \
-			color = gfxIncreaseBrightness(color, coeff[COLY & 0x1F]); break;               \
+			color = gfxIncreaseBrightness(color, RENDERER_BLEND); break;               \
 		case SpecialEffect_Brightness_Decrease:                                            \
-			color = gfxDecreaseBrightness(color, coeff[COLY & 0x1F]); break;               \
+			color = gfxDecreaseBrightness(color, RENDERER_BLEND); break;               \
 	}
 
 #define alpha_blend_brightness_switch()                                                    \
 	if(RENDERER_R_BLDCNT_IsTarget2(top2)) { \
-		if(color < 0x80000000) {	\
-			GFX_ALPHA_BLEND(color, back, coeff[COLEV & 0x1F], coeff[(COLEV >> 8) & 0x1F]); \
+		if(prio < GFX_PRIO_TRANSPARENT) {	\
+			GFX_ALPHA_BLEND(color, back, RENDERER_BLEND); \
 		} else if (RENDERER_R_BLDCNT_IsTarget1(top)) { \
 			brightness_switch();                                                           \
 		} \
@@ -420,6 +917,27 @@ static int coeff[32] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
 			16, 16, 16, 16, 16, 16, 16, 16, 16,
 			16, 16, 16};
 
+/*
+Blend tables.
+
+Alpha blending and fades scale each 5 bit channel by a coefficient from
+BLDALPHA or BLDY. The scaled channels are tabulated whenever those registers
+change, so blending a pixel is a few lookups instead of multiplies.
+*/
+static void gfxBuildBlendTables(gfxBlendTables& tables, u16 colev, u16 coly)
+{
+	int eva = coeff[colev & 0x1F];
+	int evb = coeff[(colev >> 8) & 0x1F];
+	int evy = coeff[coly & 0x1F];
+
+	for(int c = 0; c < 32; ++c) {
+		tables.eva[c] = (c * eva) >> 4;
+		tables.evb[c] = (c * evb) >> 4;
+		tables.brighten[c] = c + (((31 - c) * evy) >> 4);
+		tables.darken[c] = c - ((c * evy) >> 4);
+	}
+}
+
 static uint8_t biosProtected[4];
 static uint8_t cpuBitsSet[256];
 
@@ -612,6 +1130,17 @@ static uint16_t DM3DAD_H = 0x0000;
 static uint16_t DM3CNT_L = 0x0000;
 static uint16_t DM3CNT_H = 0x0000;
 
+#if !THREADED_RENDERER
+static gfxBlendTables gfxBlend;
+#endif
+
+static void gfxUpdateBlendTables(void)
+{
+#if !THREADED_RENDERER
+	gfxBuildBlendTables(gfxBlend, COLEV, COLY);
+#endif
+}
+
 static uint8_t timerOnOffDelay = 0;
 static uint16_t timer0Value = 0;
 static uint32_t dma0Source = 0;
@@ -647,9 +1176,22 @@ static memoryMap map[256];
 static int clockTicks;
 
 static int romSize = 0x2000000;
-static uint32_t line[6][240];
-static bool gfxInWin[2][240];
+static gfxLineBuffer line_buffer[6];
+static gfxLayerLine line[6] = {
+	gfxLineAt(line_buffer[0], 0), gfxLineAt(line_buffer[1], 0),
+	gfxLineAt(line_buffer[2], 0), gfxLineAt(line_buffer[3], 0),
+	gfxLineAt(line_buffer[4], 0), gfxLineAt(line_buffer[5], 0)
+};
+static gfxLineBuffer line_obj_views[MAX_STEREO_VIEWS - 1];
+static int8_t obj_parallax[128];
+static bool obj_parallax_enabled = false;
+static bool obj_disparity = false;
+static int obj_parallax_vcount = 160;
+static u32 gfxInWin[2][GFX_WIN_WORDS];
 static int lineOBJpixleft[128];
+static uint32_t oam_lines[160][4];
+static uint32_t oam_lines_ver = 0;
+static volatile uint32_t oamVersion = 1;
 uint64_t joy = 0;
 
 static int gfxBG2Changed = 0;
@@ -1152,6 +1694,8 @@ static INLINE void CPUWriteMemory(u32 address, u32 value)
 			break;
 		case 0x05:
 			WRITE32LE(paletteRAM + (address & 0x3FC), value);
+			gfxUpdatePalette(address);
+			gfxUpdatePalette(address + 2);
 			break;
 		case 0x06:
 			address = (address & 0x1fffc);
@@ -1160,11 +1704,18 @@ static INLINE void CPUWriteMemory(u32 address, u32 value)
 			if ((address & 0x18000) == 0x18000)
 				address &= 0x17fff;
 
-
+			if(READ32LE(vram + address) == value)
+				break;
+			gfxDeferredWrite(address >> GFX_PAGE_SHIFT);
 			WRITE32LE(vram + address, value);
+			gfxInvalidateTile(address);
 			break;
 		case 0x07:
+			if(READ32LE(oam + (address & 0x3fc)) == value)
+				break;
+			gfxDeferredWrite(GFX_PAGE_OAM);
 			WRITE32LE(oam + (address & 0x3fc), value);
+			oamVersion++;
 			break;
 		case 0x0D:
 			if(cpuEEPROMEnabled) {
@@ -1197,6 +1748,7 @@ static INLINE void CPUWriteHalfWord(u32 address, u16 value)
 			break;
 		case 5:
 			WRITE16LE(paletteRAM + (address & 0x3fe), value);
+			gfxUpdatePalette(address);
 			break;
 		case 6:
 			address = (address & 0x1fffe);
@@ -1204,10 +1756,18 @@ static INLINE void CPUWriteHalfWord(u32 address, u16 value)
 				return;
 			if ((address & 0x18000) == 0x18000)
 				address &= 0x17fff;
+			if(READ16LE(vram + address) == value)
+				break;
+			gfxDeferredWrite(address >> GFX_PAGE_SHIFT);
 			WRITE16LE(vram + address, value);
+			gfxInvalidateTile(address);
 			break;
 		case 7:
+			if(READ16LE(oam + (address & 0x3fe)) == value)
+				break;
+			gfxDeferredWrite(GFX_PAGE_OAM);
 			WRITE16LE(oam + (address & 0x3fe), value);
+			oamVersion++;
 			break;
 		case 8:
 		case 9:
@@ -1321,6 +1881,7 @@ static INLINE void CPUWriteByte(u32 address, u8 b)
 		case 5:
 			// no need to switch
 			*(u16 *)(paletteRAM + (address & 0x3FE)) = (b << 8) | b;
+			gfxUpdatePalette(address);
 			break;
 		case 6:
 			address = (address & 0x1fffe);
@@ -1331,8 +1892,12 @@ static INLINE void CPUWriteByte(u32 address, u8 b)
 
 			// no need to switch
 			// byte writes to OBJ VRAM are ignored
-			if ((address) < objTilesAddress[(R_DISPCNT_Video_Mode+1)>>2])
+			if ((address) < objTilesAddress[(R_DISPCNT_Video_Mode+1)>>2] &&
+					*(u16 *)(vram + address) != (u16)((b << 8) | b)) {
+				gfxDeferredWrite(address >> GFX_PAGE_SHIFT);
 				*(u16 *)(vram + address) = (b << 8) | b;
+				gfxInvalidateTile(address);
+			}
 			break;
 		case 7:
 			// no need to switch
@@ -2094,14 +2659,22 @@ static void BIOS_RegisterRamReset(u32 flags)
 		if(flags & 0x02)
 			memset(internalRAM, 0, 0x7e00);		// don't clear 0x7e00-0x7fff, clear internal RAM
 
-		if(flags & 0x04)
+		if(flags & 0x04) {
 			memset(paletteRAM, 0, 0x400);	// clear palette RAM
+			gfxUpdateAllPalette();
+		}
 
-		if(flags & 0x08)
+		if(flags & 0x08) {
+			gfxDeferredWriteRange(0, 0x18000 >> GFX_PAGE_SHIFT);
 			memset(vram, 0, 0x18000);		// clear VRAM
+			gfxInvalidateAllTiles();
+		}
 
-		if(flags & 0x10)
+		if(flags & 0x10) {
+			gfxDeferredWrite(GFX_PAGE_OAM);
 			memset(oam, 0, 0x400);			// clean OAM
+			oamVersion++;
+		}
 
 		if(flags & 0x80) {
 			int i;
@@ -6645,17 +7218,20 @@ union TileEntry
 
 struct TileLine
 {
-   u32 pixels[8];
+   u16 colors[8];
+   u8 prios[8];
 };
 
-typedef const TileLine (*TileReader) (const u16 *, const int, const u8 *, u16 *, const u32);
+typedef const TileLine (*TileReader) (const u16 *, const int, const u8 *, u16 *, const u8);
 
-static inline void gfxDrawPixel(u32 *dest, const u8 color, const u16 *palette, const u32 prio)
+static inline void gfxDrawPixel(TileLine &tileLine, const int x, const u8 color, const u16 *palette, const u8 prio)
 {
-   *dest = color ? (READ16LE(&palette[color]) | prio): 0x80000000;
+   tileLine.colors[x] = palette[color];
+   tileLine.prios[x] = color ? prio : GFX_PRIO_TRANSPARENT;
 }
 
-inline const TileLine gfxReadTile(const u16 *screenSource, const int yyy, const u8 *charBase, u16 *palette, const u32 prio)
+template<int renderer_idx>
+inline const TileLine gfxReadTile(const u16 *screenSource, const int yyy, const u8 *charBase, u16 *palette, const u8 prio)
 {
    TileEntry tile;
    tile.val = READ16LE(screenSource);
@@ -6664,35 +7240,38 @@ inline const TileLine gfxReadTile(const u16 *screenSource, const int yyy, const
    if (tile.vFlip) tileY = 7 - tileY;
    TileLine tileLine;
 
-   const u8 *tileBase = &charBase[tile.tileNum * 64 + tileY * 8];
+   INIT_RENDERER_CONTEXT(renderer_idx);
+
+   const u8 *tileBase = gfxTileRow8<renderer_idx>((charBase - RENDERER_VRAM) + tile.tileNum * 64, tileY);
 
    if (!tile.hFlip)
    {
-      gfxDrawPixel(&tileLine.pixels[0], tileBase[0], palette, prio);
-      gfxDrawPixel(&tileLine.pixels[1], tileBase[1], palette, prio);
-      gfxDrawPixel(&tileLine.pixels[2], tileBase[2], palette, prio);
-      gfxDrawPixel(&tileLine.pixels[3], tileBase[3], palette, prio);
-      gfxDrawPixel(&tileLine.pixels[4], tileBase[4], palette, prio);
-      gfxDrawPixel(&tileLine.pixels[5], tileBase[5], palette, prio);
-      gfxDrawPixel(&tileLine.pixels[6], tileBase[6], palette, prio);
-      gfxDrawPixel(&tileLine.pixels[7], tileBase[7], palette, prio);
+      gfxDrawPixel(tileLine, 0, tileBase[0], palette, prio);
+      gfxDrawPixel(tileLine, 1, tileBase[1], palette, prio);
+      gfxDrawPixel(tileLine, 2, tileBase[2], palette, prio);
+      gfxDrawPixel(tileLine, 3, tileBase[3], palette, prio);
+      gfxDrawPixel(tileLine, 4, tileBase[4], palette, prio);
+      gfxDrawPixel(tileLine, 5, tileBase[5], palette, prio);
+      gfxDrawPixel(tileLine, 6, tileBase[6], palette, prio);
+      gfxDrawPixel(tileLine, 7, tileBase[7], palette, prio);
    }
    else
    {
-      gfxDrawPixel(&tileLine.pixels[0], tileBase[7], palette, prio);
-      gfxDrawPixel(&tileLine.pixels[1], tileBase[6], palette, prio);
-      gfxDrawPixel(&tileLine.pixels[2], tileBase[5], palette, prio);
-      gfxDrawPixel(&tileLine.pixels[3], tileBase[4], palette, prio);
-      gfxDrawPixel(&tileLine.pixels[4], tileBase[3], palette, prio);
-      gfxDrawPixel(&tileLine.pixels[5], tileBase[2], palette, prio);
-      gfxDrawPixel(&tileLine.pixels[6], tileBase[1], palette, prio);
-      gfxDrawPixel(&tileLine.pixels[7], tileBase[0], palette, prio);
+      gfxDrawPixel(tileLine, 0, tileBase[7], palette, prio);
+      gfxDrawPixel(tileLine, 1, tileBase[6], palette, prio);
+      gfxDrawPixel(tileLine, 2, tileBase[5], palette, prio);
+      gfxDrawPixel(tileLine, 3, tileBase[4], palette, prio);
+      gfxDrawPixel(tileLine, 4, tileBase[3], palette, prio);
+      gfxDrawPixel(tileLine, 5, tileBase[2], palette, prio);
+      gfxDrawPixel(tileLine, 6, tileBase[1], palette, prio);
+      gfxDrawPixel(tileLine, 7, tileBase[0], palette, prio);
    }
 
    return tileLine;
 }
 
-inline const TileLine gfxReadTilePal(const u16 *screenSource, const int yyy, const u8 *charBase, u16 *palette, const u32 prio)
+template<int renderer_idx>
+inline const TileLine gfxReadTilePal(const u16 *screenSource, const int yyy, const u8 *charBase, u16 *palette, const u8 prio)
 {
    TileEntry tile;
    tile.val = READ16LE(screenSource);
@@ -6702,61 +7281,65 @@ inline const TileLine gfxReadTilePal(const u16 *screenSource, const int yyy, con
    palette += tile.palette * 16;
    TileLine tileLine;
 
-   const u8h *tileBase = (u8h*) &charBase[tile.tileNum * 32 + tileY * 4];
+   INIT_RENDERER_CONTEXT(renderer_idx);
+
+   const u8 *tileBase = gfxTileRow4<renderer_idx>((charBase - RENDERER_VRAM) + tile.tileNum * 32, tileY);
 
    if (!tile.hFlip)
    {
-      gfxDrawPixel(&tileLine.pixels[0], tileBase[0].lo, palette, prio);
-      gfxDrawPixel(&tileLine.pixels[1], tileBase[0].hi, palette, prio);
-      gfxDrawPixel(&tileLine.pixels[2], tileBase[1].lo, palette, prio);
-      gfxDrawPixel(&tileLine.pixels[3], tileBase[1].hi, palette, prio);
-      gfxDrawPixel(&tileLine.pixels[4], tileBase[2].lo, palette, prio);
-      gfxDrawPixel(&tileLine.pixels[5], tileBase[2].hi, palette, prio);
-      gfxDrawPixel(&tileLine.pixels[6], tileBase[3].lo, palette, prio);
-      gfxDrawPixel(&tileLine.pixels[7], tileBase[3].hi, palette, prio);
+      gfxDrawPixel(tileLine, 0, tileBase[0], palette, prio);
+      gfxDrawPixel(tileLine, 1, tileBase[1], palette, prio);
+      gfxDrawPixel(tileLine, 2, tileBase[2], palette, prio);
+      gfxDrawPixel(tileLine, 3, tileBase[3], palette, prio);
+      gfxDrawPixel(tileLine, 4, tileBase[4], palette, prio);
+      gfxDrawPixel(tileLine, 5, tileBase[5], palette, prio);
+      gfxDrawPixel(tileLine, 6, tileBase[6], palette, prio);
+      gfxDrawPixel(tileLine, 7, tileBase[7], palette, prio);
    }
    else
    {
-      gfxDrawPixel(&tileLine.pixels[0], tileBase[3].hi, palette, prio);
-      gfxDrawPixel(&tileLine.pixels[1], tileBase[3].lo, palette, prio);
-      gfxDrawPixel(&tileLine.pixels[2], tileBase[2].hi, palette, prio);
-      gfxDrawPixel(&tileLine.pixels[3], tileBase[2].lo, palette, prio);
-      gfxDrawPixel(&tileLine.pixels[4], tileBase[1].hi, palette, prio);
-      gfxDrawPixel(&tileLine.pixels[5], tileBase[1].lo, palette, prio);
-      gfxDrawPixel(&tileLine.pixels[6], tileBase[0].hi, palette, prio);
-      gfxDrawPixel(&tileLine.pixels[7], tileBase[0].lo, palette, prio);
+      gfxDrawPixel(tileLine, 0, tileBase[7], palette, prio);
+      gfxDrawPixel(tileLine, 1, tileBase[6], palette, prio);
+      gfxDrawPixel(tileLine, 2, tileBase[5], palette, prio);
+      gfxDrawPixel(tileLine, 3, tileBase[4], palette, prio);
+      gfxDrawPixel(tileLine, 4, tileBase[3], palette, prio);
+      gfxDrawPixel(tileLine, 5, tileBase[2], palette, prio);
+      gfxDrawPixel(tileLine, 6, tileBase[1], palette, prio);
+      gfxDrawPixel(tileLine, 7, tileBase[0], palette, prio);
    }
 
    return tileLine;
 }
 
-static inline void gfxDrawTile(const TileLine &tileLine, u32* _line)
+static inline void gfxDrawTile(const TileLine &tileLine, const gfxLayerLine &_line, const int x)
 {
 #if HAVE_NEON
-   neon_memcpy(_line, tileLine.pixels, sizeof(tileLine.pixels));
+   neon_memcpy(_line.color + x, tileLine.colors, sizeof(tileLine.colors));
 #else
-   memcpy(_line, tileLine.pixels, sizeof(tileLine.pixels));
+   memcpy(_line.color + x, tileLine.colors, sizeof(tileLine.colors));
 #endif
+   memcpy(_line.prio + x, tileLine.prios, sizeof(tileLine.prios));
 }
 
-static inline void gfxDrawTileClipped(const TileLine &tileLine, u32* _line, const int start, int w)
+static inline void gfxDrawTileClipped(const TileLine &tileLine, const gfxLayerLine &_line, const int x, const int start, int w)
 {
 #if HAVE_NEON
-   neon_memcpy(_line, tileLine.pixels + start, w * sizeof(u32));
+   neon_memcpy(_line.color + x, tileLine.colors + start, w * sizeof(u16));
 #else
-   memcpy(_line, tileLine.pixels + start, w * sizeof(u32));
+   memcpy(_line.color + x, tileLine.colors + start, w * sizeof(u16));
 #endif
+   memcpy(_line.prio + x, tileLine.prios + start, w);
 }
 
 template<TileReader readTile, int layer, int renderer_idx>
-static void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs)
+static void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs, int x0, int x1)
 {
 	INIT_RENDERER_CONTEXT(renderer_idx);
 
    u16 *palette = (u16 *)RENDERER_PALETTE;
-   u8 *charBase = &vram[((control >> 2) & 0x03) * 0x4000];
-   u16 *screenBase = (u16 *)&vram[((control >> 8) & 0x1f) * 0x800];
-   u32 prio = ((control & 3)<<25) + 0x1000000;
+   u8 *charBase = &RENDERER_VRAM[((control >> 2) & 0x03) * 0x4000];
+   u16 *screenBase = (u16 *)&RENDERER_VRAM[((control >> 8) & 0x1f) * 0x800];
+   u8 prio = GFX_PRIO_LEVEL(control & 3) | GFX_PRIO_BG;
    int sizeX = 256;
    int sizeY = 256;
    switch ((control >> 14) & 3)
@@ -6780,7 +7363,7 @@ static void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs)
 
    bool mosaicOn = (control & 0x40) ? true : false;
 
-   int xxx = hofs & maskX;
+   int xxx = (hofs + x0) & maskX;
    int yyy = (vofs + RENDERER_R_VCOUNT) & maskY;
    int mosaicX = (RENDERER_MOSAIC & 0x000F)+1;
    int mosaicY = ((RENDERER_MOSAIC & 0x00F0)>>4)+1;
@@ -6805,13 +7388,13 @@ static void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs)
    int yshift = ((yyy>>3)<<5);
 
    u16 *screenSource = screenBase + 0x400 * (xxx>>8) + ((xxx & 255)>>3) + yshift;
-   int x = 0;
+   int x = x0;
    const int firstTileX = xxx & 7;
 
    // First tile, if clipped
    if (firstTileX)
    {
-      gfxDrawTileClipped(readTile(screenSource, yyy, charBase, palette, prio), &RENDERER_LINE[layer][x], firstTileX, 8 - firstTileX);
+      gfxDrawTileClipped(readTile(screenSource, yyy, charBase, palette, prio), RENDERER_LINE[layer], x, firstTileX, 8 - firstTileX);
       screenSource++;
       x += 8 - firstTileX;
       xxx += 8 - firstTileX;
@@ -6828,9 +7411,9 @@ static void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs)
    }
 
    // Middle tiles, full
-   while (x < 240 - firstTileX)
+   while (x < x1 - firstTileX)
    {
-      gfxDrawTile(readTile(screenSource, yyy, charBase, palette, prio), &RENDERER_LINE[layer][x]);
+      gfxDrawTile(readTile(screenSource, yyy, charBase, palette, prio), RENDERER_LINE[layer], x);
       screenSource++;
       xxx += 8;
       x += 8;
@@ -6849,7 +7432,7 @@ static void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs)
    // Last tile, if clipped
    if (firstTileX)
    {
-      gfxDrawTileClipped(readTile(screenSource, yyy, charBase, palette, prio), &RENDERER_LINE[layer][x], 0, firstTileX);
+      gfxDrawTileClipped(readTile(screenSource, yyy, charBase, palette, prio), RENDERER_LINE[layer], x, 0, firstTileX);
    }
 
    if (mosaicOn)
@@ -6862,22 +7445,24 @@ static void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs)
 }
 
 template<int layer, int renderer_idx>
-void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs)
+void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs, int x0, int x1)
 {
    if (control & 0x80) // 1 pal / 256 col
-      gfxDrawTextScreen<gfxReadTile, layer, renderer_idx>(control, hofs, vofs);
+      gfxDrawTextScreen<gfxReadTile<renderer_idx>, layer, renderer_idx>(control, hofs, vofs, x0, x1);
    else // 16 pal / 16 col
-      gfxDrawTextScreen<gfxReadTilePal, layer, renderer_idx>(control, hofs, vofs);
+      gfxDrawTextScreen<gfxReadTilePal<renderer_idx>, layer, renderer_idx>(control, hofs, vofs, x0, x1);
 }
 #else
 
 template<int layer, int renderer_idx>
-static inline void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs)
+static inline void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs, int x0, int x1)
 {
+  INIT_RENDERER_CONTEXT(renderer_idx);
+
   u16 *palette = (u16 *)RENDERER_PALETTE;
-  u8 *charBase = &vram[((control >> 2) & 0x03) * 0x4000];
-  u16 *screenBase = (u16 *)&vram[((control >> 8) & 0x1f) * 0x800];
-  u32 prio = ((control & 3)<<25) + 0x1000000;
+  u32 charOffset = ((control >> 2) & 0x03) * 0x4000;
+  u16 *screenBase = (u16 *)&RENDERER_VRAM[((control >> 8) & 0x1f) * 0x800];
+  u8 prio = GFX_PRIO_LEVEL(control & 3) | GFX_PRIO_BG;
   int sizeX = 256;
   int sizeY = 256;
   switch((control >> 14) & 3) {
@@ -6900,7 +7485,7 @@ static inline void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs)
 
   bool mosaicOn = (control & 0x40) ? true : false;
 
-  int xxx = hofs & maskX;
+  int xxx = (hofs + x0) & maskX;
   int yyy = (vofs + RENDERER_R_VCOUNT) & maskY;
   int mosaicX = (RENDERER_MOSAIC & 0x000F)+1;
   int mosaicY = ((RENDERER_MOSAIC & 0x00F0)>>4)+1;
@@ -6920,26 +7505,30 @@ static inline void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs)
   }
 
   int yshift = ((yyy>>3)<<5);
+  u16 data = 0;
+  const u8 *tileRow = NULL;
   if((control) & 0x80) {
     u16 *screenSource = screenBase + 0x400 * (xxx>>8) + ((xxx & 255)>>3) + yshift;
-    for(int x = 0; x < 240; x++) {
-      u16 data = READ16LE(screenSource);
-
-      int tile = data & 0x3FF;
+    for(int x = x0; x < x1; x++) {
       int tileX = (xxx & 7);
-      int tileY = yyy & 7;
+      if(tileX == 0 || x == x0) {
+        data = READ16LE(screenSource);
+        int tileY = yyy & 7;
+        if(data & 0x0800)
+          tileY = 7 - tileY;
+        tileRow = gfxTileRow8<renderer_idx>(charOffset + (data & 0x3FF) * 64, tileY);
+      }
 
       if(tileX == 7)
         screenSource++;
 
       if(data & 0x0400)
         tileX = 7 - tileX;
-      if(data & 0x0800)
-        tileY = 7 - tileY;
 
-      u8 color = charBase[tile * 64 + tileY * 8 + tileX];
+      u8 color = tileRow[tileX];
 
-      RENDERER_LINE[layer][x] = color ? (READ16LE(&palette[color]) | prio): 0x80000000;
+      RENDERER_LINE[layer].color[x] = palette[color];
+      RENDERER_LINE[layer].prio[x] = color ? prio : GFX_PRIO_TRANSPARENT;
 
       xxx++;
       if(xxx == 256) {
@@ -6957,31 +7546,27 @@ static inline void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs)
   } else {
     u16 *screenSource = screenBase + 0x400*(xxx>>8)+((xxx&255)>>3) +
       yshift;
-    for(int x = 0; x < 240; x++) {
-      u16 data = READ16LE(screenSource);
-
-      int tile = data & 0x3FF;
+    for(int x = x0; x < x1; x++) {
       int tileX = (xxx & 7);
-      int tileY = yyy & 7;
+      if(tileX == 0 || x == x0) {
+        data = READ16LE(screenSource);
+        int tileY = yyy & 7;
+        if(data & 0x0800)
+          tileY = 7 - tileY;
+        tileRow = gfxTileRow4<renderer_idx>(charOffset + ((data & 0x3FF)<<5), tileY);
+      }
 
       if(tileX == 7)
         screenSource++;
 
       if(data & 0x0400)
         tileX = 7 - tileX;
-      if(data & 0x0800)
-        tileY = 7 - tileY;
 
-      u8 color = charBase[(tile<<5) + (tileY<<2) + (tileX>>1)];
-
-      if(tileX & 1) {
-        color = (color >> 4);
-      } else {
-        color &= 0x0F;
-      }
+      u8 color = tileRow[tileX];
 
       int pal = (data>>8) & 0xF0;
-      RENDERER_LINE[layer][x] = color ? (READ16LE(&palette[pal + color])|prio): 0x80000000;
+      RENDERER_LINE[layer].color[x] = palette[pal + color];
+      RENDERER_LINE[layer].prio[x] = color ? prio : GFX_PRIO_TRANSPARENT;
 
       xxx++;
       if(xxx == 256) {
@@ -7208,61 +7793,386 @@ static INLINE void fetchDrawRotScreen16Bit160(int& currentX, int& currentY, int
 	}
 }
 
-template<int layer, int renderer_idx>
-static INLINE void gfxDrawRotScreen(u16 control, u16 x_l, u16 x_h, u16 y_l, u16 y_h,
-u16 pa,  u16 pb, u16 pc,  u16 pd, int& currentX, int& currentY, int changed)
+/* Rounds towards positive infinity, as the sampled range of a rotation
+   background can start left of pixel 0. */
+static INLINE int gfxCeilDiv(int a, int d)
 {
-	INIT_RENDERER_CONTEXT(renderer_idx);
-
-	u16 *palette = (u16 *)RENDERER_PALETTE;
-	u8 *charBase = &vram[((control >> 2) & 0x03) << 14];
-	u8 *screenBase = (u8 *)&vram[((control >> 8) & 0x1f) << 11];
-	int prio = ((control & 3) << 25) + 0x1000000;
+	return (a >= 0) ? (a + d - 1) / d : -((-a) / d);
+}
 
-	u32 map_size = (control >> 14) & 3;
-	u32 sizeX = map_sizes_rot[map_size];
-	u32 sizeY = map_sizes_rot[map_size];
+// Mosaic blocks stay aligned to the left edge of the screen; a block that
+// starts before x0 takes its colour from x0.
+static INLINE void gfxMosaicRotLine(const gfxLayerLine& line, int mosaicX, int x0, int x1)
+{
+	for(int x = x0; x < x1; ++x) {
+		int start = max(x - (((x % mosaicX) + mosaicX) % mosaicX), x0);
+		line.color[x] = line.color[start];
+		line.prio[x] = line.prio[start];
+	}
+}
 
-	int maskX = sizeX-1;
-	int maskY = sizeY-1;
+/*
+Bitmap lines without rotation or scaling.
 
-	int yshift = ((control >> 14) & 3)+4;
+With PA at 1.0 and PC at 0 a bitmap line reads one run of VRAM, pixel for
+pixel, so the run is converted in one go instead of stepping the reference
+point and checking the bounds at every pixel. That is how nearly every FMV
+and bitmap game sets up BG2.
+*/
+static INLINE bool gfxBitmapSpan(int col, int row, int width, int height, int x0, int x1, int& first, int& last)
+{
+	if(row < 0 || row >= height)
+		return false;
+	first = max(x0, x0 - col);
+	last = min(x1, x0 - col + width);
+	return first < last;
+}
 
-#ifdef BRANCHLESS_GBA_GFX
-	int dx = pa & 0x7FFF;
-	int dmx = pb & 0x7FFF;
-	int dy = pc & 0x7FFF;
-	int dmy = pd & 0x7FFF;
+static INLINE void gfxBitmapRow16(const gfxLayerLine& dst, const u16 *src, int count, u8 prio)
+{
+	memset(dst.prio, prio, count);
+	int x = 0;
+#if (GFX_SSE2 || GFX_NEON) && !defined(MSB_FIRST)
+	for(; x + 8 <= count; x += 8) {
+#if GFX_SSE2
+		__m128i c = _mm_loadu_si128((const __m128i *)(src + x));
+		__m128i r = _mm_and_si128(c, _mm_set1_epi16(0x001F));
+		__m128i g = _mm_and_si128(c, _mm_set1_epi16(0x03E0));
+		__m128i b = _mm_srli_epi16(_mm_and_si128(c, _mm_set1_epi16(0x7C00)), 10);
+#ifdef FRONTEND_SUPPORTS_RGB565
+		c = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(g, 1)),
+			_mm_or_si128(_mm_srli_epi16(_mm_and_si128(g, _mm_set1_epi16(0x0200)), 4), b));
+#else
+		c = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 10), g), b);
+#endif
+		_mm_storeu_si128((__m128i *)(dst.color + x), c);
+#else
+		uint16x8_t c = vld1q_u16(src + x);
+		uint16x8_t r = vandq_u16(c, vdupq_n_u16(0x001F));
+		uint16x8_t g = vandq_u16(c, vdupq_n_u16(0x03E0));
+		uint16x8_t b = vshrq_n_u16(vandq_u16(c, vdupq_n_u16(0x7C00)), 10);
+#ifdef FRONTEND_SUPPORTS_RGB565
+		c = vorrq_u16(vorrq_u16(vshlq_n_u16(r, 11), vshlq_n_u16(g, 1)),
+			vorrq_u16(vshrq_n_u16(vandq_u16(g, vdupq_n_u16(0x0200)), 4), b));
+#else
+		c = vorrq_u16(vorrq_u16(vshlq_n_u16(r, 10), g), b);
+#endif
+		vst1q_u16(dst.color + x, c);
+#endif
+	}
+#endif
+	for(; x < count; ++x)
+		dst.color[x] = CONVERT_COLOR(READ16LE(&src[x]));
+}
 
-	dx |= isel(-(pa & 0x8000), 0, 0xFFFF8000);
+// colour 0 stays transparent
+static INLINE void gfxBitmapRow8(const gfxLayerLine& dst, const u8 *src, int count, const u16 *palette, u8 prio)
+{
+	for(int x = 0; x < count; ++x) {
+		u8 color = src[x];
+		if(color) {
+			dst.color[x] = palette[color];
+			dst.prio[x] = prio;
+		}
+	}
+}
 
-	dmx |= isel(-(pb & 0x8000), 0, 0xFFFF8000);
+/*
+Rotated and scaled backgrounds.
 
-	dy |= isel(-(pc & 0x8000), 0, 0xFFFF8000);
+Lines that need the full affine walk are sampled in two passes. The texel
+coordinates of the span are stepped a vector at a time, with wraparound
+folded in by masking and culled pixels set to -1. The texels are then
+fetched as a batch, using gathers on AVX2 and a table walk elsewhere.
+*/
+#if GFX_AVX2
+static bool gfxAffineGather = false;
+#endif
 
-	dmy |= isel(-(pd & 0x8000), 0, 0xFFFF8000);
-#else
-	int dx = pa & 0x7FFF;
-	if(pa & 0x8000)
-		dx |= 0xFFFF8000;
-	int dmx = pb & 0x7FFF;
-	if(pb & 0x8000)
-		dmx |= 0xFFFF8000;
-	int dy = pc & 0x7FFF;
-	if(pc & 0x8000)
-		dy |= 0xFFFF8000;
-	int dmy = pd & 0x7FFF;
-	if(pd & 0x8000)
-		dmy |= 0xFFFF8000;
+static void gfxAffineCoords(s32 *xs, s32 *ys, int count, int realX, int realY, int dx, int dy, int sizeX, int sizeY, bool wrap)
+{
+	int x = 0;
+#if GFX_SSE2
+	__m128i vx = _mm_setr_epi32(realX, realX + dx, realX + 2 * dx, realX + 3 * dx);
+	__m128i vy = _mm_setr_epi32(realY, realY + dy, realY + 2 * dy, realY + 3 * dy);
+	const __m128i stepX = _mm_set1_epi32(4 * dx);
+	const __m128i stepY = _mm_set1_epi32(4 * dy);
+	const __m128i maskX = _mm_set1_epi32(sizeX - 1);
+	const __m128i maskY = _mm_set1_epi32(sizeY - 1);
+	const __m128i limitX = _mm_set1_epi32(sizeX);
+	const __m128i limitY = _mm_set1_epi32(sizeY);
+	const __m128i ones = _mm_set1_epi32(-1);
+	for(; x + 4 <= count; x += 4) {
+		__m128i cx = _mm_srai_epi32(vx, 8);
+		__m128i cy = _mm_srai_epi32(vy, 8);
+		if(wrap) {
+			cx = _mm_and_si128(cx, maskX);
+			cy = _mm_and_si128(cy, maskY);
+		} else {
+			__m128i valid = _mm_and_si128(
+				_mm_and_si128(_mm_cmpgt_epi32(cx, ones), _mm_cmplt_epi32(cx, limitX)),
+				_mm_and_si128(_mm_cmpgt_epi32(cy, ones), _mm_cmplt_epi32(cy, limitY)));
+			__m128i culled = _mm_xor_si128(valid, ones);
+			cx = _mm_or_si128(cx, culled);
+			cy = _mm_or_si128(cy, culled);
+		}
+		_mm_storeu_si128((__m128i *)(xs + x), cx);
+		_mm_storeu_si128((__m128i *)(ys + x), cy);
+		vx = _mm_add_epi32(vx, stepX);
+		vy = _mm_add_epi32(vy, stepY);
+	}
+	realX += x * dx;
+	realY += x * dy;
+#elif GFX_NEON
+	const int32_t lanes[4] = { 0, 1, 2, 3 };
+	int32x4_t vx = vmlaq_n_s32(vdupq_n_s32(realX), vld1q_s32(lanes), dx);
+	int32x4_t vy = vmlaq_n_s32(vdupq_n_s32(realY), vld1q_s32(lanes), dy);
+	const int32x4_t stepX = vdupq_n_s32(4 * dx);
+	const int32x4_t stepY = vdupq_n_s32(4 * dy);
+	const int32x4_t maskX = vdupq_n_s32(sizeX - 1);
+	const int32x4_t maskY = vdupq_n_s32(sizeY - 1);
+	const uint32x4_t limitX = vdupq_n_u32(sizeX);
+	const uint32x4_t limitY = vdupq_n_u32(sizeY);
+	for(; x + 4 <= count; x += 4) {
+		int32x4_t cx = vshrq_n_s32(vx, 8);
+		int32x4_t cy = vshrq_n_s32(vy, 8);
+		if(wrap) {
+			cx = vandq_s32(cx, maskX);
+			cy = vandq_s32(cy, maskY);
+		} else {
+			uint32x4_t culled = vmvnq_u32(vandq_u32(
+				vcltq_u32(vreinterpretq_u32_s32(cx), limitX),
+				vcltq_u32(vreinterpretq_u32_s32(cy), limitY)));
+			cx = vorrq_s32(cx, vreinterpretq_s32_u32(culled));
+			cy = vorrq_s32(cy, vreinterpretq_s32_u32(culled));
+		}
+		vst1q_s32(xs + x, cx);
+		vst1q_s32(ys + x, cy);
+		vx = vaddq_s32(vx, stepX);
+		vy = vaddq_s32(vy, stepY);
+	}
+	realX += x * dx;
+	realY += x * dy;
 #endif
+	for(; x < count; ++x) {
+		int cx = realX >> 8;
+		int cy = realY >> 8;
+		if(wrap) {
+			cx &= sizeX - 1;
+			cy &= sizeY - 1;
+		} else if(unsigned(cx) >= unsigned(sizeX) || unsigned(cy) >= unsigned(sizeY)) {
+			cx = -1;
+			cy = -1;
+		}
+		xs[x] = cx;
+		ys[x] = cy;
+		realX += dx;
+		realY += dy;
+	}
+}
 
-	if(RENDERER_R_VCOUNT == 0)
-		changed = 3;
+#if GFX_AVX2
+static GFX_AVX2_TARGET INLINE void gfxStoreTexels8AVX2(u8 *dst, __m256i texels)
+{
+	__m128i words = _mm_packus_epi32(_mm256_castsi256_si128(texels), _mm256_extracti128_si256(texels, 1));
+	_mm_storel_epi64((__m128i *)dst, _mm_packus_epi16(words, words));
+}
 
-	currentX += dmx;
-	currentY += dmy;
+static GFX_AVX2_TARGET int gfxTileTexelsAVX2(u8 *colors, const s32 *xs, const s32 *ys, int count, const u8 *screenBase, const u8 *charBase, int yshift)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i bytes = _mm256_set1_epi32(0xFF);
+	const __m256i seven = _mm256_set1_epi32(7);
+	const __m128i shift = _mm_cvtsi32_si128(yshift);
+	int x = 0;
+	for(; x + 8 <= count; x += 8) {
+		__m256i cx = _mm256_loadu_si256((const __m256i *)(xs + x));
+		__m256i cy = _mm256_loadu_si256((const __m256i *)(ys + x));
+		__m256i valid = _mm256_cmpgt_epi32(cx, _mm256_set1_epi32(-1));
+		__m256i map = _mm256_or_si256(_mm256_srli_epi32(cx, 3), _mm256_sll_epi32(_mm256_srli_epi32(cy, 3), shift));
+		__m256i tile = _mm256_and_si256(_mm256_mask_i32gather_epi32(zero, (const int *)screenBase, map, valid, 1), bytes);
+		__m256i texel = _mm256_or_si256(_mm256_slli_epi32(tile, 6),
+			_mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(cy, seven), 3), _mm256_and_si256(cx, seven)));
+		gfxStoreTexels8AVX2(colors + x, _mm256_and_si256(_mm256_mask_i32gather_epi32(zero, (const int *)charBase, texel, valid, 1), bytes));
+	}
+	return x;
+}
 
-	if(changed & 1)
+static GFX_AVX2_TARGET int gfxBitmapTexels8AVX2(u8 *colors, const s32 *xs, const s32 *ys, int count, const u8 *screenBase, int width)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i w = _mm256_set1_epi32(width);
+	int x = 0;
+	for(; x + 8 <= count; x += 8) {
+		__m256i cx = _mm256_loadu_si256((const __m256i *)(xs + x));
+		__m256i cy = _mm256_loadu_si256((const __m256i *)(ys + x));
+		__m256i valid = _mm256_cmpgt_epi32(cx, _mm256_set1_epi32(-1));
+		__m256i offset = _mm256_add_epi32(_mm256_mullo_epi32(cy, w), cx);
+		__m256i texel = _mm256_mask_i32gather_epi32(zero, (const int *)screenBase, offset, valid, 1);
+		gfxStoreTexels8AVX2(colors + x, _mm256_and_si256(texel, _mm256_set1_epi32(0xFF)));
+	}
+	return x;
+}
+
+static GFX_AVX2_TARGET int gfxBitmapTexels16AVX2(const gfxLayerLine& dst, const s32 *xs, const s32 *ys, int count, const u16 *screenBase, int width, u8 prio)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m128i p = _mm_set1_epi8((char)prio);
+	const __m256i w = _mm256_set1_epi32(width);
+	int x = 0;
+	for(; x + 8 <= count; x += 8) {
+		__m256i cx = _mm256_loadu_si256((const __m256i *)(xs + x));
+		__m256i cy = _mm256_loadu_si256((const __m256i *)(ys + x));
+		__m256i valid = _mm256_cmpgt_epi32(cx, _mm256_set1_epi32(-1));
+		__m256i offset = _mm256_add_epi32(_mm256_mullo_epi32(cy, w), cx);
+		__m256i c = _mm256_mask_i32gather_epi32(zero, (const int *)screenBase, offset, valid, 2);
+		__m256i r = _mm256_and_si256(c, _mm256_set1_epi32(0x001F));
+		__m256i g = _mm256_and_si256(c, _mm256_set1_epi32(0x03E0));
+		__m256i b = _mm256_srli_epi32(_mm256_and_si256(c, _mm256_set1_epi32(0x7C00)), 10);
+#ifdef FRONTEND_SUPPORTS_RGB565
+		c = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(r, 11), _mm256_slli_epi32(g, 1)),
+			_mm256_or_si256(_mm256_srli_epi32(_mm256_and_si256(g, _mm256_set1_epi32(0x0200)), 4), b));
+#else
+		c = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(r, 10), g), b);
+#endif
+		// culled texels keep the 0xFF the line was cleared to
+		__m128i culled = _mm_packs_epi32(_mm256_castsi256_si128(valid), _mm256_extracti128_si256(valid, 1));
+		culled = _mm_xor_si128(_mm_packs_epi16(culled, culled), _mm_set1_epi8(-1));
+		_mm_storeu_si128((__m128i *)(dst.color + x), _mm_packus_epi32(_mm256_castsi256_si128(c), _mm256_extracti128_si256(c, 1)));
+		_mm_storel_epi64((__m128i *)(dst.prio + x), _mm_or_si128(p, culled));
+	}
+	return x;
+}
+#endif
+
+// culled texels read as colour 0
+static INLINE void gfxTileTexels(u8 *colors, const s32 *xs, const s32 *ys, int count, const u8 *screenBase, const u8 *charBase, int yshift)
+{
+	int x = 0;
+#if GFX_AVX2
+	if(gfxAffineGather)
+		x = gfxTileTexelsAVX2(colors, xs, ys, count, screenBase, charBase, yshift);
+#endif
+	for(; x < count; ++x) {
+		int cx = xs[x];
+		int cy = ys[x];
+		if(cx < 0) {
+			colors[x] = 0;
+			continue;
+		}
+		unsigned tile = screenBase[(cx >> 3) | ((cy >> 3) << yshift)];
+		colors[x] = charBase[(tile << 6) | ((cy & 7) << 3) | (cx & 7)];
+	}
+}
+
+static INLINE void gfxBitmapTexels8(u8 *colors, const s32 *xs, const s32 *ys, int count, const u8 *screenBase, int width)
+{
+	int x = 0;
+#if GFX_AVX2
+	if(gfxAffineGather)
+		x = gfxBitmapTexels8AVX2(colors, xs, ys, count, screenBase, width);
+#endif
+	for(; x < count; ++x)
+		colors[x] = xs[x] < 0 ? 0 : screenBase[ys[x] * width + xs[x]];
+}
+
+static INLINE void gfxBitmapTexels16(const gfxLayerLine& dst, const s32 *xs, const s32 *ys, int count, const u16 *screenBase, int width, u8 prio)
+{
+	int x = 0;
+#if GFX_AVX2
+	if(gfxAffineGather)
+		x = gfxBitmapTexels16AVX2(dst, xs, ys, count, screenBase, width, prio);
+#endif
+	for(; x < count; ++x)
+		if(xs[x] >= 0) {
+			dst.color[x] = CONVERT_COLOR(READ16LE(&screenBase[ys[x] * width + xs[x]]));
+			dst.prio[x] = prio;
+		}
+}
+
+static INLINE void gfxDrawAffineTiles(const gfxLayerLine& line, int x0, int x1, int realX, int realY, int dx, int dy, int size, bool wrap,
+const u8 *screenBase, const u8 *charBase, int yshift, const u16 *palette, u8 prio)
+{
+	s32 xs[LINE_BUFFER_WIDTH], ys[LINE_BUFFER_WIDTH];
+	u8 colors[LINE_BUFFER_WIDTH];
+	gfxAffineCoords(xs, ys, x1 - x0, realX, realY, dx, dy, size, size, wrap);
+	gfxTileTexels(colors, xs, ys, x1 - x0, screenBase, charBase, yshift);
+	gfxBitmapRow8(gfxLineFrom(line, x0), colors, x1 - x0, palette, prio);
+}
+
+static INLINE void gfxDrawAffineBitmap8(const gfxLayerLine& line, int x0, int x1, int realX, int realY, int dx, int dy, int width, int height,
+const u8 *screenBase, const u16 *palette, u8 prio)
+{
+	s32 xs[LINE_BUFFER_WIDTH], ys[LINE_BUFFER_WIDTH];
+	u8 colors[LINE_BUFFER_WIDTH];
+	gfxAffineCoords(xs, ys, x1 - x0, realX, realY, dx, dy, width, height, false);
+	gfxBitmapTexels8(colors, xs, ys, x1 - x0, screenBase, width);
+	gfxBitmapRow8(gfxLineFrom(line, x0), colors, x1 - x0, palette, prio);
+}
+
+static INLINE void gfxDrawAffineBitmap16(const gfxLayerLine& line, int x0, int x1, int realX, int realY, int dx, int dy, int width, int height,
+const u16 *screenBase, u8 prio)
+{
+	s32 xs[LINE_BUFFER_WIDTH], ys[LINE_BUFFER_WIDTH];
+	gfxAffineCoords(xs, ys, x1 - x0, realX, realY, dx, dy, width, height, false);
+	gfxBitmapTexels16(gfxLineFrom(line, x0), xs, ys, x1 - x0, screenBase, width, prio);
+}
+
+template<int layer, int renderer_idx>
+static INLINE void gfxDrawRotScreen(u16 control, u16 x_l, u16 x_h, u16 y_l, u16 y_h,
+u16 pa,  u16 pb, u16 pc,  u16 pd, int& currentX, int& currentY, int changed, int x0, int x1)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+	u16 *palette = (u16 *)RENDERER_PALETTE;
+	u8 *charBase = &RENDERER_VRAM[((control >> 2) & 0x03) << 14];
+	u8 *screenBase = (u8 *)&RENDERER_VRAM[((control >> 8) & 0x1f) << 11];
+	u8 prio = GFX_PRIO_LEVEL(control & 3) | GFX_PRIO_BG;
+
+	u32 map_size = (control >> 14) & 3;
+	u32 sizeX = map_sizes_rot[map_size];
+	u32 sizeY = map_sizes_rot[map_size];
+
+	int maskX = sizeX-1;
+	int maskY = sizeY-1;
+
+	int yshift = ((control >> 14) & 3)+4;
+
+#ifdef BRANCHLESS_GBA_GFX
+	int dx = pa & 0x7FFF;
+	int dmx = pb & 0x7FFF;
+	int dy = pc & 0x7FFF;
+	int dmy = pd & 0x7FFF;
+
+	dx |= isel(-(pa & 0x8000), 0, 0xFFFF8000);
+
+	dmx |= isel(-(pb & 0x8000), 0, 0xFFFF8000);
+
+	dy |= isel(-(pc & 0x8000), 0, 0xFFFF8000);
+
+	dmy |= isel(-(pd & 0x8000), 0, 0xFFFF8000);
+#else
+	int dx = pa & 0x7FFF;
+	if(pa & 0x8000)
+		dx |= 0xFFFF8000;
+	int dmx = pb & 0x7FFF;
+	if(pb & 0x8000)
+		dmx |= 0xFFFF8000;
+	int dy = pc & 0x7FFF;
+	if(pc & 0x8000)
+		dy |= 0xFFFF8000;
+	int dmy = pd & 0x7FFF;
+	if(pd & 0x8000)
+		dmy |= 0xFFFF8000;
+#endif
+
+	if(RENDERER_R_VCOUNT == 0)
+		changed = 3;
+
+	currentX += dmx;
+	currentY += dmy;
+
+	if(changed & 1)
 	{
 		currentX = (x_l) | ((x_h & 0x07FF)<<16);
 		if(x_h & 0x0800)
@@ -7287,7 +8197,10 @@ u16 pa,  u16 pb, u16 pc,  u16 pd, int& currentX, int& currentY, int changed)
 		realY -= y*dmy;
 	}
 
-	memset(RENDERER_LINE[layer], -1, 240 * sizeof(u32));
+	realX += x0 * dx;
+	realY += x0 * dy;
+
+	memset(RENDERER_LINE[layer].prio + x0, -1, x1 - x0);
 	if(control & 0x2000) // Wraparound
 	{
 		if(dx > 0 && dy == 0) // Common subcase: no rotation or flipping
@@ -7297,7 +8210,7 @@ u16 pa,  u16 pb, u16 pc,  u16 pd, int& currentX, int& currentY, int changed)
 			unsigned tileY = yyy & 7;
 			unsigned tileYshift = (tileY<<3);
 
-			for(u32 x = 0; x < 240u; ++x)
+			for(int x = x0; x < x1; ++x)
 			{
 				unsigned xxx = (realX >> 8) & maskX;
 
@@ -7307,29 +8220,16 @@ u16 pa,  u16 pb, u16 pc,  u16 pd, int& currentX, int& currentY, int changed)
 
 				u8 color = charBase[(tile<<6) | tileYshift | tileX];
 
-				if(color) RENDERER_LINE[layer][x] = (READ16LE(&palette[color])|prio);
+				if(color) {
+					RENDERER_LINE[layer].color[x] = palette[color];
+					RENDERER_LINE[layer].prio[x] = prio;
+				}
 
 				realX += dx;
 			}
 		}
 		else
-			for(u32 x = 0; x < 240u; ++x)
-			{
-				unsigned xxx = (realX >> 8) & maskX;
-				unsigned yyy = (realY >> 8) & maskY;
-
-				unsigned tile = screenBase[(xxx>>3) | ((yyy>>3)<<yshift)];
-
-				unsigned tileX = (xxx & 7);
-				unsigned tileY = yyy & 7;
-
-				u8 color = charBase[(tile<<6) | (tileY<<3) | tileX];
-
-				if(color) RENDERER_LINE[layer][x] = (READ16LE(&palette[color])|prio);
-
-				realX += dx;
-				realY += dy;
-			}
+			gfxDrawAffineTiles(RENDERER_LINE[layer], x0, x1, realX, realY, dx, dy, sizeX, true, screenBase, charBase, yshift, palette, prio);
 	}
 	else // Culling
 	{
@@ -7342,15 +8242,15 @@ u16 pa,  u16 pb, u16 pc,  u16 pd, int& currentX, int& currentY, int changed)
 			unsigned tileY = yyy & 7;
 			unsigned tileYshift = (tileY<<3);
 
-			u32 x0 = max(  0, (int32_t)(             + (-realX + dx - 1)) / dx);
-			u32 x1 = min(240, (int32_t)((sizeX << 8) + (-realX + dx - 1)) / dx);
-			
-			if (x1 >= sizeX)
+			int first = max(x0, x0 + gfxCeilDiv(-realX, dx));
+			int last = min(x1, x0 + gfxCeilDiv((int)(sizeX << 8) - realX, dx));
+
+			if (last >= (int)sizeX)
 				goto skipLine;
 
-			realX += dx * x0;
+			realX += dx * (first - x0);
 
-			for(u32 x = x0; x < x1; ++x)
+			for(int x = first; x < last; ++x)
 			{
 				unsigned xxx = (realX >> 8);
 
@@ -7360,32 +8260,16 @@ u16 pa,  u16 pb, u16 pc,  u16 pd, int& currentX, int& currentY, int changed)
 
 				u8 color = charBase[(tile<<6) | tileYshift | tileX];
 
-				if(color) RENDERER_LINE[layer][x] = (READ16LE(&palette[color])|prio);
+				if(color) {
+					RENDERER_LINE[layer].color[x] = palette[color];
+					RENDERER_LINE[layer].prio[x] = prio;
+				}
 
 				realX += dx;
 			}
 		}
 		else
-			for(u32 x = 0; x < 240u; ++x)
-			{
-				unsigned xxx = (realX >> 8);
-				unsigned yyy = (realY >> 8);
-
-				if(xxx < sizeX && yyy < sizeY)
-				{
-					unsigned tile = screenBase[(xxx>>3) | ((yyy>>3)<<yshift)];
-
-					unsigned tileX = (xxx & 7);
-					unsigned tileY = yyy & 7;
-
-					u8 color = charBase[(tile<<6) | (tileY<<3) | tileX];
-
-					if(color) RENDERER_LINE[layer][x] = (READ16LE(&palette[color])|prio);
-				}
-
-				realX += dx;
-				realY += dy;
-			}
+			gfxDrawAffineTiles(RENDERER_LINE[layer], x0, x1, realX, realY, dx, dy, sizeX, false, screenBase, charBase, yshift, palette, prio);
 	}
 	skipLine:
 
@@ -7394,27 +8278,27 @@ u16 pa,  u16 pb, u16 pc,  u16 pd, int& currentX, int& currentY, int changed)
 		int mosaicX = (RENDERER_MOSAIC & 0xF) + 1;
 		if(mosaicX > 1)
 		{
-			MOSAIC_LOOP(layer, mosaicX);
+			gfxMosaicRotLine(RENDERER_LINE[layer], mosaicX, x0, x1);
 		}
 	}
 }
 
 template<int renderer_idx>
-static INLINE void gfxDrawRotScreen16Bit( int& currentX,  int& currentY, int changed)
+static INLINE void gfxDrawRotScreen16Bit( int& currentX,  int& currentY, int changed, int x0, int x1)
 {
 	INIT_RENDERER_CONTEXT(renderer_idx);
 
-	u16 *screenBase = (u16 *)&vram[0];
-	int prio = ((RENDERER_IO_REGISTERS[REG_BG2CNT] & 3) << 25) + 0x1000000;
+	u16 *screenBase = (u16 *)&RENDERER_VRAM[0];
+	u8 prio = GFX_PRIO_LEVEL(RENDERER_IO_REGISTERS[REG_BG2CNT] & 3) | GFX_PRIO_BG;
 
 	u32 sizeX = 240;
 	u32 sizeY = 160;
 
-	int startX = (BG2X_L) | ((BG2X_H & 0x07FF)<<16);
-	if(BG2X_H & 0x0800)
+	int startX = (RENDERER_BG2X_L) | ((RENDERER_BG2X_H & 0x07FF)<<16);
+	if(RENDERER_BG2X_H & 0x0800)
 		startX |= 0xF8000000;
-	int startY = (BG2Y_L) | ((BG2Y_H & 0x07FF)<<16);
-	if(BG2Y_H & 0x0800)
+	int startY = (RENDERER_BG2Y_L) | ((RENDERER_BG2Y_H & 0x07FF)<<16);
+	if(RENDERER_BG2Y_H & 0x0800)
 		startY |= 0xF8000000;
 
 #ifdef BRANCHLESS_GBA_GFX
@@ -7452,15 +8336,15 @@ static INLINE void gfxDrawRotScreen16Bit( int& currentX,  int& currentY, int cha
 
 	if(changed & 1)
 	{
-		currentX = (BG2X_L) | ((BG2X_H & 0x07FF)<<16);
-		if(BG2X_H & 0x0800)
+		currentX = (RENDERER_BG2X_L) | ((RENDERER_BG2X_H & 0x07FF)<<16);
+		if(RENDERER_BG2X_H & 0x0800)
 			currentX |= 0xF8000000;
 	}
 
 	if(changed & 2)
 	{
-		currentY = (BG2Y_L) | ((BG2Y_H & 0x07FF)<<16);
-		if(BG2Y_H & 0x0800)
+		currentY = (RENDERER_BG2Y_L) | ((RENDERER_BG2Y_H & 0x07FF)<<16);
+		if(RENDERER_BG2Y_H & 0x0800)
 			currentY |= 0xF8000000;
 	}
 
@@ -7474,46 +8358,44 @@ static INLINE void gfxDrawRotScreen16Bit( int& currentX,  int& currentY, int cha
 		realY -= y*dmy;
 	}
 
-	unsigned xxx = (realX >> 8);
-	unsigned yyy = (realY >> 8);
-
-	memset(RENDERER_LINE[Layer_BG2], -1, 240 * sizeof(u32));
-	for(u32 x = 0; x < 240u; ++x)
-	{
-		if(xxx < sizeX && yyy < sizeY)
-			RENDERER_LINE[Layer_BG2][x] = (READ16LE(&screenBase[yyy * sizeX + xxx]) | prio);
+	realX += x0 * dx;
+	realY += x0 * dy;
 
-		realX += dx;
-		realY += dy;
+	unsigned yyy = (realY >> 8);
 
-		xxx = (realX >> 8);
-		yyy = (realY >> 8);
-	}
+	memset(RENDERER_LINE[Layer_BG2].prio + x0, -1, x1 - x0);
+	int first, last;
+	if(dx == 0x100 && dy == 0) {
+		int col = realX >> 8;
+		if(gfxBitmapSpan(col, realY >> 8, sizeX, sizeY, x0, x1, first, last))
+			gfxBitmapRow16(gfxLineFrom(RENDERER_LINE[Layer_BG2], first), &screenBase[yyy * sizeX + col + first - x0], last - first, prio);
+	} else
+		gfxDrawAffineBitmap16(RENDERER_LINE[Layer_BG2], x0, x1, realX, realY, dx, dy, sizeX, sizeY, screenBase, prio);
 
 	if(RENDERER_IO_REGISTERS[REG_BG2CNT] & 0x40) {
-		int mosaicX = (MOSAIC & 0xF) + 1;
+		int mosaicX = (RENDERER_MOSAIC & 0xF) + 1;
 		if(mosaicX > 1) {
-			MOSAIC_LOOP(Layer_BG2, mosaicX);
+			gfxMosaicRotLine(RENDERER_LINE[Layer_BG2], mosaicX, x0, x1);
 		}
 	}
 }
 
 template<int renderer_idx>
-static INLINE void gfxDrawRotScreen256(int &currentX, int& currentY, int changed)
+static INLINE void gfxDrawRotScreen256(int &currentX, int& currentY, int changed, int x0, int x1)
 {
 	INIT_RENDERER_CONTEXT(renderer_idx);
 
 	u16 *palette = (u16 *)RENDERER_PALETTE;
-	u8 *screenBase = (RENDERER_IO_REGISTERS[REG_DISPCNT] & 0x0010) ? &vram[0xA000] : &vram[0x0000];
-	int prio = ((RENDERER_IO_REGISTERS[REG_BG2CNT] & 3) << 25) + 0x1000000;
+	u8 *screenBase = (RENDERER_IO_REGISTERS[REG_DISPCNT] & 0x0010) ? &RENDERER_VRAM[0xA000] : &RENDERER_VRAM[0x0000];
+	u8 prio = GFX_PRIO_LEVEL(RENDERER_IO_REGISTERS[REG_BG2CNT] & 3) | GFX_PRIO_BG;
 	u32 sizeX = 240;
 	u32 sizeY = 160;
 
-	int startX = (BG2X_L) | ((BG2X_H & 0x07FF)<<16);
-	if(BG2X_H & 0x0800)
+	int startX = (RENDERER_BG2X_L) | ((RENDERER_BG2X_H & 0x07FF)<<16);
+	if(RENDERER_BG2X_H & 0x0800)
 		startX |= 0xF8000000;
-	int startY = (BG2Y_L) | ((BG2Y_H & 0x07FF)<<16);
-	if(BG2Y_H & 0x0800)
+	int startY = (RENDERER_BG2Y_L) | ((RENDERER_BG2Y_H & 0x07FF)<<16);
+	if(RENDERER_BG2Y_H & 0x0800)
 		startY |= 0xF8000000;
 
 #ifdef BRANCHLESS_GBA_GFX
@@ -7551,15 +8433,15 @@ static INLINE void gfxDrawRotScreen256(int &currentX, int& currentY, int changed
 
 	if(changed & 1)
 	{
-		currentX = (BG2X_L) | ((BG2X_H & 0x07FF)<<16);
-		if(BG2X_H & 0x0800)
+		currentX = (RENDERER_BG2X_L) | ((RENDERER_BG2X_H & 0x07FF)<<16);
+		if(RENDERER_BG2X_H & 0x0800)
 			currentX |= 0xF8000000;
 	}
 
 	if(changed & 2)
 	{
-		currentY = (BG2Y_L) | ((BG2Y_H & 0x07FF)<<16);
-		if(BG2Y_H & 0x0800)
+		currentY = (RENDERER_BG2Y_L) | ((RENDERER_BG2Y_H & 0x07FF)<<16);
+		if(RENDERER_BG2Y_H & 0x0800)
 			currentY |= 0xF8000000;
 	}
 
@@ -7573,48 +8455,46 @@ static INLINE void gfxDrawRotScreen256(int &currentX, int& currentY, int changed
 		realY = startY + y*dmy;
 	}
 
+	realX += x0 * dx;
+	realY += x0 * dy;
+
 	int xxx = (realX >> 8);
 	int yyy = (realY >> 8);
 
-	memset(RENDERER_LINE[Layer_BG2], -1, 240 * sizeof(u32));
-	for(u32 x = 0; x < 240; ++x)
-	{
-		u8 color = screenBase[yyy * 240 + xxx];
-		if(unsigned(xxx) < sizeX && unsigned(yyy) < sizeY && color)
-			RENDERER_LINE[Layer_BG2][x] = (READ16LE(&palette[color])|prio);
-		realX += dx;
-		realY += dy;
-
-		xxx = (realX >> 8);
-		yyy = (realY >> 8);
-	}
+	memset(RENDERER_LINE[Layer_BG2].prio + x0, -1, x1 - x0);
+	int first, last;
+	if(dx == 0x100 && dy == 0) {
+		if(gfxBitmapSpan(xxx, yyy, sizeX, sizeY, x0, x1, first, last))
+			gfxBitmapRow8(gfxLineFrom(RENDERER_LINE[Layer_BG2], first), &screenBase[yyy * 240 + xxx + first - x0], last - first, palette, prio);
+	} else
+		gfxDrawAffineBitmap8(RENDERER_LINE[Layer_BG2], x0, x1, realX, realY, dx, dy, sizeX, sizeY, screenBase, palette, prio);
 
 	if(RENDERER_IO_REGISTERS[REG_BG2CNT] & 0x40)
 	{
 		int mosaicX = (RENDERER_MOSAIC & 0xF) + 1;
 		if(mosaicX > 1)
 		{
-			MOSAIC_LOOP(Layer_BG2, mosaicX);
+			gfxMosaicRotLine(RENDERER_LINE[Layer_BG2], mosaicX, x0, x1);
 		}
 	}
 }
 
 template<int renderer_idx>
-static INLINE void gfxDrawRotScreen16Bit160(int& currentX, int& currentY, int changed)
+static INLINE void gfxDrawRotScreen16Bit160(int& currentX, int& currentY, int changed, int x0, int x1)
 {
 	INIT_RENDERER_CONTEXT(renderer_idx);
 
-	u16 *screenBase = (RENDERER_IO_REGISTERS[REG_DISPCNT] & 0x0010) ? (u16 *)&vram[0xa000] :
-		(u16 *)&vram[0];
-	int prio = ((RENDERER_IO_REGISTERS[REG_BG2CNT] & 3) << 25) + 0x1000000;
+	u16 *screenBase = (RENDERER_IO_REGISTERS[REG_DISPCNT] & 0x0010) ? (u16 *)&RENDERER_VRAM[0xa000] :
+		(u16 *)&RENDERER_VRAM[0];
+	u8 prio = GFX_PRIO_LEVEL(RENDERER_IO_REGISTERS[REG_BG2CNT] & 3) | GFX_PRIO_BG;
 	u32 sizeX = 160;
 	u32 sizeY = 128;
 
-	int startX = (BG2X_L) | ((BG2X_H & 0x07FF)<<16);
-	if(BG2X_H & 0x0800)
+	int startX = (RENDERER_BG2X_L) | ((RENDERER_BG2X_H & 0x07FF)<<16);
+	if(RENDERER_BG2X_H & 0x0800)
 		startX |= 0xF8000000;
-	int startY = (BG2Y_L) | ((BG2Y_H & 0x07FF)<<16);
-	if(BG2Y_H & 0x0800)
+	int startY = (RENDERER_BG2Y_L) | ((RENDERER_BG2Y_H & 0x07FF)<<16);
+	if(RENDERER_BG2Y_H & 0x0800)
 		startY |= 0xF8000000;
 
 #ifdef BRANCHLESS_GBA_GFX
@@ -7652,15 +8532,15 @@ static INLINE void gfxDrawRotScreen16Bit160(int& currentX, int& currentY, int ch
 
 	if(changed & 1)
 	{
-		currentX = (BG2X_L) | ((BG2X_H & 0x07FF)<<16);
-		if(BG2X_H & 0x0800)
+		currentX = (RENDERER_BG2X_L) | ((RENDERER_BG2X_H & 0x07FF)<<16);
+		if(RENDERER_BG2X_H & 0x0800)
 			currentX |= 0xF8000000;
 	}
 
 	if(changed & 2)
 	{
-		currentY = (BG2Y_L) | ((BG2Y_H & 0x07FF)<<16);
-		if(BG2Y_H & 0x0800)
+		currentY = (RENDERER_BG2Y_L) | ((RENDERER_BG2Y_H & 0x07FF)<<16);
+		if(RENDERER_BG2Y_H & 0x0800)
 			currentY |= 0xF8000000;
 	}
 
@@ -7674,128 +8554,511 @@ static INLINE void gfxDrawRotScreen16Bit160(int& currentX, int& currentY, int ch
 		realY = startY + y*dmy;
 	}
 
+	realX += x0 * dx;
+	realY += x0 * dy;
+
 	int xxx = (realX >> 8);
 	int yyy = (realY >> 8);
 
-	memset(RENDERER_LINE[Layer_BG2], -1, 240 * sizeof(u32));
-	for(u32 x = 0; x < 240u; ++x)
-	{
-		if(unsigned(xxx) < sizeX && unsigned(yyy) < sizeY)
-			RENDERER_LINE[Layer_BG2][x] = (READ16LE(&screenBase[yyy * sizeX + xxx]) | prio);
-
-		realX += dx;
-		realY += dy;
-
-		xxx = (realX >> 8);
-		yyy = (realY >> 8);
-	}
+	memset(RENDERER_LINE[Layer_BG2].prio + x0, -1, x1 - x0);
+	int first, last;
+	if(dx == 0x100 && dy == 0) {
+		if(gfxBitmapSpan(xxx, yyy, sizeX, sizeY, x0, x1, first, last))
+			gfxBitmapRow16(gfxLineFrom(RENDERER_LINE[Layer_BG2], first), &screenBase[yyy * sizeX + xxx + first - x0], last - first, prio);
+	} else
+		gfxDrawAffineBitmap16(RENDERER_LINE[Layer_BG2], x0, x1, realX, realY, dx, dy, sizeX, sizeY, screenBase, prio);
 
 
 	int mosaicX = (RENDERER_MOSAIC & 0xF) + 1;
 	if(RENDERER_IO_REGISTERS[REG_BG2CNT] & 0x40 && (mosaicX > 1))
 	{
-		MOSAIC_LOOP(Layer_BG2, mosaicX);
+		gfxMosaicRotLine(RENDERER_LINE[Layer_BG2], mosaicX, x0, x1);
 	}
 }
 
-/* lineOBJpix is used to keep track of the drawn OBJs
-   and to stop drawing them if the 'maximum number of OBJ per line'
-   has been reached. */
-
-template<int renderer_idx>
-static void gfxDrawSprites (void)
+/* Resolves one decoded OBJ pixel against the OBJ line: a transparent pixel
+   can only lower the priority of what is already there. */
+static INLINE void gfxDrawOBJPixel(const gfxLayerLine& lineOBJ, int sx, u32 color, u16 pixel, u8 prio, bool mosaic)
 {
-	INIT_RENDERER_CONTEXT(renderer_idx);
+	if ((color==0) && (GFX_PRIO_LEVEL_OF(prio) < GFX_PRIO_LEVEL_OF(lineOBJ.prio[sx])))
+	{
+		lineOBJ.prio[sx] = (lineOBJ.prio[sx] & ~GFX_PRIO_LEVEL(3)) | prio;
+		if(mosaic) {
+			lineOBJ.color[sx] = lineOBJ.color[sx-1];
+			lineOBJ.prio[sx] = (lineOBJ.prio[sx-1] & ~GFX_PRIO_LEVEL(3)) | prio;
+		}
+	}
+	else if((color) && ((prio & ~GFX_PRIO_SEMI) < (lineOBJ.prio[sx] & ~GFX_PRIO_SEMI)))
+	{
+		lineOBJ.color[sx] = pixel;
+		lineOBJ.prio[sx] = prio;
+		if(mosaic) {
+			lineOBJ.color[sx] = lineOBJ.color[sx-1];
+			lineOBJ.prio[sx] = (lineOBJ.prio[sx-1] & ~GFX_PRIO_LEVEL(3)) | prio;
+		}
+	}
+}
 
-	unsigned lineOBJpix, m;
+/* Sprites are decoded once per line. When they have depth, every decoded
+   pixel is also dropped into the OBJ line of each other view being drawn,
+   moved by the view number times the shift gfxUpdateOBJParallax cached for
+   its OBJ. */
+struct gfxOBJViews {
+	gfxLineBuffer *lines;
+	int first;
+	int last;
+};
 
-	lineOBJpix = (RENDERER_IO_REGISTERS[REG_DISPCNT] & 0x20) ? 954 : 1226;
-	m = 0;
+static INLINE bool gfxOBJPixelVisible(int sx, int shift, const gfxOBJViews& views)
+{
+	if(sx < 240)
+		return true;
+	for(int v = views.first; v <= views.last; ++v)
+		if(((unsigned)(sx - v * shift) & 511) < 240)
+			return true;
+	return false;
+}
 
-	u16 *sprites = (u16 *)RENDERER_OAM;
-	u16 *spritePalette = &((u16 *)RENDERER_PALETTE)[256];
-	int mosaicY = ((RENDERER_MOSAIC & 0xF000)>>12) + 1;
-	int mosaicX = ((RENDERER_MOSAIC & 0xF00)>>8) + 1;
-	for(u32 x = 0; x < 128; x++)
+static INLINE void gfxDrawOBJPixels(const gfxLayerLine& lineOBJ, const gfxOBJViews& views, int sx, int shift, u32 color, u16 pixel, u8 prio, bool mosaic)
+{
+	if(sx < 240)
+		gfxDrawOBJPixel(lineOBJ, sx, color, pixel, prio, mosaic);
+	for(int v = views.first; v <= views.last; ++v)
 	{
-		u16 a0 = READ16LE(sprites++);
-		u16 a1 = READ16LE(sprites++);
-		u16 a2 = READ16LE(sprites++);
-		++sprites;
+		unsigned vsx = (unsigned)(sx - v * shift) & 511;
+		if(vsx < 240)
+			gfxDrawOBJPixel(gfxLineAt(views.lines[v - 1], 0), vsx, color, pixel, prio, mosaic);
+	}
+}
 
-		RENDERER_LINE_OBJ_PIX_LEFT[x]=lineOBJpix;
+/*
+Sprites touching each visible line, one bit per OAM entry. Every OAM write
+bumps oamVersion and a renderer rebuilds its lists before drawing the next
+line that needs them.
+*/
+static void gfxBuildOAMLines(const u8 *oamBase, u32 (*lines)[4])
+{
+	memset(lines, 0, 160 * sizeof(lines[0]));
 
-		lineOBJpix-=2;
-		if (lineOBJpix<=0)
-			return;
+	const u16 *sprites = (const u16 *)oamBase;
+	for(u32 x = 0; x < 128; x++, sprites += 4)
+	{
+		u16 a0 = READ16LE(&sprites[0]);
+		u16 a1 = READ16LE(&sprites[1]);
 
 		if ((a0 & 0x0c00) == 0x0c00)
-			a0 &=0xF3FF;
+			a0 &= 0xF3FF;
 
-		u16 a0val = a0>>14;
+		// disabled sprites are only looked at as OBJ window
+		if (((a0 & 0x0300) == 0x0200) && ((a0 & 0x0c00) != 0x0800))
+			continue;
 
-		if (a0val == 3)
+		int sizeY = 8<<(a1>>14);
+		switch (a0>>14)
 		{
-			a0 &= 0x3FFF;
-			a1 &= 0x3FFF;
+			case 1:
+				if (sizeY>8)
+					sizeY>>=1;
+				break;
+			case 2:
+				if (sizeY<32)
+					sizeY<<=1;
+				break;
+			case 3:
+				sizeY = 8;
+				break;
 		}
+		if ((a0 & 0x0300) == 0x0300)
+			sizeY<<=1;
 
-		u32 sizeX = 8<<(a1>>14);
-		u32 sizeY = sizeX;
+		int sy = (a0 & 255);
+		if ((sy+sizeY) > 256)
+			sy -= 256;
 
+		for (int y = max(sy, 0); y < min(sy+sizeY, 160); y++)
+			lines[y][x >> 5] |= 1u << (x & 31);
+	}
+}
 
-		if (a0val & 1)
+template<int renderer_idx>
+static const u32 *gfxOAMLine(void)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+	u32 version = oamVersion;
+	if (RENDERER_OAM_LINES_VER != version)
+	{
+		RENDERER_OAM_LINES_VER = version;
+		gfxBuildOAMLines(RENDERER_OAM, RENDERER_OAM_LINES);
+	}
+	return RENDERER_OAM_LINES[RENDERER_R_VCOUNT];
+}
+
+/* Draws one OBJ window sprite into Layer_WIN_OBJ, during the sprite pass,
+   with the OBJ cycles that were left when the pass reached it. */
+template<int renderer_idx>
+static void gfxDrawOBJWinSprite(u16 a0, u16 a1, u16 a2, int sizeX, int sizeY, int lineOBJpix)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+	int sy = (a0 & 255);
+
+	if(a0 & 0x0100)
+	{
+		int fieldX = sizeX;
+		int fieldY = sizeY;
+		if(a0 & 0x0200)
 		{
-#ifdef BRANCHLESS_GBA_GFX
-			sizeX <<= isel(-(sizeX & (~31u)), 1, 0);
-			sizeY >>= isel(-(sizeY>8), 0, 1);
-#else
-			if (sizeX<32)
-				sizeX<<=1;
-			if (sizeY>8)
-				sizeY>>=1;
-#endif
+			fieldX <<= 1;
+			fieldY <<= 1;
 		}
-		else if (a0val & 2)
+		if((sy+fieldY) > 256)
+			sy -= 256;
+		int t = RENDERER_R_VCOUNT - sy;
+		if((t >= 0) && (t < fieldY))
 		{
-#ifdef BRANCHLESS_GBA_GFX
-			sizeX >>= isel(-(sizeX>8), 0, 1);
-			sizeY <<= isel(-(sizeY & (~31u)), 1, 0);
-#else
-			if (sizeX>8)
-				sizeX>>=1;
-			if (sizeY<32)
-				sizeY<<=1;
-#endif
+			int sx = (a1 & 0x1FF);
+			int startpix = 0;
+			if ((sx+fieldX)> 512)
+				startpix=512-sx;
 
-		}
+			if((sx < 240) || startpix)
+			{
+				lineOBJpix-=8;
+				// int t2 = t - (fieldY >> 1);
+				int rot = (a1 >> 9) & 0x1F;
+				u16 *OAM = (u16 *)RENDERER_OAM;
+				int dx = READ16LE(&OAM[3 + (rot << 4)]);
+				if(dx & 0x8000)
+					dx |= 0xFFFF8000;
+				int dmx = READ16LE(&OAM[7 + (rot << 4)]);
+				if(dmx & 0x8000)
+					dmx |= 0xFFFF8000;
+				int dy = READ16LE(&OAM[11 + (rot << 4)]);
+				if(dy & 0x8000)
+					dy |= 0xFFFF8000;
+				int dmy = READ16LE(&OAM[15 + (rot << 4)]);
+				if(dmy & 0x8000)
+					dmy |= 0xFFFF8000;
+				
+				int realX = ((sizeX) << 7) - (fieldX >> 1)*dx - (fieldY>>1)*dmx
+					+ t * dmx;
+				int realY = ((sizeY) << 7) - (fieldX >> 1)*dy - (fieldY>>1)*dmy
+					+ t * dmy;
 
+				int c = (a2 & 0x3FF);
+				if(RENDERER_R_DISPCNT_Video_Mode > 2 && (c < 512))
+					return;
 
-		int sy = (a0 & 255);
-		int sx = (a1 & 0x1FF);
+				int inc = 32;
+				bool condition1 = a0 & 0x2000;
 
-		// computes ticks used by OBJ-WIN if OBJWIN is enabled
-		if (((a0 & 0x0c00) == 0x0800) && (RENDERER_R_DISPCNT_OBJ_Window_Display))
-		{
-			if ((a0 & 0x0300) == 0x0300)
-			{
-				sizeX<<=1;
-				sizeY<<=1;
-			}
+				if(RENDERER_IO_REGISTERS[REG_DISPCNT] & 0x40)
+					inc = sizeX >> 3;
 
-#ifdef BRANCHLESS_GBA_GFX
-			sy -= isel(256 - sy - sizeY, 0, 256);
-			sx -= isel(512 - sx - sizeX, 0, 512);
-#else
-			if((sy+sizeY) > 256)
-				sy -= 256;
-			if ((sx+sizeX)> 512)
-				sx -= 512;
-#endif
+				for(int x = 0; x < fieldX; x++)
+				{
+					bool cont = true;
+					if (x >= startpix)
+						lineOBJpix-=2;
+					if (lineOBJpix<0)
+						continue;
+					int xxx = realX >> 8;
+					int yyy = realY >> 8;
 
-			if (sx < 0)
-			{
-				sizeX+=sx;
+					if(xxx < 0 || xxx >= sizeX || yyy < 0 || yyy >= sizeY || sx >= 240)
+						cont = false;
+
+					if(cont)
+					{
+						u32 color;
+						if(condition1)
+							color = RENDERER_VRAM[0x10000 + ((((c + (yyy>>3) * inc)<<5)
+										+ ((yyy & 7)<<3) + ((xxx >> 3)<<6) +
+										(xxx & 7))&0x7fff)];
+						else
+						{
+							color = RENDERER_VRAM[0x10000 + ((((c + (yyy>>3) * inc)<<5)
+										+ ((yyy & 7)<<2) + ((xxx >> 3)<<5) +
+										((xxx & 7)>>1))&0x7fff)];
+							if(xxx & 1)
+								color >>= 4;
+							else
+								color &= 0x0F;
+						}
+
+						if(color)
+							RENDERER_LINE[Layer_WIN_OBJ].prio[sx] = 0;
+					}
+					sx = (sx+1)&511;
+					realX += dx;
+					realY += dy;
+				}
+			}
+		}
+	}
+	else
+	{
+		if((sy+sizeY) > 256)
+			sy -= 256;
+		int t = RENDERER_R_VCOUNT - sy;
+		if((t >= 0) && (t < sizeY))
+		{
+			int sx = (a1 & 0x1FF);
+			int startpix = 0;
+			if ((sx+sizeX)> 512)
+				startpix=512-sx;
+
+			if((sx < 240) || startpix)
+			{
+				lineOBJpix+=2;
+				if(a1 & 0x2000)
+					t = sizeY - t - 1;
+				int c = (a2 & 0x3FF);
+				if(RENDERER_R_DISPCNT_Video_Mode > 2 && (c < 512))
+					return;
+				if(a0 & 0x2000)
+				{
+
+					int inc = 32;
+					if(RENDERER_IO_REGISTERS[REG_DISPCNT] & 0x40)
+						inc = sizeX >> 2;
+					else
+						c &= 0x3FE;
+
+					int xxx = 0;
+					if(a1 & 0x1000)
+						xxx = sizeX-1;
+					int address = 0x10000 + ((((c+ (t>>3) * inc) << 5)
+								+ ((t & 7) << 3) + ((xxx>>3)<<6) + (xxx & 7))&0x7fff);
+					if(a1 & 0x1000)
+						xxx = 7;
+					for(int xx = 0; xx < sizeX; xx++)
+					{
+						if (xx >= startpix)
+							lineOBJpix--;
+						if (lineOBJpix<0)
+							continue;
+						if(sx < 240)
+						{
+							u8 color = RENDERER_VRAM[address];
+							if(color)
+								RENDERER_LINE[Layer_WIN_OBJ].prio[sx] = 0;
+						}
+
+						sx = (sx+1) & 511;
+						if(a1 & 0x1000) {
+							xxx--;
+							address--;
+							if(xxx == -1) {
+								address -= 56;
+								xxx = 7;
+							}
+							if(address < 0x10000)
+								address += 0x8000;
+						} else {
+							xxx++;
+							address++;
+							if(xxx == 8) {
+								address += 56;
+								xxx = 0;
+							}
+							if(address > 0x17fff)
+								address -= 0x8000;
+						}
+					}
+				}
+				else
+				{
+					int inc = 32;
+					if(RENDERER_IO_REGISTERS[REG_DISPCNT] & 0x40)
+						inc = sizeX >> 3;
+					int xxx = 0;
+					if(a1 & 0x1000)
+						xxx = sizeX - 1;
+					int address = 0x10000 + ((((c + (t>>3) * inc)<<5)
+								+ ((t & 7)<<2) + ((xxx>>3)<<5) + ((xxx & 7) >> 1))&0x7fff);
+					// u32 prio = (((a2 >> 10) & 3) << 25) | ((a0 & 0x0c00)<<6);
+					// int palette = (a2 >> 8) & 0xF0;
+					if(a1 & 0x1000)
+					{
+						xxx = 7;
+						for(int xx = sizeX - 1; xx >= 0; xx--)
+						{
+							if (xx >= startpix)
+								lineOBJpix--;
+							if (lineOBJpix<0)
+								continue;
+							if(sx < 240)
+							{
+								u8 color = RENDERER_VRAM[address];
+								if(xx & 1)
+									color = (color >> 4);
+								else
+									color &= 0x0F;
+
+								if(color)
+									RENDERER_LINE[Layer_WIN_OBJ].prio[sx] = 0;
+							}
+							sx = (sx+1) & 511;
+							xxx--;
+							if(!(xx & 1))
+								address--;
+							if(xxx == -1) {
+								xxx = 7;
+								address -= 28;
+							}
+							if(address < 0x10000)
+								address += 0x8000;
+						}
+					}
+					else
+					{
+						for(int xx = 0; xx < sizeX; xx++)
+						{
+							if (xx >= startpix)
+								lineOBJpix--;
+							if (lineOBJpix<0)
+								continue;
+							if(sx < 240)
+							{
+								u8 color = RENDERER_VRAM[address];
+								if(xx & 1)
+									color = (color >> 4);
+								else
+									color &= 0x0F;
+
+								if(color)
+									RENDERER_LINE[Layer_WIN_OBJ].prio[sx] = 0;
+							}
+							sx = (sx+1) & 511;
+							xxx++;
+							if(xx & 1)
+								address++;
+							if(xxx == 8) {
+								address += 28;
+								xxx = 0;
+							}
+							if(address > 0x17fff)
+								address -= 0x8000;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+/* lineOBJpix is used to keep track of the drawn OBJs
+   and to stop drawing them if the 'maximum number of OBJ per line'
+   has been reached. */
+
+template<int renderer_idx>
+static void gfxDrawSprites (void)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+	unsigned lineOBJpix, m;
+
+	lineOBJpix = (RENDERER_IO_REGISTERS[REG_DISPCNT] & 0x20) ? 954 : 1226;
+	m = 0;
+
+	u16 *sprites = (u16 *)RENDERER_OAM;
+	u16 *spritePalette = &((u16 *)RENDERER_PALETTE)[256];
+	int mosaicY = ((RENDERER_MOSAIC & 0xF000)>>12) + 1;
+	int mosaicX = ((RENDERER_MOSAIC & 0xF00)>>8) + 1;
+	gfxOBJViews objViews = { RENDERER_LINE_OBJ_VIEWS, (int)max(1, RENDERER_FIRST_EYE), RENDERER_OBJ_PARALLAX_ENABLED ? RENDERER_LAST_EYE : 0 };
+	bool hasOBJViews = objViews.first <= objViews.last;
+	bool drawOBJWin = (RENDERER_RENDERFUNC_TYPE == 2) && RENDERER_DRAW_OBJWIN;
+	const u32 *lineSprites = gfxOAMLine<renderer_idx>();
+	for(u32 x = 0; x < 128; x++, sprites += 4)
+	{
+		RENDERER_LINE_OBJ_PIX_LEFT[x]=lineOBJpix;
+		if ((int)lineOBJpix <= 0)
+			drawOBJWin = false;
+
+		lineOBJpix-=2;
+		if (lineOBJpix<=0)
+			return;
+
+		// sprites missing the line still use their 2 cycles
+		if (!(lineSprites[x >> 5] & (1u << (x & 31))))
+			continue;
+
+		u16 a0 = READ16LE(&sprites[0]);
+		u16 a1 = READ16LE(&sprites[1]);
+		u16 a2 = READ16LE(&sprites[2]);
+
+		if ((a0 & 0x0c00) == 0x0c00)
+			a0 &=0xF3FF;
+
+		u16 a0val = a0>>14;
+
+		if (a0val == 3)
+		{
+			a0 &= 0x3FFF;
+			a1 &= 0x3FFF;
+		}
+
+		u32 sizeX = 8<<(a1>>14);
+		u32 sizeY = sizeX;
+
+
+		if (a0val & 1)
+		{
+#ifdef BRANCHLESS_GBA_GFX
+			sizeX <<= isel(-(sizeX & (~31u)), 1, 0);
+			sizeY >>= isel(-(sizeY>8), 0, 1);
+#else
+			if (sizeX<32)
+				sizeX<<=1;
+			if (sizeY>8)
+				sizeY>>=1;
+#endif
+		}
+		else if (a0val & 2)
+		{
+#ifdef BRANCHLESS_GBA_GFX
+			sizeX >>= isel(-(sizeX>8), 0, 1);
+			sizeY <<= isel(-(sizeY & (~31u)), 1, 0);
+#else
+			if (sizeX>8)
+				sizeX>>=1;
+			if (sizeY<32)
+				sizeY<<=1;
+#endif
+
+		}
+
+
+		int sy = (a0 & 255);
+		int sx = (a1 & 0x1FF);
+
+		// draws OBJ-WIN and computes its ticks if OBJWIN is enabled
+		if (((a0 & 0x0c00) == 0x0800) && (RENDERER_R_DISPCNT_OBJ_Window_Display))
+		{
+			if (drawOBJWin && ((a0 & 0x0300) != 0x0200))
+				gfxDrawOBJWinSprite<renderer_idx>(a0, a1, a2, sizeX, sizeY, RENDERER_LINE_OBJ_PIX_LEFT[x]);
+
+			if ((a0 & 0x0300) == 0x0300)
+			{
+				sizeX<<=1;
+				sizeY<<=1;
+			}
+
+#ifdef BRANCHLESS_GBA_GFX
+			sy -= isel(256 - sy - sizeY, 0, 256);
+			sx -= isel(512 - sx - sizeX, 0, 512);
+#else
+			if((sy+sizeY) > 256)
+				sy -= 256;
+			if ((sx+sizeX)> 512)
+				sx -= 512;
+#endif
+
+			if (sx < 0)
+			{
+				sizeX+=sx;
 				sx = 0;
 			}
 			else if ((sx+sizeX)>240)
@@ -7815,6 +9078,8 @@ static void gfxDrawSprites (void)
 		else if(((a0 & 0x0c00) == 0x0800) || ((a0 & 0x0300) == 0x0200))
 			continue;
 
+		int shift = RENDERER_OBJ_PARALLAX[x];
+
 		if(a0 & 0x0100)
 		{
 			u32 fieldX = sizeX;
@@ -7829,13 +9094,18 @@ static void gfxDrawSprites (void)
 			int t = RENDERER_R_VCOUNT - sy;
 			if(unsigned(t) < fieldY)
 			{
+				if(shift)
+					RENDERER_OBJ_DISPARITY = true;
+
 				u32 startpix = 0;
 				if ((sx+fieldX)> 512)
 					startpix=512-sx;
 
-				if (lineOBJpix && ((sx < 240) || startpix))
+				bool counted = (sx < 240) || startpix;
+				if (lineOBJpix && (counted || hasOBJViews))
 				{
-					lineOBJpix-=8;
+					if (counted)
+						lineOBJpix-=8;
 					int rot = (((a1 >> 9) & 0x1F) << 4);
 					u16 *OAM = (u16 *)RENDERER_OAM;
 					int dx = READ16LE(&OAM[3 + rot]);
@@ -7854,15 +9124,9 @@ static void gfxDrawSprites (void)
 					if(a0 & 0x1000)
 						t -= (t % mosaicY);
 
-					u32 prio = (((a2 >> 10) & 3) << 25) | ((a0 & 0x0c00)<<6);
-					
-					int realX = 0;
-					//if (!draw_right_screen){
-					realX = ((sizeX) << 7) - (fieldX >> 1)*dx + ((t - (fieldY>>1))* dmx);
-					//} else {
-					//realX = ((sizeX) << 7) - (fieldX >> 1)*dx + ((int)(prio/5) * parallax_offset) + ((t - (fieldY>>1))* dmx);
-					//}
+					u8 prio = GFX_PRIO_LEVEL((a2 >> 10) & 3) | ((a0 >> 10) & GFX_PRIO_SEMI);
 					
+					int realX = ((sizeX) << 7) - (fieldX >> 1)*dx + ((t - (fieldY>>1))* dmx);
 					int realY = ((sizeY) << 7) - (fieldX >> 1)*dy + ((t - (fieldY>>1))* dmy);
 
 					int c = (a2 & 0x3FF);
@@ -7878,30 +9142,19 @@ static void gfxDrawSprites (void)
 							c &= 0x3FE;
 						for(u32 x = 0; x < fieldX; x++)
 						{
-							if (x >= startpix)
+							if (counted && x >= startpix)
 								lineOBJpix-=2;
 							unsigned xxx = realX >> 8;
 							unsigned yyy = realY >> 8;
-							if(xxx < sizeX && yyy < sizeY && sx < 240)
+							if(xxx < sizeX && yyy < sizeY && gfxOBJPixelVisible(sx, shift, objViews))
 							{
 
-								u32 color = vram[0x10000 + ((((c + (yyy>>3) * inc)<<5)
+								u32 color = RENDERER_VRAM[0x10000 + ((((c + (yyy>>3) * inc)<<5)
 								+ ((yyy & 7)<<3) + ((xxx >> 3)<<6) + (xxx & 7))&0x7FFF)];
 
-								if ((color==0) && (((prio >> 25)&3) < ((RENDERER_LINE[Layer_OBJ][sx]>>25)&3)))
-								{
-									RENDERER_LINE[Layer_OBJ][sx] = (RENDERER_LINE[Layer_OBJ][sx] & 0xF9FFFFFF) | prio;
-									if((a0 & 0x1000) && m)
-										RENDERER_LINE[Layer_OBJ][sx]=(RENDERER_LINE[Layer_OBJ][sx-1] & 0xF9FFFFFF) | prio;
-								}
-								else if((color) && (prio < (RENDERER_LINE[Layer_OBJ][sx]&0xFF000000)))
-								{
-									RENDERER_LINE[Layer_OBJ][sx] = READ16LE(&spritePalette[color]) | prio;
-									if((a0 & 0x1000) && m)
-										RENDERER_LINE[Layer_OBJ][sx]=(RENDERER_LINE[Layer_OBJ][sx-1] & 0xF9FFFFFF) | prio;
-								}
+								gfxDrawOBJPixels(RENDERER_LINE[Layer_OBJ], objViews, sx, shift, color, spritePalette[color], prio, (a0 & 0x1000) && m);
 
-								if ((a0 & 0x1000) && ((m+1) == mosaicX))
+								if ((a0 & 0x1000) && ((m+1) == mosaicX) && sx < 240)
 									m = 0;
 							}
 							sx = (sx+1)&511;
@@ -7917,14 +9170,14 @@ static void gfxDrawSprites (void)
 						int palette = (a2 >> 8) & 0xF0;
 						for(u32 x = 0; x < fieldX; ++x)
 						{
-							if (x >= startpix)
+							if (counted && x >= startpix)
 								lineOBJpix-=2;
 							unsigned xxx = realX >> 8;
 							unsigned yyy = realY >> 8;
-							if(xxx < sizeX && yyy < sizeY && sx < 240)
+							if(xxx < sizeX && yyy < sizeY && gfxOBJPixelVisible(sx, shift, objViews))
 							{
 
-								u32 color = vram[0x10000 + ((((c + (yyy>>3) * inc)<<5)
+								u32 color = RENDERER_VRAM[0x10000 + ((((c + (yyy>>3) * inc)<<5)
 											+ ((yyy & 7)<<2) + ((xxx >> 3)<<5)
 											+ ((xxx & 7)>>1))&0x7FFF)];
 								if(xxx & 1)
@@ -7932,19 +9185,7 @@ static void gfxDrawSprites (void)
 								else
 									color &= 0x0F;
 
-								if ((color==0) && (((prio >> 25)&3) <
-											((RENDERER_LINE[Layer_OBJ][sx]>>25)&3)))
-								{
-									RENDERER_LINE[Layer_OBJ][sx] = (RENDERER_LINE[Layer_OBJ][sx] & 0xF9FFFFFF) | prio;
-									if((a0 & 0x1000) && m)
-										RENDERER_LINE[Layer_OBJ][sx]=(RENDERER_LINE[Layer_OBJ][sx-1] & 0xF9FFFFFF) | prio;
-								}
-								else if((color) && (prio < (RENDERER_LINE[Layer_OBJ][sx]&0xFF000000)))
-								{
-									RENDERER_LINE[Layer_OBJ][sx] = READ16LE(&spritePalette[palette+color]) | prio;
-									if((a0 & 0x1000) && m)
-										RENDERER_LINE[Layer_OBJ][sx]=(RENDERER_LINE[Layer_OBJ][sx-1] & 0xF9FFFFFF) | prio;
-								}
+								gfxDrawOBJPixels(RENDERER_LINE[Layer_OBJ], objViews, sx, shift, color, spritePalette[palette+color], prio, (a0 & 0x1000) && m);
 							}
 							if((a0 & 0x1000) && m)
 							{
@@ -7968,13 +9209,18 @@ static void gfxDrawSprites (void)
 			int t = RENDERER_R_VCOUNT - sy;
 			if(unsigned(t) < sizeY)
 			{
+				if(shift)
+					RENDERER_OBJ_DISPARITY = true;
+
 				u32 startpix = 0;
 				if ((sx+sizeX)> 512)
 					startpix=512-sx;
 
-				if((sx < 240) || startpix)
+				bool counted = (sx < 240) || startpix;
+				if(counted || hasOBJViews)
 				{
-					lineOBJpix+=2;
+					if(counted)
+						lineOBJpix+=2;
 
 					if(a1 & 0x2000)
 						t = sizeY - t - 1;
@@ -8003,30 +9249,18 @@ static void gfxDrawSprites (void)
 
 						if(a1 & 0x1000)
 							xxx = 7;
-						u32 prio = (((a2 >> 10) & 3) << 25) | ((a0 & 0x0c00)<<6);
+						u8 prio = GFX_PRIO_LEVEL((a2 >> 10) & 3) | ((a0 >> 10) & GFX_PRIO_SEMI);
 
 						for(u32 xx = 0; xx < sizeX; xx++)
 						{
-							if (xx >= startpix)
+							if (counted && xx >= startpix)
 								--lineOBJpix;
-							if(sx < 240)
+							if(gfxOBJPixelVisible(sx, shift, objViews))
 							{
-								u8 color = vram[address];
-								if ((color==0) && (((prio >> 25)&3) <
-											((RENDERER_LINE[Layer_OBJ][sx]>>25)&3)))
-								{
-									RENDERER_LINE[Layer_OBJ][sx] = (RENDERER_LINE[Layer_OBJ][sx] & 0xF9FFFFFF) | prio;
-									if((a0 & 0x1000) && m)
-										RENDERER_LINE[Layer_OBJ][sx]=(RENDERER_LINE[Layer_OBJ][sx-1] & 0xF9FFFFFF) | prio;
-								}
-								else if((color) && (prio < (RENDERER_LINE[Layer_OBJ][sx]&0xFF000000)))
-								{
-									RENDERER_LINE[Layer_OBJ][sx] = READ16LE(&spritePalette[color]) | prio;
-									if((a0 & 0x1000) && m)
-										RENDERER_LINE[Layer_OBJ][sx]=(RENDERER_LINE[Layer_OBJ][sx-1] & 0xF9FFFFFF) | prio;
-								}
+								u8 color = RENDERER_VRAM[address];
+								gfxDrawOBJPixels(RENDERER_LINE[Layer_OBJ], objViews, sx, shift, color, spritePalette[color], prio, (a0 & 0x1000) && m);
 
-								if ((a0 & 0x1000) && ((m+1) == mosaicX))
+								if ((a0 & 0x1000) && ((m+1) == mosaicX) && sx < 240)
 									m = 0;
 							}
 
@@ -8063,7 +9297,7 @@ static void gfxDrawSprites (void)
 						int address = 0x10000 + ((((c + (t>>3) * inc)<<5)
 									+ ((t & 7)<<2) + ((xxx>>3)<<5) + ((xxx & 7) >> 1))&0x7FFF);
 
-						u32 prio = (((a2 >> 10) & 3) << 25) | ((a0 & 0x0c00)<<6);
+						u8 prio = GFX_PRIO_LEVEL((a2 >> 10) & 3) | ((a0 >> 10) & GFX_PRIO_SEMI);
 						int palette = (a2 >> 8) & 0xF0;
 						if(a1 & 0x1000)
 						{
@@ -8071,31 +9305,19 @@ static void gfxDrawSprites (void)
 							int xx = sizeX - 1;
 							do
 							{
-								if (xx >= (int)(startpix))
+								if (counted && xx >= (int)(startpix))
 									--lineOBJpix;
 								//if (lineOBJpix<0)
 								//  continue;
-								if(sx < 240)
+								if(gfxOBJPixelVisible(sx, shift, objViews))
 								{
-									u8 color = vram[address];
+									u8 color = RENDERER_VRAM[address];
 									if(xx & 1)
 										color >>= 4;
 									else
 										color &= 0x0F;
 
-									if ((color==0) && (((prio >> 25)&3) <
-												((RENDERER_LINE[Layer_OBJ][sx]>>25)&3)))
-									{
-										RENDERER_LINE[Layer_OBJ][sx] = (RENDERER_LINE[Layer_OBJ][sx] & 0xF9FFFFFF) | prio;
-										if((a0 & 0x1000) && m)
-											RENDERER_LINE[Layer_OBJ][sx]=(RENDERER_LINE[Layer_OBJ][sx-1] & 0xF9FFFFFF) | prio;
-									}
-									else if((color) && (prio < (RENDERER_LINE[Layer_OBJ][sx]&0xFF000000)))
-									{
-										RENDERER_LINE[Layer_OBJ][sx] = READ16LE(&spritePalette[palette + color]) | prio;
-										if((a0 & 0x1000) && m)
-											RENDERER_LINE[Layer_OBJ][sx]=(RENDERER_LINE[Layer_OBJ][sx-1] & 0xF9FFFFFF) | prio;
-									}
+									gfxDrawOBJPixels(RENDERER_LINE[Layer_OBJ], objViews, sx, shift, color, spritePalette[palette+color], prio, (a0 & 0x1000) && m);
 								}
 
 								if ((a0 & 0x1000) && ((m+1) == mosaicX))
@@ -8117,32 +9339,19 @@ static void gfxDrawSprites (void)
 						{
 							for(u32 xx = 0; xx < sizeX; ++xx)
 							{
-								if (xx >= startpix)
+								if (counted && xx >= startpix)
 									--lineOBJpix;
 								//if (lineOBJpix<0)
 								//  continue;
-								if(sx < 240)
+								if(gfxOBJPixelVisible(sx, shift, objViews))
 								{
-									u8 color = vram[address];
+									u8 color = RENDERER_VRAM[address];
 									if(xx & 1)
 										color >>= 4;
 									else
 										color &= 0x0F;
 
-									if ((color==0) && (((prio >> 25)&3) <
-												((RENDERER_LINE[Layer_OBJ][sx]>>25)&3)))
-									{
-										RENDERER_LINE[Layer_OBJ][sx] = (RENDERER_LINE[Layer_OBJ][sx] & 0xF9FFFFFF) | prio;
-										if((a0 & 0x1000) && m)
-											RENDERER_LINE[Layer_OBJ][sx]=(RENDERER_LINE[Layer_OBJ][sx-1] & 0xF9FFFFFF) | prio;
-									}
-									else if((color) && (prio < (RENDERER_LINE[Layer_OBJ][sx]&0xFF000000)))
-									{
-										RENDERER_LINE[Layer_OBJ][sx] = READ16LE(&spritePalette[palette + color]) | prio;
-										if((a0 & 0x1000) && m)
-											RENDERER_LINE[Layer_OBJ][sx]=(RENDERER_LINE[Layer_OBJ][sx-1] & 0xF9FFFFFF) | prio;
-
-									}
+									gfxDrawOBJPixels(RENDERER_LINE[Layer_OBJ], objViews, sx, shift, color, spritePalette[palette+color], prio, (a0 & 0x1000) && m);
 								}
 								if ((a0 & 0x1000) && ((m+1) == mosaicX))
 									m=0;
@@ -8166,341 +9375,32 @@ static void gfxDrawSprites (void)
 	}
 }
 
-template<int renderer_idx>
-static void gfxDrawOBJWin (void)
-{
-	INIT_RENDERER_CONTEXT(renderer_idx);
-
-	u16 *sprites = (u16 *)RENDERER_OAM;
-	for(int x = 0; x < 128 ; x++)
-	{
-		int lineOBJpix = RENDERER_LINE_OBJ_PIX_LEFT[x];
-		u16 a0 = READ16LE(sprites++);
-		u16 a1 = READ16LE(sprites++);
-		u16 a2 = READ16LE(sprites++);
-		sprites++;
-
-		if (lineOBJpix<=0)
-			return;
 
-		// ignores non OBJ-WIN and disabled OBJ-WIN
-		if(((a0 & 0x0c00) != 0x0800) || ((a0 & 0x0300) == 0x0200))
-			continue;
+/*============================================================
+	GBA.CPP
+============================================================ */
+int saveType = 0;
+bool useBios = false;
+bool skipBios = false;
+bool cpuIsMultiBoot = false; 
+int cpuSaveType = 0;
+bool enableRtc = false;
+bool mirroringEnable = false;
+bool skipSaveGameBattery = false;
 
-		u16 a0val = a0>>14;
+int cpuDmaCount = 0;
 
-		if ((a0 & 0x0c00) == 0x0c00)
-			a0 &=0xF3FF;
+#ifdef USE_SWITICKS
+int SWITicks = 0;
+#endif
 
-		if (a0val == 3)
-		{
-			a0 &= 0x3FFF;
-			a1 &= 0x3FFF;
-		}
+bool cpuSramEnabled = true;
+bool cpuFlashEnabled = true;
+bool cpuEEPROMEnabled = true;
 
-		int sizeX = 8<<(a1>>14);
-		int sizeY = sizeX;
-
-		if (a0val & 1)
-		{
-#ifdef BRANCHLESS_GBA_GFX
-			sizeX <<= isel(-(sizeX & (~31u)), 1, 0);
-			sizeY >>= isel(-(sizeY>8), 0, 1);
-#else
-			if (sizeX<32)
-				sizeX<<=1;
-			if (sizeY>8)
-				sizeY>>=1;
-#endif
-		}
-		else if (a0val & 2)
-		{
-#ifdef BRANCHLESS_GBA_GFX
-			sizeX >>= isel(-(sizeX>8), 0, 1);
-			sizeY <<= isel(-(sizeY & (~31u)), 1, 0);
-#else
-			if (sizeX>8)
-				sizeX>>=1;
-			if (sizeY<32)
-				sizeY<<=1;
-#endif
-
-		}
-
-		int sy = (a0 & 255);
-
-		if(a0 & 0x0100)
-		{
-			int fieldX = sizeX;
-			int fieldY = sizeY;
-			if(a0 & 0x0200)
-			{
-				fieldX <<= 1;
-				fieldY <<= 1;
-			}
-			if((sy+fieldY) > 256)
-				sy -= 256;
-			int t = RENDERER_R_VCOUNT - sy;
-			if((t >= 0) && (t < fieldY))
-			{
-				int sx = (a1 & 0x1FF);
-				int startpix = 0;
-				if ((sx+fieldX)> 512)
-					startpix=512-sx;
-
-				if((sx < 240) || startpix)
-				{
-					lineOBJpix-=8;
-					// int t2 = t - (fieldY >> 1);
-					int rot = (a1 >> 9) & 0x1F;
-					u16 *OAM = (u16 *)RENDERER_OAM;
-					int dx = READ16LE(&OAM[3 + (rot << 4)]);
-					if(dx & 0x8000)
-						dx |= 0xFFFF8000;
-					int dmx = READ16LE(&OAM[7 + (rot << 4)]);
-					if(dmx & 0x8000)
-						dmx |= 0xFFFF8000;
-					int dy = READ16LE(&OAM[11 + (rot << 4)]);
-					if(dy & 0x8000)
-						dy |= 0xFFFF8000;
-					int dmy = READ16LE(&OAM[15 + (rot << 4)]);
-					if(dmy & 0x8000)
-						dmy |= 0xFFFF8000;
-					
-					int realX = ((sizeX) << 7) - (fieldX >> 1)*dx - (fieldY>>1)*dmx
-						+ t * dmx;
-					int realY = ((sizeY) << 7) - (fieldX >> 1)*dy - (fieldY>>1)*dmy
-						+ t * dmy;
-
-					int c = (a2 & 0x3FF);
-					if(RENDERER_R_DISPCNT_Video_Mode > 2 && (c < 512))
-						continue;
-
-					int inc = 32;
-					bool condition1 = a0 & 0x2000;
-
-					if(RENDERER_IO_REGISTERS[REG_DISPCNT] & 0x40)
-						inc = sizeX >> 3;
-
-					for(int x = 0; x < fieldX; x++)
-					{
-						bool cont = true;
-						if (x >= startpix)
-							lineOBJpix-=2;
-						if (lineOBJpix<0)
-							continue;
-						int xxx = realX >> 8;
-						int yyy = realY >> 8;
-
-						if(xxx < 0 || xxx >= sizeX || yyy < 0 || yyy >= sizeY || sx >= 240)
-							cont = false;
-
-						if(cont)
-						{
-							u32 color;
-							if(condition1)
-								color = vram[0x10000 + ((((c + (yyy>>3) * inc)<<5)
-											+ ((yyy & 7)<<3) + ((xxx >> 3)<<6) +
-											(xxx & 7))&0x7fff)];
-							else
-							{
-								color = vram[0x10000 + ((((c + (yyy>>3) * inc)<<5)
-											+ ((yyy & 7)<<2) + ((xxx >> 3)<<5) +
-											((xxx & 7)>>1))&0x7fff)];
-								if(xxx & 1)
-									color >>= 4;
-								else
-									color &= 0x0F;
-							}
-
-							if(color)
-								RENDERER_LINE[Layer_WIN_OBJ][sx] = 1;
-						}
-						sx = (sx+1)&511;
-						realX += dx;
-						realY += dy;
-					}
-				}
-			}
-		}
-		else
-		{
-			if((sy+sizeY) > 256)
-				sy -= 256;
-			int t = RENDERER_R_VCOUNT - sy;
-			if((t >= 0) && (t < sizeY))
-			{
-				int sx = (a1 & 0x1FF);
-				int startpix = 0;
-				if ((sx+sizeX)> 512)
-					startpix=512-sx;
-
-				if((sx < 240) || startpix)
-				{
-					lineOBJpix+=2;
-					if(a1 & 0x2000)
-						t = sizeY - t - 1;
-					int c = (a2 & 0x3FF);
-					if(RENDERER_R_DISPCNT_Video_Mode > 2 && (c < 512))
-						continue;
-					if(a0 & 0x2000)
-					{
-
-						int inc = 32;
-						if(RENDERER_IO_REGISTERS[REG_DISPCNT] & 0x40)
-							inc = sizeX >> 2;
-						else
-							c &= 0x3FE;
-
-						int xxx = 0;
-						if(a1 & 0x1000)
-							xxx = sizeX-1;
-						int address = 0x10000 + ((((c+ (t>>3) * inc) << 5)
-									+ ((t & 7) << 3) + ((xxx>>3)<<6) + (xxx & 7))&0x7fff);
-						if(a1 & 0x1000)
-							xxx = 7;
-						for(int xx = 0; xx < sizeX; xx++)
-						{
-							if (xx >= startpix)
-								lineOBJpix--;
-							if (lineOBJpix<0)
-								continue;
-							if(sx < 240)
-							{
-								u8 color = vram[address];
-								if(color)
-									RENDERER_LINE[Layer_WIN_OBJ][sx] = 1;
-							}
-
-							sx = (sx+1) & 511;
-							if(a1 & 0x1000) {
-								xxx--;
-								address--;
-								if(xxx == -1) {
-									address -= 56;
-									xxx = 7;
-								}
-								if(address < 0x10000)
-									address += 0x8000;
-							} else {
-								xxx++;
-								address++;
-								if(xxx == 8) {
-									address += 56;
-									xxx = 0;
-								}
-								if(address > 0x17fff)
-									address -= 0x8000;
-							}
-						}
-					}
-					else
-					{
-						int inc = 32;
-						if(RENDERER_IO_REGISTERS[REG_DISPCNT] & 0x40)
-							inc = sizeX >> 3;
-						int xxx = 0;
-						if(a1 & 0x1000)
-							xxx = sizeX - 1;
-						int address = 0x10000 + ((((c + (t>>3) * inc)<<5)
-									+ ((t & 7)<<2) + ((xxx>>3)<<5) + ((xxx & 7) >> 1))&0x7fff);
-						// u32 prio = (((a2 >> 10) & 3) << 25) | ((a0 & 0x0c00)<<6);
-						// int palette = (a2 >> 8) & 0xF0;
-						if(a1 & 0x1000)
-						{
-							xxx = 7;
-							for(int xx = sizeX - 1; xx >= 0; xx--)
-							{
-								if (xx >= startpix)
-									lineOBJpix--;
-								if (lineOBJpix<0)
-									continue;
-								if(sx < 240)
-								{
-									u8 color = vram[address];
-									if(xx & 1)
-										color = (color >> 4);
-									else
-										color &= 0x0F;
-
-									if(color)
-										RENDERER_LINE[Layer_WIN_OBJ][sx] = 1;
-								}
-								sx = (sx+1) & 511;
-								xxx--;
-								if(!(xx & 1))
-									address--;
-								if(xxx == -1) {
-									xxx = 7;
-									address -= 28;
-								}
-								if(address < 0x10000)
-									address += 0x8000;
-							}
-						}
-						else
-						{
-							for(int xx = 0; xx < sizeX; xx++)
-							{
-								if (xx >= startpix)
-									lineOBJpix--;
-								if (lineOBJpix<0)
-									continue;
-								if(sx < 240)
-								{
-									u8 color = vram[address];
-									if(xx & 1)
-										color = (color >> 4);
-									else
-										color &= 0x0F;
-
-									if(color)
-										RENDERER_LINE[Layer_WIN_OBJ][sx] = 1;
-								}
-								sx = (sx+1) & 511;
-								xxx++;
-								if(xx & 1)
-									address++;
-								if(xxx == 8) {
-									address += 28;
-									xxx = 0;
-								}
-								if(address > 0x17fff)
-									address -= 0x8000;
-							}
-						}
-					}
-				}
-			}
-		}
-	}
-}
-
-/*============================================================
-	GBA.CPP
-============================================================ */
-int saveType = 0;
-bool useBios = false;
-bool skipBios = false;
-bool cpuIsMultiBoot = false; 
-int cpuSaveType = 0;
-bool enableRtc = false;
-bool mirroringEnable = false;
-bool skipSaveGameBattery = false;
-
-int cpuDmaCount = 0;
-
-#ifdef USE_SWITICKS
-int SWITicks = 0;
-#endif
-
-bool cpuSramEnabled = true;
-bool cpuFlashEnabled = true;
-bool cpuEEPROMEnabled = true;
-
-#ifdef MSB_FIRST
-bool cpuBiosSwapped = false;
-#endif
+#ifdef MSB_FIRST
+bool cpuBiosSwapped = false;
+#endif
 
 uint32_t myROM[] = {
 0xEA000006,
@@ -8832,47 +9732,90 @@ static INLINE int CPUUpdateTicks (void)
 	return cpuLoopTicks;
 }
 
+/*
+Windows.
+
+Windows 0 and 1 are kept as 240 bit masks of the pixels they cover, rebuilt
+only on WIN0H and WIN1H writes. The windowed renderers merge them with the
+OBJ window into one layer enable mask per pixel, once per line.
+*/
+static INLINE u32 gfxWindowBits(int word, int lo, int hi)
+{
+	int from = max(lo - (word << 5), 0);
+	int to = min(hi - (word << 5), 32);
+	if(from >= to)
+		return 0;
+	return (to == 32 ? 0xFFFFFFFF : (1u << to) - 1) & ~((1u << from) - 1);
+}
+
+// pixels in [x1, x2), wrapping around the right edge when x1 > x2
+static INLINE void gfxBuildWindowMask(u32 *mask, int x1, int x2)
+{
+	for(int word = 0; word < GFX_WIN_WORDS; ++word) {
+		if(x1 <= x2)
+			mask[word] = gfxWindowBits(word, x1, min(x2, 240));
+		else
+			mask[word] = gfxWindowBits(word, x1, 240) | gfxWindowBits(word, 0, x2);
+	}
+}
+
+// bit i set where pixel i of the OBJ window line is drawn
+static INLINE u32 gfxObjWindowBits(const u8 *objwin, int count)
+{
+	u32 bits = 0;
+	int i = 0;
+#if GFX_SSE2
+	for(; i + 16 <= count; i += 16)
+		bits |= (u32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(objwin + i))) << i;
+#endif
+	for(; i < count; ++i)
+		bits |= (u32)(objwin[i] >> 7) << i;
+	return ~bits;
+}
+
+template<int renderer_idx>
+static INLINE void gfxWindowLineMasks(u8 *masks, bool inWindow0, bool inWindow1)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+	// indexed by win0 << 2 | win1 << 1 | objwin, window 0 has priority
+	const u8 outside = (u8)RENDERER_R_WIN_Outside_Mask;
+	const u8 objwin = (u8)RENDERER_R_WIN_OBJ_Mask;
+	const u8 win0 = (u8)RENDERER_R_WIN_Window0_Mask;
+	const u8 win1 = (u8)RENDERER_R_WIN_Window1_Mask;
+	const u8 select[8] = { outside, objwin, win1, win1, win0, win0, win0, win0 };
+
+	for(int x = 0; x < 240; x += 32) {
+		int count = min(32, 240 - x);
+		u32 obj = gfxObjWindowBits(RENDERER_LINE[Layer_WIN_OBJ].prio + x, count);
+		u32 in0 = inWindow0 ? RENDERER_GFX_IN_WIN[0][x >> 5] : 0;
+		u32 in1 = inWindow1 ? RENDERER_GFX_IN_WIN[1][x >> 5] : 0;
+		for(int i = 0; i < count; ++i)
+			masks[x + i] = select[((in0 >> i) & 1) << 2 | ((in1 >> i) & 1) << 1 | ((obj >> i) & 1)];
+	}
+}
+
 #if THREADED_RENDERER
 
 	#define CPUUpdateWindow0() \
 	{ \
-	  int x00_window0 = R_WIN_Window0_X1; \
-	  int x01_window0 = R_WIN_Window0_X2; \
-	  int x00_lte_x01 = x00_window0 <= x01_window0; \
-	  for(int i = 0; i < 240; i++) \
-		  gfxInWin[0][i] = ((i >= x00_window0 && i < x01_window0) & x00_lte_x01) | ((i >= x00_window0 || i < x01_window0) & ~x00_lte_x01); \
+	  gfxDeferredWrite(GFX_PAGE_WINDOW); \
+	  gfxBuildWindowMask(gfxInWin[0], R_WIN_Window0_X1, R_WIN_Window0_X2); \
 	  ++threaded_gfxinwin_ver[0]; \
 	}
 
 	#define CPUUpdateWindow1() \
 	{ \
-	  int x00_window1 = R_WIN_Window1_X1; \
-	  int x01_window1 = R_WIN_Window1_X2; \
-	  int x00_lte_x01 = x00_window1 <= x01_window1; \
-	  for(int i = 0; i < 240; i++) \
-	   gfxInWin[1][i] = ((i >= x00_window1 && i < x01_window1) & x00_lte_x01) | ((i >= x00_window1 || i < x01_window1) & ~x00_lte_x01); \
+	  gfxDeferredWrite(GFX_PAGE_WINDOW); \
+	  gfxBuildWindowMask(gfxInWin[1], R_WIN_Window1_X1, R_WIN_Window1_X2); \
 	  ++threaded_gfxinwin_ver[1]; \
 	}
 
 #else
 
-	#define CPUUpdateWindow0() \
-	{ \
-	  int x00_window0 = R_WIN_Window0_X1; \
-	  int x01_window0 = R_WIN_Window0_X2; \
-	  int x00_lte_x01 = x00_window0 <= x01_window0; \
-	  for(int i = 0; i < 240; i++) \
-		  gfxInWin[0][i] = ((i >= x00_window0 && i < x01_window0) & x00_lte_x01) | ((i >= x00_window0 || i < x01_window0) & ~x00_lte_x01); \
-	}
+	#define CPUUpdateWindow0() gfxBuildWindowMask(gfxInWin[0], R_WIN_Window0_X1, R_WIN_Window0_X2)
 
-	#define CPUUpdateWindow1() \
-	{ \
-	  int x00_window1 = R_WIN_Window1_X1; \
-	  int x01_window1 = R_WIN_Window1_X2; \
-	  int x00_lte_x01 = x00_window1 <= x01_window1; \
-	  for(int i = 0; i < 240; i++) \
-	   gfxInWin[1][i] = ((i >= x00_window1 && i < x01_window1) & x00_lte_x01) | ((i >= x00_window1 || i < x01_window1) & ~x00_lte_x01); \
-	}
+	#define CPUUpdateWindow1() gfxBuildWindowMask(gfxInWin[1], R_WIN_Window1_X1, R_WIN_Window1_X2)
 
 #endif
 
@@ -8919,8 +9862,7 @@ unsigned CPUWriteState(uint8_t* data, unsigned size)
 	utilWriteMem(data, workRAM, 0x40000);
 	utilWriteMem(data, vram, 0x20000);
 	utilWriteMem(data, oam, 0x400);
-	utilWriteMem(data, pix[0], 4 * PIX_BUFFER_SCREEN_WIDTH * 160);
-	utilWriteMem(data, pix[1], 4 * PIX_BUFFER_SCREEN_WIDTH * 160);
+	utilWriteMem(data, fix, 4 * PIX_BUFFER_SCREEN_WIDTH * 160);
 	utilWriteMem(data, ioMem, 0x400);
 
 	eepromSaveGameMem(data);
@@ -9097,14 +10039,14 @@ void CPUCleanUp (void)
 		bios = NULL;
 	}
 
-	if(pix[0] != NULL) {
-		memalign_free(pix[0]);
-		pix[0] = NULL;
+	if(fix != NULL) {
+		memalign_free(fix);
+		fix = NULL;
 	}
 
-	if(pix[1] != NULL) {
-		memalign_free(pix[1]);
-		pix[1] = NULL;
+	if(view_pix != NULL) {
+		memalign_free(view_pix);
+		view_pix = NULL;
 	}
 
 	if(oam != NULL) {
@@ -9134,9 +10076,8 @@ bool CPUSetupBuffers()
 	paletteRAM = (uint8_t *)memalign_alloc_aligned(0x400);
 	vram = (uint8_t *)memalign_alloc_aligned(0x20000);
 	oam = (uint8_t *)memalign_alloc_aligned(0x400);
-	pix[0] = (uint16_t *)memalign_alloc_aligned(4 * PIX_BUFFER_SCREEN_WIDTH * 160);
-	pix[1] = (uint16_t *)memalign_alloc_aligned(4 * PIX_BUFFER_SCREEN_WIDTH * 160);
-	fix = (uint16_t *)memalign_alloc_aligned(4 * (PIX_BUFFER_SCREEN_WIDTH*2) * 160);
+	fix = (uint16_t *)memalign_alloc_aligned(4 * PIX_BUFFER_SCREEN_WIDTH * 160);
+	view_pix = (uint16_t *)memalign_alloc_aligned((MAX_STEREO_VIEWS - 2) * 240 * 160 * sizeof(uint16_t));
 	ioMem = (uint8_t *)memalign_alloc_aligned(0x400);
 
 	memset(rom, 0, 0x2000000);
@@ -9144,16 +10085,18 @@ bool CPUSetupBuffers()
 	memset(bios, 1, 0x4000);
 	memset(internalRAM, 1, 0x8000);
 	memset(paletteRAM, 1, 0x400);
+	gfxUpdateAllPalette();
 	memset(vram, 1, 0x20000);
+	gfxInvalidateAllTiles();
 	memset(oam, 1, 0x400);
-	memset(pix[0], 1, 4 * PIX_BUFFER_SCREEN_WIDTH * 160);
-	memset(pix[1], 1, 4 * PIX_BUFFER_SCREEN_WIDTH * 160);
-	memset(fix, 1, 4 * (PIX_BUFFER_SCREEN_WIDTH*2) * 160);
+	oamVersion++;
+	memset(fix, 1, 4 * PIX_BUFFER_SCREEN_WIDTH * 160);
+	memset(view_pix, 0, (MAX_STEREO_VIEWS - 2) * 240 * 160 * sizeof(uint16_t));
 	memset(ioMem, 1, 0x400);
 
 	if(rom == NULL || workRAM == NULL || bios == NULL ||
 	   internalRAM == NULL || paletteRAM == NULL ||
-	   vram == NULL || oam == NULL || pix[0] == NULL || pix[1] == NULL || ioMem == NULL) {
+	   vram == NULL || oam == NULL || fix == NULL || view_pix == NULL || ioMem == NULL) {
 		CPUCleanUp();
 		return false;
 	}
@@ -9163,10 +10106,10 @@ bool CPUSetupBuffers()
 
 	//CPUUpdateRenderBuffers(true);
 #if !THREADED_RENDERER
-	memset(line[Layer_BG0], -1, 240 * sizeof(u32));
-	memset(line[Layer_BG1], -1, 240 * sizeof(u32));
-	memset(line[Layer_BG2], -1, 240 * sizeof(u32));
-	memset(line[Layer_BG3], -1, 240 * sizeof(u32));
+	gfxClearLineBuffer(line_buffer[Layer_BG0]);
+	gfxClearLineBuffer(line_buffer[Layer_BG1]);
+	gfxClearLineBuffer(line_buffer[Layer_BG2]);
+	gfxClearLineBuffer(line_buffer[Layer_BG3]);
 #endif
 
 	return true;
@@ -9288,10 +10231,12 @@ void ThreadedRendererStart() {
 	for(int u = 0; u < THREADED_RENDERER_COUNT; ++u) {
 		init_renderer_context(threaded_renderer_contexts[u]);
 		threaded_renderer_contexts[u].renderer_control = 1;
+		threaded_renderer_contexts[u].renderer_sem = thread_sem_new(0);
+		threaded_renderer_contexts[u].producer_sem = thread_sem_new(0);
 
 		threaded_renderer_contexts[u].renderer_thread_id =
-			thread_run((u == 0) ? threaded_renderer_loop0 : threaded_renderer_loop, reinterpret_cast<void*>(intptr_t(u)),
-#if VITA
+			thread_run(threaded_renderer_loop, reinterpret_cast<void*>(intptr_t(u)),
+#if VITA && !THREADED_RENDERER_SPLIT_EYES
 				(u == 0) ? THREAD_PRIORITY_NORMAL : THREAD_PRIORITY_LOW);	
 #else
 				THREAD_PRIORITY_NORMAL);
@@ -9299,25 +10244,65 @@ void ThreadedRendererStart() {
 	}
 }
 
+// Waits until every context has finished the lines it was handed. The
+// deferred renderer draws the logged frame here.
+static void ThreadedRendererSync() {
+#if THREADED_RENDERER_DEFERRED
+	gfxDeferredRenderFrame();
+#else
+	for(int u = 0; u < THREADED_RENDERER_COUNT; ++u)
+		threaded_queue_wait(threaded_renderer_contexts[u], 0);
+#endif
+}
+
 void ThreadedRendererStop() {
 	for(int u = 0; u < THREADED_RENDERER_COUNT; ++u) {
-		threaded_renderer_contexts[u].renderer_control = 2;
+		thread_store_release(&threaded_renderer_contexts[u].renderer_control, 2);
+		threaded_queue_wake(threaded_renderer_contexts[u]);
 	}
 _join:;
 	for(int u = 0; u < THREADED_RENDERER_COUNT; ++u) {
-		if(threaded_renderer_contexts[u].renderer_control == 2) goto _join;
+		if(thread_load_acquire(&threaded_renderer_contexts[u].renderer_control) == 2) goto _join;
+	}
+	for(int u = 0; u < THREADED_RENDERER_COUNT; ++u) {
+		thread_sem_free(threaded_renderer_contexts[u].renderer_sem);
+		thread_sem_free(threaded_renderer_contexts[u].producer_sem);
 	}
+#if THREADED_RENDERER_DEFERRED
+	gfxFreePages();
+#endif
 }
 #endif
 
-/* we only use 16bit color depth */
+/* we only use 16bit color depth, both eyes share one side-by-side frame
+   and the views past them follow each other in view_pix */
 #if THREADED_RENDERER
-	#define GET_LINE_MIX_L (pix[0] + PIX_BUFFER_SCREEN_WIDTH * RENDERER_R_VCOUNT)
-	#define GET_LINE_MIX_R (pix[1] + PIX_BUFFER_SCREEN_WIDTH * RENDERER_R_VCOUNT)
+	#define GET_LINE_MIX_L (fix + PIX_BUFFER_SCREEN_WIDTH * RENDERER_R_VCOUNT)
+	#define GET_LINE_MIX_VIEW(__view__) ((__view__) == 1 ? GET_LINE_MIX_L + 240 : \
+		view_pix + 240 * (((__view__) - 2) * 160 + RENDERER_R_VCOUNT))
 #else
-	#define GET_LINE_MIX_L (pix[0] + PIX_BUFFER_SCREEN_WIDTH * R_VCOUNT)
-	#define GET_LINE_MIX_R (pix[1] + PIX_BUFFER_SCREEN_WIDTH * R_VCOUNT)
+	#define GET_LINE_MIX_L (fix + PIX_BUFFER_SCREEN_WIDTH * R_VCOUNT)
+	#define GET_LINE_MIX_VIEW(__view__) ((__view__) == 1 ? GET_LINE_MIX_L + 240 : \
+		view_pix + 240 * (((__view__) - 2) * 160 + R_VCOUNT))
 #endif
+#define GET_LINE_MIX_R GET_LINE_MIX_VIEW(RENDERER_DRAW_RIGHT_SCREEN)
+
+/* the depth plane follows the left eye only */
+#define GET_LINE_DEPTH ((depth_plane_enabled && RENDERER_DRAW_RIGHT_SCREEN == 0) ? depth_plane + 240 * RENDERER_R_VCOUNT : NULL)
+
+static const u8 gfxTopLayer[SpecialEffectTarget_BD + 1] = {
+	0, Layer_BG0, Layer_BG1, 0, Layer_BG2, 0, 0, 0, Layer_BG3,
+	0, 0, 0, 0, 0, 0, 0, Layer_OBJ,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 5
+};
+
+static INLINE u8 gfxPixelDepth(const gfxLayerLine *line, u8 top, int x)
+{
+	if(top == SpecialEffectTarget_BD)
+		return (5 << 4) | 3;
+	u8 layer = gfxTopLayer[top];
+	return (layer << 4) | GFX_PRIO_LEVEL_OF(line[layer].prio[x]);
+}
 
 template<int renderer_idx>
 static void mode0RenderLine (void)
@@ -9331,97 +10316,77 @@ static void mode0RenderLine (void)
 	fprintf(stderr, "MODE 0: Render Line\n");
 #endif
 	uint16_t* lineMix;
-	if (draw_right_screen == 0){
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
 		lineMix = GET_LINE_MIX_L;
 	} else {
 		lineMix = GET_LINE_MIX_R;	
 	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
 
 	uint32_t backdrop = RENDERER_BACKDROP;
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG0) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG0, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG0CNT], RENDERER_IO_REGISTERS[REG_BG0HOFS], RENDERER_IO_REGISTERS[REG_BG0VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG0, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG0CNT], RENDERER_IO_REGISTERS[REG_BG0HOFS]+((RENDERER_IO_REGISTERS[REG_BG0CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG0VOFS]);
-	}
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG1) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG1, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG1CNT], RENDERER_IO_REGISTERS[REG_BG1HOFS], RENDERER_IO_REGISTERS[REG_BG1VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG1, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG1CNT], RENDERER_IO_REGISTERS[REG_BG1HOFS]+((RENDERER_IO_REGISTERS[REG_BG1CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG1VOFS]);
-	}
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG2, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG2CNT], RENDERER_IO_REGISTERS[REG_BG2HOFS], RENDERER_IO_REGISTERS[REG_BG2VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG2, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG2CNT], RENDERER_IO_REGISTERS[REG_BG2HOFS]+((RENDERER_IO_REGISTERS[REG_BG2CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG2VOFS]);
-	}
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG3) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG3, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG3CNT], RENDERER_IO_REGISTERS[REG_BG3HOFS], RENDERER_IO_REGISTERS[REG_BG3VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG3, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG3CNT], RENDERER_IO_REGISTERS[REG_BG3HOFS]+((RENDERER_IO_REGISTERS[REG_BG3CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG3VOFS]);
-	}
-	}
-
 	for(int x = 0; x < 240; x++)
 	{
 		uint32_t color = backdrop;
+		uint8_t prio = GFX_PRIO_BACKDROP;
 		uint8_t top = SpecialEffectTarget_BD;
 
-		if(RENDERER_LINE[Layer_BG0][x] < color) {
-			color = RENDERER_LINE[Layer_BG0][x];
+		if(RENDERER_LINE[Layer_BG0].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_BG0].color[x];
+			prio = RENDERER_LINE[Layer_BG0].prio[x];
 			top = SpecialEffectTarget_BG0;
 		}
 
-		if((uint8_t)(RENDERER_LINE[Layer_BG1][x]>>24) < (uint8_t)(color >> 24)) {
-			color = RENDERER_LINE[Layer_BG1][x];
+		if(RENDERER_LINE[Layer_BG1].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_BG1].color[x];
+			prio = RENDERER_LINE[Layer_BG1].prio[x];
 			top = SpecialEffectTarget_BG1;
 		}
 
-		if((uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24) < (uint8_t)(color >> 24)) {
-			color = RENDERER_LINE[Layer_BG2][x];
+		if(RENDERER_LINE[Layer_BG2].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_BG2].color[x];
+			prio = RENDERER_LINE[Layer_BG2].prio[x];
 			top = SpecialEffectTarget_BG2;
 		}
 
-		if((uint8_t)(RENDERER_LINE[Layer_BG3][x]>>24) < (uint8_t)(color >> 24)) {
-			color = RENDERER_LINE[Layer_BG3][x];
+		if(RENDERER_LINE[Layer_BG3].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_BG3].color[x];
+			prio = RENDERER_LINE[Layer_BG3].prio[x];
 			top = SpecialEffectTarget_BG3;
 		}
 
-		if((uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(color >> 24)) {
-			color = RENDERER_LINE[Layer_OBJ][x];
+		if(RENDERER_LINE[Layer_OBJ].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_OBJ].color[x];
+			prio = RENDERER_LINE[Layer_OBJ].prio[x];
 			top = SpecialEffectTarget_OBJ;
 
-			if(color & 0x00010000) {
+			if(prio & GFX_PRIO_SEMI) {
 				// semi-transparent OBJ
 				uint32_t back = backdrop;
+				uint8_t backPrio = GFX_PRIO_BACKDROP;
 				uint8_t top2 = SpecialEffectTarget_BD;
 
-				if((uint8_t)(RENDERER_LINE[Layer_BG0][x]>>24) < (uint8_t)(back >> 24)) {
-					back = RENDERER_LINE[Layer_BG0][x];
+				if(RENDERER_LINE[Layer_BG0].prio[x] < backPrio) {
+					back = RENDERER_LINE[Layer_BG0].color[x];
+					backPrio = RENDERER_LINE[Layer_BG0].prio[x];
 					top2 = SpecialEffectTarget_BG0;
 				}
 
-				if((uint8_t)(RENDERER_LINE[Layer_BG1][x]>>24) < (uint8_t)(back >> 24)) {
-					back = RENDERER_LINE[Layer_BG1][x];
+				if(RENDERER_LINE[Layer_BG1].prio[x] < backPrio) {
+					back = RENDERER_LINE[Layer_BG1].color[x];
+					backPrio = RENDERER_LINE[Layer_BG1].prio[x];
 					top2 = SpecialEffectTarget_BG1;
 				}
 
-				if((uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24) < (uint8_t)(back >> 24)) {
-					back = RENDERER_LINE[Layer_BG2][x];
+				if(RENDERER_LINE[Layer_BG2].prio[x] < backPrio) {
+					back = RENDERER_LINE[Layer_BG2].color[x];
+					backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 					top2 = SpecialEffectTarget_BG2;
 				}
 
-				if((uint8_t)(RENDERER_LINE[Layer_BG3][x]>>24) < (uint8_t)(back >> 24)) {
-					back = RENDERER_LINE[Layer_BG3][x];
+				if(RENDERER_LINE[Layer_BG3].prio[x] < backPrio) {
+					back = RENDERER_LINE[Layer_BG3].color[x];
+					backPrio = RENDERER_LINE[Layer_BG3].prio[x];
 					top2 = SpecialEffectTarget_BG3;
 				}
 
@@ -9430,7 +10395,9 @@ static void mode0RenderLine (void)
 		}
 
 
-		lineMix[x] = CONVERT_COLOR(color);
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
 	}
 }
 
@@ -9446,76 +10413,51 @@ static void mode0RenderLineNoWindow (void)
 	fprintf(stderr, "MODE 0: Render Line No Window\n");
 #endif
 	uint16_t* lineMix;
-	if (draw_right_screen == 0){
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
 		lineMix = GET_LINE_MIX_L;
 	} else {
 		lineMix = GET_LINE_MIX_R;	
 	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
 
 	uint32_t backdrop = RENDERER_BACKDROP;
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG0) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG0, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG0CNT], RENDERER_IO_REGISTERS[REG_BG0HOFS], RENDERER_IO_REGISTERS[REG_BG0VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG0, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG0CNT], RENDERER_IO_REGISTERS[REG_BG0HOFS]+((RENDERER_IO_REGISTERS[REG_BG0CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG0VOFS]);
-	}
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG1) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG1, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG1CNT], RENDERER_IO_REGISTERS[REG_BG1HOFS], RENDERER_IO_REGISTERS[REG_BG1VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG1, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG1CNT], RENDERER_IO_REGISTERS[REG_BG1HOFS]+((RENDERER_IO_REGISTERS[REG_BG1CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG1VOFS]);
-	}
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG2, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG2CNT], RENDERER_IO_REGISTERS[REG_BG2HOFS], RENDERER_IO_REGISTERS[REG_BG2VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG2, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG2CNT], RENDERER_IO_REGISTERS[REG_BG2HOFS]+((RENDERER_IO_REGISTERS[REG_BG2CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG2VOFS]);
-	}
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG3) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG3, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG3CNT], RENDERER_IO_REGISTERS[REG_BG3HOFS], RENDERER_IO_REGISTERS[REG_BG3VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG3, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG3CNT], RENDERER_IO_REGISTERS[REG_BG3HOFS]+((RENDERER_IO_REGISTERS[REG_BG3CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG3VOFS]);
-	}
-	}
-
 	for(int x = 0; x < 240; x++) {
 		uint32_t color = backdrop;
+		uint8_t prio = GFX_PRIO_BACKDROP;
 		uint8_t top = SpecialEffectTarget_BD;
 
-		if(RENDERER_LINE[Layer_BG0][x] < color) {
-			color = RENDERER_LINE[Layer_BG0][x];
+		if(RENDERER_LINE[Layer_BG0].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_BG0].color[x];
+			prio = RENDERER_LINE[Layer_BG0].prio[x];
 			top = SpecialEffectTarget_BG0;
 		}
 
-		if(RENDERER_LINE[Layer_BG1][x] < (color & 0xFF000000)) {
-			color = RENDERER_LINE[Layer_BG1][x];
+		if(RENDERER_LINE[Layer_BG1].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_BG1].color[x];
+			prio = RENDERER_LINE[Layer_BG1].prio[x];
 			top = SpecialEffectTarget_BG1;
 		}
 
-		if(RENDERER_LINE[Layer_BG2][x] < (color & 0xFF000000)) {
-			color = RENDERER_LINE[Layer_BG2][x];
+		if(RENDERER_LINE[Layer_BG2].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_BG2].color[x];
+			prio = RENDERER_LINE[Layer_BG2].prio[x];
 			top = SpecialEffectTarget_BG2;
 		}
 
-		if(RENDERER_LINE[Layer_BG3][x] < (color & 0xFF000000)) {
-			color = RENDERER_LINE[Layer_BG3][x];
+		if(RENDERER_LINE[Layer_BG3].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_BG3].color[x];
+			prio = RENDERER_LINE[Layer_BG3].prio[x];
 			top = SpecialEffectTarget_BG3;
 		}
 
-		if(RENDERER_LINE[Layer_OBJ][x] < (color & 0xFF000000)) {
-			color = RENDERER_LINE[Layer_OBJ][x];
+		if(RENDERER_LINE[Layer_OBJ].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_OBJ].color[x];
+			prio = RENDERER_LINE[Layer_OBJ].prio[x];
 			top = SpecialEffectTarget_OBJ;
 		}
 
-		if(!(color & 0x00010000)) {
+		if(!(prio & GFX_PRIO_SEMI)) {
 			switch(RENDERER_R_BLDCNT_Color_Special_Effect)
 			{
 				case SpecialEffect_None:
@@ -9524,82 +10466,95 @@ static void mode0RenderLineNoWindow (void)
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
 					{
 						uint32_t back = backdrop;
+						uint8_t backPrio = GFX_PRIO_BACKDROP;
 						uint8_t top2 = SpecialEffectTarget_BD;
-						if((RENDERER_LINE[Layer_BG0][x] < back) && (top != SpecialEffectTarget_BG0))
+						if((RENDERER_LINE[Layer_BG0].prio[x] < backPrio) && (top != SpecialEffectTarget_BG0))
 						{
-							back = RENDERER_LINE[Layer_BG0][x];
+							back = RENDERER_LINE[Layer_BG0].color[x];
+							backPrio = RENDERER_LINE[Layer_BG0].prio[x];
 							top2 = SpecialEffectTarget_BG0;
 						}
 
-						if((RENDERER_LINE[Layer_BG1][x] < (back & 0xFF000000)) && (top != SpecialEffectTarget_BG1))
+						if((RENDERER_LINE[Layer_BG1].prio[x] < backPrio) && (top != SpecialEffectTarget_BG1))
 						{
-							back = RENDERER_LINE[Layer_BG1][x];
+							back = RENDERER_LINE[Layer_BG1].color[x];
+							backPrio = RENDERER_LINE[Layer_BG1].prio[x];
 							top2 = SpecialEffectTarget_BG1;
 						}
 
-						if((RENDERER_LINE[Layer_BG2][x] < (back & 0xFF000000)) && (top != SpecialEffectTarget_BG2))
+						if((RENDERER_LINE[Layer_BG2].prio[x] < backPrio) && (top != SpecialEffectTarget_BG2))
 						{
-							back = RENDERER_LINE[Layer_BG2][x];
+							back = RENDERER_LINE[Layer_BG2].color[x];
+							backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 							top2 = SpecialEffectTarget_BG2;
 						}
 
-						if((RENDERER_LINE[Layer_BG3][x] < (back & 0xFF000000)) && (top != SpecialEffectTarget_BG3))
+						if((RENDERER_LINE[Layer_BG3].prio[x] < backPrio) && (top != SpecialEffectTarget_BG3))
 						{
-							back = RENDERER_LINE[Layer_BG3][x];
+							back = RENDERER_LINE[Layer_BG3].color[x];
+							backPrio = RENDERER_LINE[Layer_BG3].prio[x];
 							top2 = SpecialEffectTarget_BG3;
 						}
 
-						if((RENDERER_LINE[Layer_OBJ][x] < (back & 0xFF000000)) && (top != SpecialEffectTarget_OBJ))
+						if((RENDERER_LINE[Layer_OBJ].prio[x] < backPrio) && (top != SpecialEffectTarget_OBJ))
 						{
-							back = RENDERER_LINE[Layer_OBJ][x];
+							back = RENDERER_LINE[Layer_OBJ].color[x];
+							backPrio = RENDERER_LINE[Layer_OBJ].prio[x];
 							top2 = SpecialEffectTarget_OBJ;
 						}
 
-						if(RENDERER_R_BLDCNT_IsTarget2(top2) && color < 0x80000000)
+						if(RENDERER_R_BLDCNT_IsTarget2(top2) && prio < GFX_PRIO_TRANSPARENT)
 						{
-							GFX_ALPHA_BLEND(color, back, coeff[COLEV & 0x1F], coeff[(COLEV >> 8) & 0x1F]);
+							GFX_ALPHA_BLEND(color, back, RENDERER_BLEND);
 						}
 
 					}
 					break;
 				case SpecialEffect_Brightness_Increase:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxIncreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxIncreaseBrightness(color, RENDERER_BLEND);
 					break;
 				case SpecialEffect_Brightness_Decrease:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxDecreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxDecreaseBrightness(color, RENDERER_BLEND);
 					break;
 			}
 		} else {
 			// semi-transparent OBJ
 			uint32_t back = backdrop;
+			uint8_t backPrio = GFX_PRIO_BACKDROP;
 			uint8_t top2 = SpecialEffectTarget_BD;
 
-			if(RENDERER_LINE[Layer_BG0][x] < back) {
-				back = RENDERER_LINE[Layer_BG0][x];
+			if(RENDERER_LINE[Layer_BG0].prio[x] < backPrio) {
+				back = RENDERER_LINE[Layer_BG0].color[x];
+				backPrio = RENDERER_LINE[Layer_BG0].prio[x];
 				top2 = SpecialEffectTarget_BG0;
 			}
 
-			if(RENDERER_LINE[Layer_BG1][x] < (back & 0xFF000000)) {
-				back = RENDERER_LINE[Layer_BG1][x];
+			if(RENDERER_LINE[Layer_BG1].prio[x] < backPrio) {
+				back = RENDERER_LINE[Layer_BG1].color[x];
+				backPrio = RENDERER_LINE[Layer_BG1].prio[x];
 				top2 = SpecialEffectTarget_BG1;
 			}
 
-			if(RENDERER_LINE[Layer_BG2][x] < (back & 0xFF000000)) {
-				back = RENDERER_LINE[Layer_BG2][x];
+			if(RENDERER_LINE[Layer_BG2].prio[x] < backPrio) {
+				back = RENDERER_LINE[Layer_BG2].color[x];
+				backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 				top2 = SpecialEffectTarget_BG2;
 			}
 
-			if(RENDERER_LINE[Layer_BG3][x] < (back & 0xFF000000)) {
-				back = RENDERER_LINE[Layer_BG3][x];
+			if(RENDERER_LINE[Layer_BG3].prio[x] < backPrio) {
+				back = RENDERER_LINE[Layer_BG3].color[x];
+				backPrio = RENDERER_LINE[Layer_BG3].prio[x];
 				top2 = SpecialEffectTarget_BG3;
 			}
 
 			alpha_blend_brightness_switch();
 		}
 
-		lineMix[x] = CONVERT_COLOR(color);
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
 	}
 }
 
@@ -9615,11 +10570,12 @@ static void mode0RenderLineAll (void)
 	fprintf(stderr, "MODE 0: Render Line All\n");
 #endif
 	uint16_t* lineMix;
-	if (draw_right_screen == 0){
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
 		lineMix = GET_LINE_MIX_L;
 	} else {
 		lineMix = GET_LINE_MIX_R;	
 	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
 
 	uint32_t backdrop = RENDERER_BACKDROP;
 
@@ -9645,102 +10601,73 @@ static void mode0RenderLineAll (void)
 			inWindow1 |= (RENDERER_R_VCOUNT >= v0 || RENDERER_R_VCOUNT < v1);
 	}
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG0) {
-	if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG0, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG0CNT], RENDERER_IO_REGISTERS[REG_BG0HOFS], RENDERER_IO_REGISTERS[REG_BG0VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG0, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG0CNT], RENDERER_IO_REGISTERS[REG_BG0HOFS]+((RENDERER_IO_REGISTERS[REG_BG0CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG0VOFS]);
-	}
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG1) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG1, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG1CNT], RENDERER_IO_REGISTERS[REG_BG1HOFS], RENDERER_IO_REGISTERS[REG_BG1VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG1, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG1CNT], RENDERER_IO_REGISTERS[REG_BG1HOFS]+((RENDERER_IO_REGISTERS[REG_BG1CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG1VOFS]);
-	}
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG2, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG2CNT], RENDERER_IO_REGISTERS[REG_BG2HOFS], RENDERER_IO_REGISTERS[REG_BG2VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG2, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG2CNT], RENDERER_IO_REGISTERS[REG_BG2HOFS]+((RENDERER_IO_REGISTERS[REG_BG2CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG2VOFS]);
-	}
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG3) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG3, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG3CNT], RENDERER_IO_REGISTERS[REG_BG3HOFS], RENDERER_IO_REGISTERS[REG_BG3VOFS]);
-		} else {
-		gfxDrawTextScreen<Layer_BG3, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG3CNT], RENDERER_IO_REGISTERS[REG_BG3HOFS]+((RENDERER_IO_REGISTERS[REG_BG3CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG3VOFS]);
-		}
-	}
-
-	uint8_t inWin0Mask = RENDERER_R_WIN_Window0_Mask;
-	uint8_t inWin1Mask = RENDERER_R_WIN_Window1_Mask;
-	uint8_t outMask = RENDERER_R_WIN_Outside_Mask;
+	uint8_t windowMask[240];
+	gfxWindowLineMasks<renderer_idx>(windowMask, inWindow0, inWindow1);
 
 	for(int x = 0; x < 240; x++) {
 		uint32_t color = backdrop;
+		uint8_t prio = GFX_PRIO_BACKDROP;
 		uint8_t top = SpecialEffectTarget_BD;
-		uint8_t mask = outMask;
+		uint8_t mask = windowMask[x];
 
-		if(!(RENDERER_LINE[Layer_WIN_OBJ][x] & 0x80000000)) {
-			mask = RENDERER_R_WIN_OBJ_Mask;
-		}
-
-		mask = SELECT(inWindow1 && RENDERER_GFX_IN_WIN[1][x], inWin1Mask, mask);
-		mask = SELECT(inWindow0 && RENDERER_GFX_IN_WIN[0][x], inWin0Mask, mask);
-
-		if((mask & LayerMask_BG0) && (RENDERER_LINE[Layer_BG0][x] < color)) {
-			color = RENDERER_LINE[Layer_BG0][x];
+		if((mask & LayerMask_BG0) && (RENDERER_LINE[Layer_BG0].prio[x] < prio)) {
+			color = RENDERER_LINE[Layer_BG0].color[x];
+			prio = RENDERER_LINE[Layer_BG0].prio[x];
 			top = SpecialEffectTarget_BG0;
 		}
 
-		if((mask & LayerMask_BG1) && ((uint8_t)(RENDERER_LINE[Layer_BG1][x]>>24) < (uint8_t)(color >> 24))) {
-			color = RENDERER_LINE[Layer_BG1][x];
+		if((mask & LayerMask_BG1) && (RENDERER_LINE[Layer_BG1].prio[x] < prio)) {
+			color = RENDERER_LINE[Layer_BG1].color[x];
+			prio = RENDERER_LINE[Layer_BG1].prio[x];
 			top = SpecialEffectTarget_BG1;
 		}
 
-		if((mask & LayerMask_BG2) && ((uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24) < (uint8_t)(color >> 24))) {
-			color = RENDERER_LINE[Layer_BG2][x];
+		if((mask & LayerMask_BG2) && (RENDERER_LINE[Layer_BG2].prio[x] < prio)) {
+			color = RENDERER_LINE[Layer_BG2].color[x];
+			prio = RENDERER_LINE[Layer_BG2].prio[x];
 			top = SpecialEffectTarget_BG2;
 		}
 
-		if((mask & LayerMask_BG3) && ((uint8_t)(RENDERER_LINE[Layer_BG3][x]>>24) < (uint8_t)(color >> 24))) {
-			color = RENDERER_LINE[Layer_BG3][x];
+		if((mask & LayerMask_BG3) && (RENDERER_LINE[Layer_BG3].prio[x] < prio)) {
+			color = RENDERER_LINE[Layer_BG3].color[x];
+			prio = RENDERER_LINE[Layer_BG3].prio[x];
 			top = SpecialEffectTarget_BG3;
 		}
 
-		if((mask & LayerMask_OBJ) && ((uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(color >> 24))) {
-			color = RENDERER_LINE[Layer_OBJ][x];
+		if((mask & LayerMask_OBJ) && (RENDERER_LINE[Layer_OBJ].prio[x] < prio)) {
+			color = RENDERER_LINE[Layer_OBJ].color[x];
+			prio = RENDERER_LINE[Layer_OBJ].prio[x];
 			top = SpecialEffectTarget_OBJ;
 		}
 
-		if(color & 0x00010000)
+		if(prio & GFX_PRIO_SEMI)
 		{
 			// semi-transparent OBJ
 			uint32_t back = backdrop;
+			uint8_t backPrio = GFX_PRIO_BACKDROP;
 			uint8_t top2 = SpecialEffectTarget_BD;
 
-			if((mask & LayerMask_BG0) && ((uint8_t)(RENDERER_LINE[Layer_BG0][x]>>24) < (uint8_t)(back >> 24))) {
-				back = RENDERER_LINE[Layer_BG0][x];
+			if((mask & LayerMask_BG0) && (RENDERER_LINE[Layer_BG0].prio[x] < backPrio)) {
+				back = RENDERER_LINE[Layer_BG0].color[x];
+				backPrio = RENDERER_LINE[Layer_BG0].prio[x];
 				top2 = SpecialEffectTarget_BG0;
 			}
 
-			if((mask & LayerMask_BG1) && ((uint8_t)(RENDERER_LINE[Layer_BG1][x]>>24) < (uint8_t)(back >> 24))) {
-				back = RENDERER_LINE[Layer_BG1][x];
+			if((mask & LayerMask_BG1) && (RENDERER_LINE[Layer_BG1].prio[x] < backPrio)) {
+				back = RENDERER_LINE[Layer_BG1].color[x];
+				backPrio = RENDERER_LINE[Layer_BG1].prio[x];
 				top2 = SpecialEffectTarget_BG1;
 			}
 
-			if((mask & LayerMask_BG2) && ((uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24) < (uint8_t)(back >> 24))) {
-				back = RENDERER_LINE[Layer_BG2][x];
+			if((mask & LayerMask_BG2) && (RENDERER_LINE[Layer_BG2].prio[x] < backPrio)) {
+				back = RENDERER_LINE[Layer_BG2].color[x];
+				backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 				top2 = SpecialEffectTarget_BG2;
 			}
 
-			if((mask & LayerMask_BG3) && ((uint8_t)(RENDERER_LINE[Layer_BG3][x]>>24) < (uint8_t)(back >> 24))) {
-				back = RENDERER_LINE[Layer_BG3][x];
+			if((mask & LayerMask_BG3) && (RENDERER_LINE[Layer_BG3].prio[x] < backPrio)) {
+				back = RENDERER_LINE[Layer_BG3].color[x];
+				backPrio = RENDERER_LINE[Layer_BG3].prio[x];
 				top2 = SpecialEffectTarget_BG3;
 			}
 
@@ -9756,52 +10683,60 @@ static void mode0RenderLineAll (void)
 				case SpecialEffect_Alpha_Blending:
 					{
 						uint32_t back = backdrop;
+						uint8_t backPrio = GFX_PRIO_BACKDROP;
 						uint8_t top2 = SpecialEffectTarget_BD;
-						if(((mask & LayerMask_BG0) && (uint8_t)(RENDERER_LINE[Layer_BG0][x]>>24) < (uint8_t)(back >> 24)) && top != SpecialEffectTarget_BG0)
+						if(((mask & LayerMask_BG0) && RENDERER_LINE[Layer_BG0].prio[x] < backPrio) && top != SpecialEffectTarget_BG0)
 						{
-							back = RENDERER_LINE[Layer_BG0][x];
+							back = RENDERER_LINE[Layer_BG0].color[x];
+							backPrio = RENDERER_LINE[Layer_BG0].prio[x];
 							top2 = SpecialEffectTarget_BG0;
 						}
 
-						if(((mask & LayerMask_BG1) && (uint8_t)(RENDERER_LINE[Layer_BG1][x]>>24) < (uint8_t)(back >> 24)) && top != SpecialEffectTarget_BG1)
+						if(((mask & LayerMask_BG1) && RENDERER_LINE[Layer_BG1].prio[x] < backPrio) && top != SpecialEffectTarget_BG1)
 						{
-							back = RENDERER_LINE[Layer_BG1][x];
+							back = RENDERER_LINE[Layer_BG1].color[x];
+							backPrio = RENDERER_LINE[Layer_BG1].prio[x];
 							top2 = SpecialEffectTarget_BG1;
 						}
 
-						if(((mask & LayerMask_BG2) && (uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24) < (uint8_t)(back >> 24)) && top != SpecialEffectTarget_BG2)
+						if(((mask & LayerMask_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < backPrio) && top != SpecialEffectTarget_BG2)
 						{
-							back = RENDERER_LINE[Layer_BG2][x];
+							back = RENDERER_LINE[Layer_BG2].color[x];
+							backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 							top2 = SpecialEffectTarget_BG2;
 						}
 
-						if(((mask & LayerMask_BG3) && (uint8_t)(RENDERER_LINE[Layer_BG3][x]>>24) < (uint8_t)(back >> 24)) && top != SpecialEffectTarget_BG3)
+						if(((mask & LayerMask_BG3) && RENDERER_LINE[Layer_BG3].prio[x] < backPrio) && top != SpecialEffectTarget_BG3)
 						{
-							back = RENDERER_LINE[Layer_BG3][x];
+							back = RENDERER_LINE[Layer_BG3].color[x];
+							backPrio = RENDERER_LINE[Layer_BG3].prio[x];
 							top2 = SpecialEffectTarget_BG3;
 						}
 
-						if(((mask & LayerMask_OBJ) && (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(back >> 24)) && top != SpecialEffectTarget_OBJ) {
-							back = RENDERER_LINE[Layer_OBJ][x];
+						if(((mask & LayerMask_OBJ) && RENDERER_LINE[Layer_OBJ].prio[x] < backPrio) && top != SpecialEffectTarget_OBJ) {
+							back = RENDERER_LINE[Layer_OBJ].color[x];
+							backPrio = RENDERER_LINE[Layer_OBJ].prio[x];
 							top2 = SpecialEffectTarget_OBJ;
 						}
 
-						if(RENDERER_R_BLDCNT_IsTarget2(top2) && color < 0x80000000)
+						if(RENDERER_R_BLDCNT_IsTarget2(top2) && prio < GFX_PRIO_TRANSPARENT)
 						{
-							GFX_ALPHA_BLEND(color, back, coeff[COLEV & 0x1F], coeff[(COLEV >> 8) & 0x1F]);
+							GFX_ALPHA_BLEND(color, back, RENDERER_BLEND);
 						}
 					}
 					break;
 				case SpecialEffect_Brightness_Increase:
-					color = gfxIncreaseBrightness(color, coeff[COLY & 0x1F]);
+					color = gfxIncreaseBrightness(color, RENDERER_BLEND);
 					break;
 				case SpecialEffect_Brightness_Decrease:
-					color = gfxDecreaseBrightness(color, coeff[COLY & 0x1F]);
+					color = gfxDecreaseBrightness(color, RENDERER_BLEND);
 					break;
 			}
 		}
 
-		lineMix[x] = CONVERT_COLOR(color);
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
 	}
 }
 
@@ -9827,43 +10762,23 @@ static void mode1RenderLine (void)
 	fprintf(stderr, "MODE 1: Render Line\n");
 #endif
 	uint16_t* lineMix;
-	if (draw_right_screen == 0){
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
 		lineMix = GET_LINE_MIX_L;
 	} else {
 		lineMix = GET_LINE_MIX_R;	
 	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
 
 	uint32_t backdrop = RENDERER_BACKDROP;
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG0) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG0, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG0CNT], RENDERER_IO_REGISTERS[REG_BG0HOFS], RENDERER_IO_REGISTERS[REG_BG0VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG0, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG0CNT], RENDERER_IO_REGISTERS[REG_BG0HOFS]+((RENDERER_IO_REGISTERS[REG_BG0CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG0VOFS]);
-	}
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG1) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG1, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG1CNT], RENDERER_IO_REGISTERS[REG_BG1HOFS], RENDERER_IO_REGISTERS[REG_BG1VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG1, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG1CNT], RENDERER_IO_REGISTERS[REG_BG1HOFS]+((RENDERER_IO_REGISTERS[REG_BG1CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG1VOFS]);
-	}
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		gfxDrawRotScreen<Layer_BG2, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG2CNT], RENDERER_BG2X_L, RENDERER_BG2X_H, RENDERER_BG2Y_L, RENDERER_BG2Y_H,
-				RENDERER_IO_REGISTERS[REG_BG2PA], RENDERER_IO_REGISTERS[REG_BG2PB], RENDERER_IO_REGISTERS[REG_BG2PC], RENDERER_IO_REGISTERS[REG_BG2PD],
-				RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C);
-	}
-
 	for(uint32_t x = 0; x < 240u; ++x) {
 		uint32_t color = backdrop;
+		uint8_t prio = GFX_PRIO_BACKDROP;
 		uint8_t top = SpecialEffectTarget_BD;
 
-		uint8_t li1 = (uint8_t)(RENDERER_LINE[Layer_BG1][x]>>24);
-		uint8_t li2 = (uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24);
-		uint8_t li4 = (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24);	
+		uint8_t li1 = RENDERER_LINE[Layer_BG1].prio[x];
+		uint8_t li2 = RENDERER_LINE[Layer_BG2].prio[x];
+		uint8_t li4 = RENDERER_LINE[Layer_OBJ].prio[x];	
 
 		uint8_t r = 	(li2 < li1) ? (li2) : (li1);
 
@@ -9871,45 +10786,53 @@ static void mode1RenderLine (void)
 			r = 	(li4);
 		}
 
-		if(RENDERER_LINE[Layer_BG0][x] < backdrop) {
-			color = RENDERER_LINE[Layer_BG0][x];
+		if(RENDERER_LINE[Layer_BG0].prio[x] < GFX_PRIO_BACKDROP) {
+			color = RENDERER_LINE[Layer_BG0].color[x];
+			prio = RENDERER_LINE[Layer_BG0].prio[x];
 			top = SpecialEffectTarget_BG0;
 		}
 
-		if(r < (uint8_t)(color >> 24)) {
+		if(r < prio) {
 			if(r == li1){
-				color = RENDERER_LINE[Layer_BG1][x];
+				color = RENDERER_LINE[Layer_BG1].color[x];
+				prio = RENDERER_LINE[Layer_BG1].prio[x];
 				top = SpecialEffectTarget_BG1;
 			}else if(r == li2){
-				color = RENDERER_LINE[Layer_BG2][x];
+				color = RENDERER_LINE[Layer_BG2].color[x];
+				prio = RENDERER_LINE[Layer_BG2].prio[x];
 				top = SpecialEffectTarget_BG2;
 			}else if(r == li4){
-				color = RENDERER_LINE[Layer_OBJ][x];
+				color = RENDERER_LINE[Layer_OBJ].color[x];
+				prio = RENDERER_LINE[Layer_OBJ].prio[x];
 				top = SpecialEffectTarget_OBJ;
-				if((color & 0x00010000))
+				if((prio & GFX_PRIO_SEMI))
 				{
 					// semi-transparent OBJ
 					uint32_t back = backdrop;
+					uint8_t backPrio = GFX_PRIO_BACKDROP;
 					uint8_t top2 = SpecialEffectTarget_BD;
 
-					uint8_t li0 = (uint8_t)(RENDERER_LINE[Layer_BG0][x]>>24);
-					uint8_t li1 = (uint8_t)(RENDERER_LINE[Layer_BG1][x]>>24);
-					uint8_t li2 = (uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24);
+					uint8_t li0 = RENDERER_LINE[Layer_BG0].prio[x];
+					uint8_t li1 = RENDERER_LINE[Layer_BG1].prio[x];
+					uint8_t li2 = RENDERER_LINE[Layer_BG2].prio[x];
 					uint8_t r = 	(li1 < li0) ? (li1) : (li0);
 
 					if(li2 < r) {
 						r =  (li2);
 					}
 
-					if(r < (uint8_t)(back >> 24)) {
+					if(r < backPrio) {
 						if(r == li0){
-							back = RENDERER_LINE[Layer_BG0][x];
+							back = RENDERER_LINE[Layer_BG0].color[x];
+							backPrio = RENDERER_LINE[Layer_BG0].prio[x];
 							top2 = SpecialEffectTarget_BG0;
 						}else if(r == li1){
-							back = RENDERER_LINE[Layer_BG1][x];
+							back = RENDERER_LINE[Layer_BG1].color[x];
+							backPrio = RENDERER_LINE[Layer_BG1].prio[x];
 							top2 = SpecialEffectTarget_BG1;
 						}else if(r == li2){
-							back = RENDERER_LINE[Layer_BG2][x];
+							back = RENDERER_LINE[Layer_BG2].color[x];
+							backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 							top2 = SpecialEffectTarget_BG2;
 						}
 					}
@@ -9920,12 +10843,11 @@ static void mode1RenderLine (void)
 		}
 
 
-		lineMix[x] = CONVERT_COLOR(color);
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
 	}
 
-#if !THREADED_RENDERER
-	RENDERER_BG2C = 0;
-#endif
 }
 
 template<int renderer_idx>
@@ -9940,43 +10862,23 @@ static void mode1RenderLineNoWindow (void)
 	fprintf(stderr, "MODE 1: Render Line No Window\n");
 #endif
 	uint16_t* lineMix;
-	if (draw_right_screen == 0){
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
 		lineMix = GET_LINE_MIX_L;
 	} else {
 		lineMix = GET_LINE_MIX_R;	
 	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
 
 	uint32_t backdrop = RENDERER_BACKDROP;
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG0) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG0, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG0CNT], RENDERER_IO_REGISTERS[REG_BG0HOFS], RENDERER_IO_REGISTERS[REG_BG0VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG0, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG0CNT], RENDERER_IO_REGISTERS[REG_BG0HOFS]+((RENDERER_IO_REGISTERS[REG_BG0CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG0VOFS]);
-	}
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG1) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG1, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG1CNT], RENDERER_IO_REGISTERS[REG_BG1HOFS], RENDERER_IO_REGISTERS[REG_BG1VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG1, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG1CNT], RENDERER_IO_REGISTERS[REG_BG1HOFS]+((RENDERER_IO_REGISTERS[REG_BG1CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG1VOFS]);
-	}
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		gfxDrawRotScreen<Layer_BG2, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG2CNT], RENDERER_BG2X_L, RENDERER_BG2X_H, RENDERER_BG2Y_L, RENDERER_BG2Y_H,
-				RENDERER_IO_REGISTERS[REG_BG2PA], RENDERER_IO_REGISTERS[REG_BG2PB], RENDERER_IO_REGISTERS[REG_BG2PC], RENDERER_IO_REGISTERS[REG_BG2PD],
-				RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C);
-	}
-
 	for(int x = 0; x < 240; ++x) {
 		uint32_t color = backdrop;
+		uint8_t prio = GFX_PRIO_BACKDROP;
 		uint8_t top = SpecialEffectTarget_BD;
 
-		uint8_t li1 = (uint8_t)(RENDERER_LINE[Layer_BG1][x]>>24);
-		uint8_t li2 = (uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24);
-		uint8_t li4 = (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24);	
+		uint8_t li1 = RENDERER_LINE[Layer_BG1].prio[x];
+		uint8_t li2 = RENDERER_LINE[Layer_BG2].prio[x];
+		uint8_t li4 = RENDERER_LINE[Layer_OBJ].prio[x];	
 
 		uint8_t r = 	(li2 < li1) ? (li2) : (li1);
 
@@ -9984,25 +10886,29 @@ static void mode1RenderLineNoWindow (void)
 			r = 	(li4);
 		}
 
-		if(RENDERER_LINE[Layer_BG0][x] < backdrop) {
-			color = RENDERER_LINE[Layer_BG0][x];
+		if(RENDERER_LINE[Layer_BG0].prio[x] < GFX_PRIO_BACKDROP) {
+			color = RENDERER_LINE[Layer_BG0].color[x];
+			prio = RENDERER_LINE[Layer_BG0].prio[x];
 			top = SpecialEffectTarget_BG0;
 		}
 
-		if(r < (uint8_t)(color >> 24)) {
+		if(r < prio) {
 			if(r == li1){
-				color = RENDERER_LINE[Layer_BG1][x];
+				color = RENDERER_LINE[Layer_BG1].color[x];
+				prio = RENDERER_LINE[Layer_BG1].prio[x];
 				top = SpecialEffectTarget_BG1;
 			}else if(r == li2){
-				color = RENDERER_LINE[Layer_BG2][x];
+				color = RENDERER_LINE[Layer_BG2].color[x];
+				prio = RENDERER_LINE[Layer_BG2].prio[x];
 				top = SpecialEffectTarget_BG2;
 			}else if(r == li4){
-				color = RENDERER_LINE[Layer_OBJ][x];
+				color = RENDERER_LINE[Layer_OBJ].color[x];
+				prio = RENDERER_LINE[Layer_OBJ].prio[x];
 				top = SpecialEffectTarget_OBJ;
 			}
 		}
 
-		if(!(color & 0x00010000)) {
+		if(!(prio & GFX_PRIO_SEMI)) {
 			switch(RENDERER_R_BLDCNT_Color_Special_Effect)
 			{
 				case SpecialEffect_None:
@@ -10011,51 +10917,57 @@ static void mode1RenderLineNoWindow (void)
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
 					{
 						uint32_t back = backdrop;
+						uint8_t backPrio = GFX_PRIO_BACKDROP;
 						uint8_t top2 = SpecialEffectTarget_BD;
 
-						if((top != SpecialEffectTarget_BG0) && (uint8_t)(RENDERER_LINE[Layer_BG0][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_BG0][x];
+						if((top != SpecialEffectTarget_BG0) && RENDERER_LINE[Layer_BG0].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_BG0].color[x];
+							backPrio = RENDERER_LINE[Layer_BG0].prio[x];
 							top2 = SpecialEffectTarget_BG0;
 						}
 
-						if((top != SpecialEffectTarget_BG1) && (uint8_t)(RENDERER_LINE[Layer_BG1][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_BG1][x];
+						if((top != SpecialEffectTarget_BG1) && RENDERER_LINE[Layer_BG1].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_BG1].color[x];
+							backPrio = RENDERER_LINE[Layer_BG1].prio[x];
 							top2 = SpecialEffectTarget_BG1;
 						}
 
-						if((top != SpecialEffectTarget_BG2) && (uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_BG2][x];
+						if((top != SpecialEffectTarget_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_BG2].color[x];
+							backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 							top2 = SpecialEffectTarget_BG2;
 						}
 
-						if((top != SpecialEffectTarget_OBJ) && (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_OBJ][x];
+						if((top != SpecialEffectTarget_OBJ) && RENDERER_LINE[Layer_OBJ].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_OBJ].color[x];
+							backPrio = RENDERER_LINE[Layer_OBJ].prio[x];
 							top2 = SpecialEffectTarget_OBJ;
 						}
 
-						if(RENDERER_R_BLDCNT_IsTarget2(top2) && color < 0x80000000)
+						if(RENDERER_R_BLDCNT_IsTarget2(top2) && prio < GFX_PRIO_TRANSPARENT)
 						{
-							GFX_ALPHA_BLEND(color, back, coeff[COLEV & 0x1F], coeff[(COLEV >> 8) & 0x1F]);
+							GFX_ALPHA_BLEND(color, back, RENDERER_BLEND);
 						}
 					}
 					break;
 				case SpecialEffect_Brightness_Increase:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxIncreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxIncreaseBrightness(color, RENDERER_BLEND);
 					break;
 				case SpecialEffect_Brightness_Decrease:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxDecreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxDecreaseBrightness(color, RENDERER_BLEND);
 					break;
 			}
 		} else {
 			// semi-transparent OBJ
 			uint32_t back = backdrop;
+			uint8_t backPrio = GFX_PRIO_BACKDROP;
 			uint8_t top2 = SpecialEffectTarget_BD;
 
-			uint8_t li0 = (uint8_t)(RENDERER_LINE[Layer_BG0][x]>>24);
-			uint8_t li1 = (uint8_t)(RENDERER_LINE[Layer_BG1][x]>>24);
-			uint8_t li2 = (uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24);	
+			uint8_t li0 = RENDERER_LINE[Layer_BG0].prio[x];
+			uint8_t li1 = RENDERER_LINE[Layer_BG1].prio[x];
+			uint8_t li2 = RENDERER_LINE[Layer_BG2].prio[x];	
 
 			uint8_t r = 	(li1 < li0) ? (li1) : (li0);
 
@@ -10063,21 +10975,24 @@ static void mode1RenderLineNoWindow (void)
 				r =  (li2);
 			}
 
-			if(r < (uint8_t)(back >> 24))
+			if(r < backPrio)
 			{
 				if(r == li0)
 				{
-					back = RENDERER_LINE[Layer_BG0][x];
+					back = RENDERER_LINE[Layer_BG0].color[x];
+					backPrio = RENDERER_LINE[Layer_BG0].prio[x];
 					top2 = SpecialEffectTarget_BG0;
 				}
 				else if(r == li1)
 				{
-					back = RENDERER_LINE[Layer_BG1][x];
+					back = RENDERER_LINE[Layer_BG1].color[x];
+					backPrio = RENDERER_LINE[Layer_BG1].prio[x];
 					top2 = SpecialEffectTarget_BG1;
 				}
 				else if(r == li2)
 				{
-					back = RENDERER_LINE[Layer_BG2][x];
+					back = RENDERER_LINE[Layer_BG2].color[x];
+					backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 					top2 = SpecialEffectTarget_BG2;
 				}
 			}
@@ -10085,12 +11000,11 @@ static void mode1RenderLineNoWindow (void)
 			alpha_blend_brightness_switch();
 		}
 
-		lineMix[x] = CONVERT_COLOR(color);
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
 	}
 
-#if !THREADED_RENDERER
-	RENDERER_BG2C = 0;
-#endif
 }
 
 template<int renderer_idx>
@@ -10105,11 +11019,12 @@ static void mode1RenderLineAll (void)
 	fprintf(stderr, "MODE 1: Render Line All\n");
 #endif
 	uint16_t* lineMix;
-	if (draw_right_screen == 0){
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
 		lineMix = GET_LINE_MIX_L;
 	} else {
 		lineMix = GET_LINE_MIX_R;	
 	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
 
 	uint32_t backdrop = RENDERER_BACKDROP;
 	
@@ -10129,82 +11044,61 @@ static void mode1RenderLineAll (void)
 		inWindow1 = (uint8_t)(RENDERER_R_VCOUNT - v0) < (uint8_t)(v1 - v0) || ((v0 == v1) && (v0 >= 0xe8));
 	}
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG0) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG0, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG0CNT], RENDERER_IO_REGISTERS[REG_BG0HOFS], RENDERER_IO_REGISTERS[REG_BG0VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG0, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG0CNT], RENDERER_IO_REGISTERS[REG_BG0HOFS]+((RENDERER_IO_REGISTERS[REG_BG0CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG0VOFS]);
-	}
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG1) {
-		if (draw_right_screen == 0){
-		gfxDrawTextScreen<Layer_BG1, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG1CNT], RENDERER_IO_REGISTERS[REG_BG1HOFS], RENDERER_IO_REGISTERS[REG_BG1VOFS]);
-	} else {
-		gfxDrawTextScreen<Layer_BG1, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG1CNT], RENDERER_IO_REGISTERS[REG_BG1HOFS]+((RENDERER_IO_REGISTERS[REG_BG1CNT] & 3) * parallax_offset), RENDERER_IO_REGISTERS[REG_BG1VOFS]);
-	}
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		gfxDrawRotScreen<Layer_BG2, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG2CNT], RENDERER_BG2X_L, RENDERER_BG2X_H, RENDERER_BG2Y_L, RENDERER_BG2Y_H,
-				RENDERER_IO_REGISTERS[REG_BG2PA], RENDERER_IO_REGISTERS[REG_BG2PB], RENDERER_IO_REGISTERS[REG_BG2PC], RENDERER_IO_REGISTERS[REG_BG2PD],
-				RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C);
-	}
-
-	uint8_t inWin0Mask = RENDERER_R_WIN_Window0_Mask;
-	uint8_t inWin1Mask = RENDERER_R_WIN_Window1_Mask;
-	uint8_t outMask = RENDERER_R_WIN_Outside_Mask;
+	uint8_t windowMask[240];
+	gfxWindowLineMasks<renderer_idx>(windowMask, inWindow0, inWindow1);
 
 	for(int x = 0; x < 240; ++x) {
 		uint32_t color = backdrop;
+		uint8_t prio = GFX_PRIO_BACKDROP;
 		uint8_t top = SpecialEffectTarget_BD;
-		uint8_t mask = outMask;
-
-		if(!(RENDERER_LINE[Layer_WIN_OBJ][x] & 0x80000000)) {
-			mask = RENDERER_R_WIN_OBJ_Mask;
-		}
-
-		mask = SELECT(inWindow1 && RENDERER_GFX_IN_WIN[1][x], inWin1Mask, mask);
-		mask = SELECT(inWindow0 && RENDERER_GFX_IN_WIN[0][x], inWin0Mask, mask);
+		uint8_t mask = windowMask[x];
 
 		// At the very least, move the inexpensive 'mask' operation up front
-		if((mask & LayerMask_BG0) && RENDERER_LINE[Layer_BG0][x] < backdrop) {
-			color = RENDERER_LINE[Layer_BG0][x];
+		if((mask & LayerMask_BG0) && RENDERER_LINE[Layer_BG0].prio[x] < GFX_PRIO_BACKDROP) {
+			color = RENDERER_LINE[Layer_BG0].color[x];
+			prio = RENDERER_LINE[Layer_BG0].prio[x];
 			top = SpecialEffectTarget_BG0;
 		}
 
-		if((mask & LayerMask_BG1) && (uint8_t)(RENDERER_LINE[Layer_BG1][x]>>24) < (uint8_t)(color >> 24)) {
-			color = RENDERER_LINE[Layer_BG1][x];
+		if((mask & LayerMask_BG1) && RENDERER_LINE[Layer_BG1].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_BG1].color[x];
+			prio = RENDERER_LINE[Layer_BG1].prio[x];
 			top = SpecialEffectTarget_BG1;
 		}
 
-		if((mask & LayerMask_BG2) && (uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24) < (uint8_t)(color >> 24)) {
-			color = RENDERER_LINE[Layer_BG2][x];
+		if((mask & LayerMask_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_BG2].color[x];
+			prio = RENDERER_LINE[Layer_BG2].prio[x];
 			top = SpecialEffectTarget_BG2;
 		}
 
-		if((mask & LayerMask_OBJ) && (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(color >> 24)) {
-			color = RENDERER_LINE[Layer_OBJ][x];
+		if((mask & LayerMask_OBJ) && RENDERER_LINE[Layer_OBJ].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_OBJ].color[x];
+			prio = RENDERER_LINE[Layer_OBJ].prio[x];
 			top = SpecialEffectTarget_OBJ;
 		}
 
-		if(color & 0x00010000) {
+		if(prio & GFX_PRIO_SEMI) {
 			// semi-transparent OBJ
 			uint32_t back = backdrop;
+			uint8_t backPrio = GFX_PRIO_BACKDROP;
 			uint8_t top2 = SpecialEffectTarget_BD;
 
-			if((mask & LayerMask_BG0) && (uint8_t)(RENDERER_LINE[Layer_BG0][x]>>24) < (uint8_t)(backdrop >> 24)) {
-				back = RENDERER_LINE[Layer_BG0][x];
+			if((mask & LayerMask_BG0) && RENDERER_LINE[Layer_BG0].prio[x] < GFX_PRIO_BACKDROP) {
+				back = RENDERER_LINE[Layer_BG0].color[x];
+				backPrio = RENDERER_LINE[Layer_BG0].prio[x];
 				top2 = SpecialEffectTarget_BG0;
 			}
 
-			if((mask & LayerMask_BG1) && (uint8_t)(RENDERER_LINE[Layer_BG1][x]>>24) < (uint8_t)(back >> 24)) {
-				back = RENDERER_LINE[Layer_BG1][x];
+			if((mask & LayerMask_BG1) && RENDERER_LINE[Layer_BG1].prio[x] < backPrio) {
+				back = RENDERER_LINE[Layer_BG1].color[x];
+				backPrio = RENDERER_LINE[Layer_BG1].prio[x];
 				top2 = SpecialEffectTarget_BG1;
 			}
 
-			if((mask & LayerMask_BG2) && (uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24) < (uint8_t)(back >> 24)) {
-				back = RENDERER_LINE[Layer_BG2][x];
+			if((mask & LayerMask_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < backPrio) {
+				back = RENDERER_LINE[Layer_BG2].color[x];
+				backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 				top2 = SpecialEffectTarget_BG2;
 			}
 
@@ -10219,51 +11113,55 @@ static void mode1RenderLineAll (void)
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
 					{
 						uint32_t back = backdrop;
+						uint8_t backPrio = GFX_PRIO_BACKDROP;
 						uint8_t top2 = SpecialEffectTarget_BD;
 
-						if((mask & LayerMask_BG0) && (top != SpecialEffectTarget_BG0) && (uint8_t)(RENDERER_LINE[Layer_BG0][x]>>24) < (uint8_t)(backdrop >> 24)) {
-							back = RENDERER_LINE[Layer_BG0][x];
+						if((mask & LayerMask_BG0) && (top != SpecialEffectTarget_BG0) && RENDERER_LINE[Layer_BG0].prio[x] < GFX_PRIO_BACKDROP) {
+							back = RENDERER_LINE[Layer_BG0].color[x];
+							backPrio = RENDERER_LINE[Layer_BG0].prio[x];
 							top2 = SpecialEffectTarget_BG0;
 						}
 
-						if((mask & LayerMask_BG1) && (top != SpecialEffectTarget_BG1) && (uint8_t)(RENDERER_LINE[Layer_BG1][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_BG1][x];
+						if((mask & LayerMask_BG1) && (top != SpecialEffectTarget_BG1) && RENDERER_LINE[Layer_BG1].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_BG1].color[x];
+							backPrio = RENDERER_LINE[Layer_BG1].prio[x];
 							top2 = SpecialEffectTarget_BG1;
 						}
 
-						if((mask & LayerMask_BG2) && (top != SpecialEffectTarget_BG2) && (uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_BG2][x];
+						if((mask & LayerMask_BG2) && (top != SpecialEffectTarget_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_BG2].color[x];
+							backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 							top2 = SpecialEffectTarget_BG2;
 						}
 
-						if((mask & LayerMask_OBJ) && (top != SpecialEffectTarget_OBJ) && (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_OBJ][x];
+						if((mask & LayerMask_OBJ) && (top != SpecialEffectTarget_OBJ) && RENDERER_LINE[Layer_OBJ].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_OBJ].color[x];
+							backPrio = RENDERER_LINE[Layer_OBJ].prio[x];
 							top2 = SpecialEffectTarget_OBJ;
 						}
 
-						if(RENDERER_R_BLDCNT_IsTarget2(top2) && color < 0x80000000)
+						if(RENDERER_R_BLDCNT_IsTarget2(top2) && prio < GFX_PRIO_TRANSPARENT)
 						{
-							GFX_ALPHA_BLEND(color, back, coeff[COLEV & 0x1F], coeff[(COLEV >> 8) & 0x1F]);
+							GFX_ALPHA_BLEND(color, back, RENDERER_BLEND);
 						}
 					}
 					break;
 				case SpecialEffect_Brightness_Increase:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxIncreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxIncreaseBrightness(color, RENDERER_BLEND);
 					break;
 				case SpecialEffect_Brightness_Decrease:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxDecreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxDecreaseBrightness(color, RENDERER_BLEND);
 					break;
 			}
 		}
 
-		lineMix[x] = CONVERT_COLOR(color);
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
 	}
 
-#if !THREADED_RENDERER
-	RENDERER_BG2C = 0;
-#endif
 }
 
 /*
@@ -10287,33 +11185,23 @@ static void mode2RenderLine (void)
 	fprintf(stderr, "MODE 2: Render Line\n");
 #endif
 	uint16_t* lineMix;
-	if (draw_right_screen == 0){
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
 		lineMix = GET_LINE_MIX_L;
 	} else {
 		lineMix = GET_LINE_MIX_R;	
 	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
 
 	uint32_t backdrop = RENDERER_BACKDROP;
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		gfxDrawRotScreen<Layer_BG2, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG2CNT], RENDERER_BG2X_L, RENDERER_BG2X_H, RENDERER_BG2Y_L, RENDERER_BG2Y_H,
-				RENDERER_IO_REGISTERS[REG_BG2PA], RENDERER_IO_REGISTERS[REG_BG2PB], RENDERER_IO_REGISTERS[REG_BG2PC], RENDERER_IO_REGISTERS[REG_BG2PD],
-				RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C);
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG3) {
-		gfxDrawRotScreen<Layer_BG3, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG3CNT], RENDERER_BG3X_L, RENDERER_BG3X_H, RENDERER_BG3Y_L, RENDERER_BG3Y_H,
-				RENDERER_IO_REGISTERS[REG_BG3PA], RENDERER_IO_REGISTERS[REG_BG3PB], RENDERER_IO_REGISTERS[REG_BG3PC], RENDERER_IO_REGISTERS[REG_BG3PD],
-				RENDERER_BG3X, RENDERER_BG3Y, RENDERER_BG3C);
-	}
-
 	for(int x = 0; x < 240; ++x) {
 		uint32_t color = backdrop;
+		uint8_t prio = GFX_PRIO_BACKDROP;
 		uint8_t top = SpecialEffectTarget_BD;
 
-		uint8_t li2 = (uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24);
-		uint8_t li3 = (uint8_t)(RENDERER_LINE[Layer_BG3][x]>>24);
-		uint8_t li4 = (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24);	
+		uint8_t li2 = RENDERER_LINE[Layer_BG2].prio[x];
+		uint8_t li3 = RENDERER_LINE[Layer_BG3].prio[x];
+		uint8_t li4 = RENDERER_LINE[Layer_OBJ].prio[x];	
 
 		uint8_t r = 	(li3 < li2) ? (li3) : (li2);
 
@@ -10321,32 +11209,38 @@ static void mode2RenderLine (void)
 			r = 	(li4);
 		}
 
-		if(r < (uint8_t)(color >> 24)) {
+		if(r < prio) {
 			if(r == li2){
-				color = RENDERER_LINE[Layer_BG2][x];
+				color = RENDERER_LINE[Layer_BG2].color[x];
+				prio = RENDERER_LINE[Layer_BG2].prio[x];
 				top = SpecialEffectTarget_BG2;
 			}else if(r == li3){
-				color = RENDERER_LINE[Layer_BG3][x];
+				color = RENDERER_LINE[Layer_BG3].color[x];
+				prio = RENDERER_LINE[Layer_BG3].prio[x];
 				top = SpecialEffectTarget_BG3;
 			}else if(r == li4){
-				color = RENDERER_LINE[Layer_OBJ][x];
+				color = RENDERER_LINE[Layer_OBJ].color[x];
+				prio = RENDERER_LINE[Layer_OBJ].prio[x];
 				top = SpecialEffectTarget_OBJ;
 
-				if(color & 0x00010000) {
+				if(prio & GFX_PRIO_SEMI) {
 					// semi-transparent OBJ
 					uint32_t back = backdrop;
+					uint8_t backPrio = GFX_PRIO_BACKDROP;
 					uint8_t top2 = SpecialEffectTarget_BD;
 
-					uint8_t li2 = (uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24);
-					uint8_t li3 = (uint8_t)(RENDERER_LINE[Layer_BG3][x]>>24);
+					uint8_t li2 = RENDERER_LINE[Layer_BG2].prio[x];
+					uint8_t li3 = RENDERER_LINE[Layer_BG3].prio[x];
 					uint8_t r = 	(li3 < li2) ? (li3) : (li2);
 
-					if(r < (uint8_t)(back >> 24)) {
+					if(r < backPrio) {
 						if(r == li2){
-							back = RENDERER_LINE[Layer_BG2][x];
+							back = RENDERER_LINE[Layer_BG2].color[x];
+							backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 							top2 = SpecialEffectTarget_BG2;
 						}else if(r == li3){
-							back = RENDERER_LINE[Layer_BG3][x];
+							back = RENDERER_LINE[Layer_BG3].color[x];
+							backPrio = RENDERER_LINE[Layer_BG3].prio[x];
 							top2 = SpecialEffectTarget_BG3;
 						}
 					}
@@ -10357,13 +11251,11 @@ static void mode2RenderLine (void)
 		}
 
 
-		lineMix[x] = CONVERT_COLOR(color);
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
 	}
 
-#if !THREADED_RENDERER
-	RENDERER_BG2C = 0;
-	RENDERER_BG3C = 0;
-#endif
 }
 
 template<int renderer_idx>
@@ -10378,33 +11270,23 @@ static void mode2RenderLineNoWindow (void)
 	fprintf(stderr, "MODE 2: Render Line No Window\n");
 #endif
 	uint16_t* lineMix;
-	if (draw_right_screen == 0){
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
 		lineMix = GET_LINE_MIX_L;
 	} else {
 		lineMix = GET_LINE_MIX_R;	
 	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
 
 	uint32_t backdrop = RENDERER_BACKDROP;
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		gfxDrawRotScreen<Layer_BG2, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG2CNT], RENDERER_BG2X_L, RENDERER_BG2X_H, RENDERER_BG2Y_L, RENDERER_BG2Y_H,
-				RENDERER_IO_REGISTERS[REG_BG2PA], RENDERER_IO_REGISTERS[REG_BG2PB], RENDERER_IO_REGISTERS[REG_BG2PC], RENDERER_IO_REGISTERS[REG_BG2PD],
-				RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C);
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG3) {
-		gfxDrawRotScreen<Layer_BG3, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG3CNT], RENDERER_BG3X_L, RENDERER_BG3X_H, RENDERER_BG3Y_L, RENDERER_BG3Y_H,
-				RENDERER_IO_REGISTERS[REG_BG3PA], RENDERER_IO_REGISTERS[REG_BG3PB], RENDERER_IO_REGISTERS[REG_BG3PC], RENDERER_IO_REGISTERS[REG_BG3PD],
-				RENDERER_BG3X, RENDERER_BG3Y, RENDERER_BG3C);
-	}
-
 	for(int x = 0; x < 240; ++x) {
 		uint32_t color = backdrop;
+		uint8_t prio = GFX_PRIO_BACKDROP;
 		uint8_t top = SpecialEffectTarget_BD;
 
-		uint8_t li2 = (uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24);
-		uint8_t li3 = (uint8_t)(RENDERER_LINE[Layer_BG3][x]>>24);
-		uint8_t li4 = (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24);	
+		uint8_t li2 = RENDERER_LINE[Layer_BG2].prio[x];
+		uint8_t li3 = RENDERER_LINE[Layer_BG3].prio[x];
+		uint8_t li4 = RENDERER_LINE[Layer_OBJ].prio[x];	
 
 		uint8_t r = 	(li3 < li2) ? (li3) : (li2);
 
@@ -10412,20 +11294,23 @@ static void mode2RenderLineNoWindow (void)
 			r = 	(li4);
 		}
 
-		if(r < (uint8_t)(color >> 24)) {
+		if(r < prio) {
 			if(r == li2){
-				color = RENDERER_LINE[Layer_BG2][x];
+				color = RENDERER_LINE[Layer_BG2].color[x];
+				prio = RENDERER_LINE[Layer_BG2].prio[x];
 				top = SpecialEffectTarget_BG2;
 			}else if(r == li3){
-				color = RENDERER_LINE[Layer_BG3][x];
+				color = RENDERER_LINE[Layer_BG3].color[x];
+				prio = RENDERER_LINE[Layer_BG3].prio[x];
 				top = SpecialEffectTarget_BG3;
 			}else if(r == li4){
-				color = RENDERER_LINE[Layer_OBJ][x];
+				color = RENDERER_LINE[Layer_OBJ].color[x];
+				prio = RENDERER_LINE[Layer_OBJ].prio[x];
 				top = SpecialEffectTarget_OBJ;
 			}
 		}
 
-		if(!(color & 0x00010000)) {
+		if(!(prio & GFX_PRIO_SEMI)) {
 			switch(RENDERER_R_BLDCNT_Color_Special_Effect)
 			{
 				case SpecialEffect_None:
@@ -10434,53 +11319,60 @@ static void mode2RenderLineNoWindow (void)
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
 					{
 						uint32_t back = backdrop;
+						uint8_t backPrio = GFX_PRIO_BACKDROP;
 						uint8_t top2 = SpecialEffectTarget_BD;
 
-						if((top != SpecialEffectTarget_BG2) && (uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_BG2][x];
+						if((top != SpecialEffectTarget_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_BG2].color[x];
+							backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 							top2 = SpecialEffectTarget_BG2;
 						}
 
-						if((top != SpecialEffectTarget_BG3) && (uint8_t)(RENDERER_LINE[Layer_BG3][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_BG3][x];
+						if((top != SpecialEffectTarget_BG3) && RENDERER_LINE[Layer_BG3].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_BG3].color[x];
+							backPrio = RENDERER_LINE[Layer_BG3].prio[x];
 							top2 = SpecialEffectTarget_BG3;
 						}
 
-						if((top != SpecialEffectTarget_OBJ) && (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_OBJ][x];
+						if((top != SpecialEffectTarget_OBJ) && RENDERER_LINE[Layer_OBJ].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_OBJ].color[x];
+							backPrio = RENDERER_LINE[Layer_OBJ].prio[x];
 							top2 = SpecialEffectTarget_OBJ;
 						}
 
-						if(RENDERER_R_BLDCNT_IsTarget2(top2) && color < 0x80000000)
+						if(RENDERER_R_BLDCNT_IsTarget2(top2) && prio < GFX_PRIO_TRANSPARENT)
 						{
-							GFX_ALPHA_BLEND(color, back, coeff[COLEV & 0x1F], coeff[(COLEV >> 8) & 0x1F]);
+							GFX_ALPHA_BLEND(color, back, RENDERER_BLEND);
 						}
 					}
 					break;
 				case SpecialEffect_Brightness_Increase:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxIncreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxIncreaseBrightness(color, RENDERER_BLEND);
 					break;
 				case SpecialEffect_Brightness_Decrease:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxDecreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxDecreaseBrightness(color, RENDERER_BLEND);
 					break;
 			}
 		} else {
 			// semi-transparent OBJ
 			uint32_t back = backdrop;
+			uint8_t backPrio = GFX_PRIO_BACKDROP;
 			uint8_t top2 = SpecialEffectTarget_BD;
 
-			uint8_t li2 = (uint8_t)(RENDERER_LINE[Layer_BG2][x]>>24);
-			uint8_t li3 = (uint8_t)(RENDERER_LINE[Layer_BG3][x]>>24);
+			uint8_t li2 = RENDERER_LINE[Layer_BG2].prio[x];
+			uint8_t li3 = RENDERER_LINE[Layer_BG3].prio[x];
 			uint8_t r = 	(li3 < li2) ? (li3) : (li2);
 
-			if(r < (uint8_t)(back >> 24)) {
+			if(r < backPrio) {
 				if(r == li2){
-					back = RENDERER_LINE[Layer_BG2][x];
+					back = RENDERER_LINE[Layer_BG2].color[x];
+					backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 					top2 = SpecialEffectTarget_BG2;
 				}else if(r == li3){
-					back = RENDERER_LINE[Layer_BG3][x];
+					back = RENDERER_LINE[Layer_BG3].color[x];
+					backPrio = RENDERER_LINE[Layer_BG3].prio[x];
 					top2 = SpecialEffectTarget_BG3;
 				}
 			}
@@ -10488,13 +11380,11 @@ static void mode2RenderLineNoWindow (void)
 			alpha_blend_brightness_switch();
 		}
 
-		lineMix[x] = CONVERT_COLOR(color);
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
 	}
 
-#if !THREADED_RENDERER
-	RENDERER_BG2C = 0;
-	RENDERER_BG3C = 0;
-#endif
 }
 
 template<int renderer_idx>
@@ -10509,11 +11399,12 @@ static void mode2RenderLineAll (void)
 	fprintf(stderr, "MODE 2: Render Line All\n");
 #endif
 	uint16_t* lineMix;
-	if (draw_right_screen == 0){
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
 		lineMix = GET_LINE_MIX_L;
 	} else {
 		lineMix = GET_LINE_MIX_R;	
 	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
 
 	uint32_t backdrop = RENDERER_BACKDROP;
 
@@ -10533,61 +11424,48 @@ static void mode2RenderLineAll (void)
 		inWindow1 = (uint8_t)(RENDERER_R_VCOUNT - v0) < (uint8_t)(v1 - v0) || ((v0 == v1) && (v0 >= 0xe8));
 	}
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		gfxDrawRotScreen<Layer_BG2, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG2CNT], RENDERER_BG2X_L, RENDERER_BG2X_H, RENDERER_BG2Y_L, RENDERER_BG2Y_H,
-				RENDERER_IO_REGISTERS[REG_BG2PA], RENDERER_IO_REGISTERS[REG_BG2PB], RENDERER_IO_REGISTERS[REG_BG2PC], RENDERER_IO_REGISTERS[REG_BG2PD],
-				RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C);
-	}
-
-	if(RENDERER_R_DISPCNT_Screen_Display_BG3) {
-		gfxDrawRotScreen<Layer_BG3, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG3CNT], RENDERER_BG3X_L, RENDERER_BG3X_H, RENDERER_BG3Y_L, RENDERER_BG3Y_H,
-				RENDERER_IO_REGISTERS[REG_BG3PA], RENDERER_IO_REGISTERS[REG_BG3PB], RENDERER_IO_REGISTERS[REG_BG3PC], RENDERER_IO_REGISTERS[REG_BG3PD],
-				RENDERER_BG3X, RENDERER_BG3Y, RENDERER_BG3C);
-	}
-
-	uint8_t inWin0Mask = RENDERER_R_WIN_Window0_Mask;
-	uint8_t inWin1Mask = RENDERER_R_WIN_Window1_Mask;
-	uint8_t outMask = RENDERER_R_WIN_Outside_Mask;
+	uint8_t windowMask[240];
+	gfxWindowLineMasks<renderer_idx>(windowMask, inWindow0, inWindow1);
 
 	for(int x = 0; x < 240; x++) {
 		uint32_t color = backdrop;
+		uint8_t prio = GFX_PRIO_BACKDROP;
 		uint8_t top = SpecialEffectTarget_BD;
-		uint8_t mask = outMask;
-
-		if(!(RENDERER_LINE[Layer_WIN_OBJ][x] & 0x80000000)) {
-			mask = RENDERER_R_WIN_OBJ_Mask;
-		}
+		uint8_t mask = windowMask[x];
 
-		mask = SELECT(inWindow1 && RENDERER_GFX_IN_WIN[1][x], inWin1Mask, mask);
-		mask = SELECT(inWindow0 && RENDERER_GFX_IN_WIN[0][x], inWin0Mask, mask);
-
-		if((mask & LayerMask_BG2) && RENDERER_LINE[Layer_BG2][x] < color) {
-			color = RENDERER_LINE[Layer_BG2][x];
+		if((mask & LayerMask_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_BG2].color[x];
+			prio = RENDERER_LINE[Layer_BG2].prio[x];
 			top = SpecialEffectTarget_BG2;
 		}
 
-		if((mask & LayerMask_BG3) && (uint8_t)(RENDERER_LINE[Layer_BG3][x]>>24) < (uint8_t)(color >> 24)) {
-			color = RENDERER_LINE[Layer_BG3][x];
+		if((mask & LayerMask_BG3) && RENDERER_LINE[Layer_BG3].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_BG3].color[x];
+			prio = RENDERER_LINE[Layer_BG3].prio[x];
 			top = SpecialEffectTarget_BG3;
 		}
 
-		if((mask & LayerMask_OBJ) && (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(color >> 24)) {
-			color = RENDERER_LINE[Layer_OBJ][x];
+		if((mask & LayerMask_OBJ) && RENDERER_LINE[Layer_OBJ].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_OBJ].color[x];
+			prio = RENDERER_LINE[Layer_OBJ].prio[x];
 			top = SpecialEffectTarget_OBJ;
 		}
 
-		if(color & 0x00010000) {
+		if(prio & GFX_PRIO_SEMI) {
 			// semi-transparent OBJ
 			uint32_t back = backdrop;
+			uint8_t backPrio = GFX_PRIO_BACKDROP;
 			uint8_t top2 = SpecialEffectTarget_BD;
 
-			if((mask & LayerMask_BG2) && RENDERER_LINE[Layer_BG2][x] < back) {
-				back = RENDERER_LINE[Layer_BG2][x];
+			if((mask & LayerMask_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < backPrio) {
+				back = RENDERER_LINE[Layer_BG2].color[x];
+				backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 				top2 = SpecialEffectTarget_BG2;
 			}
 
-			if((mask & LayerMask_BG3) && (uint8_t)(RENDERER_LINE[Layer_BG3][x]>>24) < (uint8_t)(back >> 24)) {
-				back = RENDERER_LINE[Layer_BG3][x];
+			if((mask & LayerMask_BG3) && RENDERER_LINE[Layer_BG3].prio[x] < backPrio) {
+				back = RENDERER_LINE[Layer_BG3].color[x];
+				backPrio = RENDERER_LINE[Layer_BG3].prio[x];
 				top2 = SpecialEffectTarget_BG3;
 			}
 
@@ -10602,47 +11480,49 @@ static void mode2RenderLineAll (void)
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
 					{
 						uint32_t back = backdrop;
+						uint8_t backPrio = GFX_PRIO_BACKDROP;
 						uint8_t top2 = SpecialEffectTarget_BD;
 
-						if((mask & LayerMask_BG2) && (top != SpecialEffectTarget_BG2) && RENDERER_LINE[Layer_BG2][x] < back) {
-							back = RENDERER_LINE[Layer_BG2][x];
+						if((mask & LayerMask_BG2) && (top != SpecialEffectTarget_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_BG2].color[x];
+							backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 							top2 = SpecialEffectTarget_BG2;
 						}
 
-						if((mask & LayerMask_BG3) && (top != SpecialEffectTarget_BG3) && (uint8_t)(RENDERER_LINE[Layer_BG3][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_BG3][x];
+						if((mask & LayerMask_BG3) && (top != SpecialEffectTarget_BG3) && RENDERER_LINE[Layer_BG3].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_BG3].color[x];
+							backPrio = RENDERER_LINE[Layer_BG3].prio[x];
 							top2 = SpecialEffectTarget_BG3;
 						}
 
-						if((mask & LayerMask_OBJ) && (top != SpecialEffectTarget_OBJ) && (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_OBJ][x];
+						if((mask & LayerMask_OBJ) && (top != SpecialEffectTarget_OBJ) && RENDERER_LINE[Layer_OBJ].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_OBJ].color[x];
+							backPrio = RENDERER_LINE[Layer_OBJ].prio[x];
 							top2 = SpecialEffectTarget_OBJ;
 						}
 
-						if(RENDERER_R_BLDCNT_IsTarget2(top2) && color < 0x80000000)
+						if(RENDERER_R_BLDCNT_IsTarget2(top2) && prio < GFX_PRIO_TRANSPARENT)
 						{
-							GFX_ALPHA_BLEND(color, back, coeff[COLEV & 0x1F], coeff[(COLEV >> 8) & 0x1F]);
+							GFX_ALPHA_BLEND(color, back, RENDERER_BLEND);
 						}
 					}
 					break;
 				case SpecialEffect_Brightness_Increase:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxIncreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxIncreaseBrightness(color, RENDERER_BLEND);
 					break;
 				case SpecialEffect_Brightness_Decrease:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxDecreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxDecreaseBrightness(color, RENDERER_BLEND);
 					break;
 			}
 		}
 
-		lineMix[x] = CONVERT_COLOR(color);
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
 	}
 
-#if !THREADED_RENDERER
-	RENDERER_BG2C = 0;
-	RENDERER_BG3C = 0;
-#endif
 }
 
 /*
@@ -10665,37 +11545,37 @@ static void mode3RenderLine (void)
 	fprintf(stderr, "MODE 3: Render Line\n");
 #endif
 	uint16_t* lineMix;
-	if (draw_right_screen == 0){
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
 		lineMix = GET_LINE_MIX_L;
 	} else {
 		lineMix = GET_LINE_MIX_R;	
 	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
 	uint32_t background = RENDERER_BACKDROP;
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		gfxDrawRotScreen16Bit<renderer_idx>(RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C);
-	}
-
 	for(int x = 0; x < 240; ++x) {
 		uint32_t color = background;
+		uint8_t prio = GFX_PRIO_BACKDROP;
 		uint8_t top = SpecialEffectTarget_BD;
 
-		if(RENDERER_LINE[Layer_BG2][x] < color) {
-			color = RENDERER_LINE[Layer_BG2][x];
+		if(RENDERER_LINE[Layer_BG2].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_BG2].color[x];
+			prio = RENDERER_LINE[Layer_BG2].prio[x];
 			top = SpecialEffectTarget_BG2;
 		}
 
-		if((uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(color >>24)) {
-			color = RENDERER_LINE[Layer_OBJ][x];
+		if(RENDERER_LINE[Layer_OBJ].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_OBJ].color[x];
+			prio = RENDERER_LINE[Layer_OBJ].prio[x];
 			top = SpecialEffectTarget_OBJ;
 
-			if(color & 0x00010000) {
+			if(prio & GFX_PRIO_SEMI) {
 				// semi-transparent OBJ
 				uint32_t back = background;
 				uint8_t top2 = SpecialEffectTarget_BD;
 
-				if(RENDERER_LINE[Layer_BG2][x] < background) {
-					back = RENDERER_LINE[Layer_BG2][x];
+				if(RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP) {
+					back = RENDERER_LINE[Layer_BG2].color[x];
 					top2 = SpecialEffectTarget_BG2;
 				}
 
@@ -10704,12 +11584,11 @@ static void mode3RenderLine (void)
 		}
 
 
-		lineMix[x] = CONVERT_COLOR(color);
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
 	}
 
-#if !THREADED_RENDERER
-	RENDERER_BG2C = 0;
-#endif
 }
 
 template<int renderer_idx>
@@ -10724,32 +11603,32 @@ INIT_RENDERER_CONTEXT(renderer_idx);
 	fprintf(stderr, "MODE 3: Render Line No Window\n");
 #endif
 	uint16_t* lineMix;
-	if (draw_right_screen == 0){
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
 		lineMix = GET_LINE_MIX_L;
 	} else {
 		lineMix = GET_LINE_MIX_R;	
 	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
 	uint32_t background = RENDERER_BACKDROP;
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		gfxDrawRotScreen16Bit<renderer_idx>(RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C);
-	}
-
 	for(int x = 0; x < 240; ++x) {
 		uint32_t color = background;
+		uint8_t prio = GFX_PRIO_BACKDROP;
 		uint8_t top = SpecialEffectTarget_BD;
 
-		if(RENDERER_LINE[Layer_BG2][x] < background) {
-			color = RENDERER_LINE[Layer_BG2][x];
+		if(RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP) {
+			color = RENDERER_LINE[Layer_BG2].color[x];
+			prio = RENDERER_LINE[Layer_BG2].prio[x];
 			top = SpecialEffectTarget_BG2;
 		}
 
-		if((uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(color >>24)) {
-			color = RENDERER_LINE[Layer_OBJ][x];
+		if(RENDERER_LINE[Layer_OBJ].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_OBJ].color[x];
+			prio = RENDERER_LINE[Layer_OBJ].prio[x];
 			top = SpecialEffectTarget_OBJ;
 		}
 
-		if(!(color & 0x00010000)) {
+		if(!(prio & GFX_PRIO_SEMI)) {
 			switch(RENDERER_R_BLDCNT_Color_Special_Effect)
 			{
 				case SpecialEffect_None:
@@ -10758,32 +11637,35 @@ INIT_RENDERER_CONTEXT(renderer_idx);
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
 					{
 						uint32_t back = background;
+						uint8_t backPrio = GFX_PRIO_BACKDROP;
 						uint8_t top2 = SpecialEffectTarget_BD;
 
-						if(top != SpecialEffectTarget_BG2 && (RENDERER_LINE[Layer_BG2][x] < background) ) {
-							back = RENDERER_LINE[Layer_BG2][x];
+						if(top != SpecialEffectTarget_BG2 && (RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP) ) {
+							back = RENDERER_LINE[Layer_BG2].color[x];
+							backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 							top2 = SpecialEffectTarget_BG2;
 						}
 
-						if(top != SpecialEffectTarget_OBJ && ((uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(back >> 24))) {
-							back = RENDERER_LINE[Layer_OBJ][x];
+						if(top != SpecialEffectTarget_OBJ && (RENDERER_LINE[Layer_OBJ].prio[x] < backPrio)) {
+							back = RENDERER_LINE[Layer_OBJ].color[x];
+							backPrio = RENDERER_LINE[Layer_OBJ].prio[x];
 							top2 = SpecialEffectTarget_OBJ;
 						}
 
-						if(RENDERER_R_BLDCNT_IsTarget2(top2) && color < 0x80000000)
+						if(RENDERER_R_BLDCNT_IsTarget2(top2) && prio < GFX_PRIO_TRANSPARENT)
 						{
-							GFX_ALPHA_BLEND(color, back, coeff[COLEV & 0x1F], coeff[(COLEV >> 8) & 0x1F]);
+							GFX_ALPHA_BLEND(color, back, RENDERER_BLEND);
 						}
 
 					}
 					break;
 				case SpecialEffect_Brightness_Increase:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxIncreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxIncreaseBrightness(color, RENDERER_BLEND);
 					break;
 				case SpecialEffect_Brightness_Decrease:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxDecreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxDecreaseBrightness(color, RENDERER_BLEND);
 					break;
 			}
 		} else {
@@ -10791,20 +11673,19 @@ INIT_RENDERER_CONTEXT(renderer_idx);
 			uint32_t back = background;
 			uint8_t top2 = SpecialEffectTarget_BD;
 
-			if(RENDERER_LINE[Layer_BG2][x] < background) {
-				back = RENDERER_LINE[Layer_BG2][x];
+			if(RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP) {
+				back = RENDERER_LINE[Layer_BG2].color[x];
 				top2 = SpecialEffectTarget_BG2;
 			}
 
 			alpha_blend_brightness_switch();
 		}
 
-		lineMix[x] = CONVERT_COLOR(color);
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
 	}
 
-#if !THREADED_RENDERER
-	RENDERER_BG2C = 0;
-#endif
 }
 
 template<int renderer_idx>
@@ -10819,11 +11700,12 @@ static void mode3RenderLineAll (void)
 	fprintf(stderr, "MODE 3: Render Line All\n");
 #endif
 	uint16_t* lineMix;
-	if (draw_right_screen == 0){
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
 		lineMix = GET_LINE_MIX_L;
 	} else {
 		lineMix = GET_LINE_MIX_R;	
 	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
 	uint32_t background = RENDERER_BACKDROP;
 
 	bool inWindow0 = false;
@@ -10843,43 +11725,34 @@ static void mode3RenderLineAll (void)
 		inWindow1 = (uint8_t)(RENDERER_R_VCOUNT - v0) < (uint8_t)(v1 - v0) || ((v0 == v1) && (v0 >= 0xe8));
 	}
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		gfxDrawRotScreen16Bit<renderer_idx>(RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C);
-	}
-
-	uint8_t inWin0Mask = RENDERER_R_WIN_Window0_Mask;
-	uint8_t inWin1Mask = RENDERER_R_WIN_Window1_Mask;
-	uint8_t outMask = RENDERER_R_WIN_Outside_Mask;
+	uint8_t windowMask[240];
+	gfxWindowLineMasks<renderer_idx>(windowMask, inWindow0, inWindow1);
 
 	for(int x = 0; x < 240; ++x) {
 		uint32_t color = background;
+		uint8_t prio = GFX_PRIO_BACKDROP;
 		uint8_t top = SpecialEffectTarget_BD;
-		uint8_t mask = outMask;
-
-		if(!(RENDERER_LINE[Layer_WIN_OBJ][x] & 0x80000000)) {
-			mask = RENDERER_R_WIN_OBJ_Mask;
-		}
-
-		mask = SELECT(inWindow1 && RENDERER_GFX_IN_WIN[1][x], inWin1Mask, mask);
-		mask = SELECT(inWindow0 && RENDERER_GFX_IN_WIN[0][x], inWin0Mask, mask);
+		uint8_t mask = windowMask[x];
 
-		if((mask & LayerMask_BG2) && RENDERER_LINE[Layer_BG2][x] < background) {
-			color = RENDERER_LINE[Layer_BG2][x];
+		if((mask & LayerMask_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP) {
+			color = RENDERER_LINE[Layer_BG2].color[x];
+			prio = RENDERER_LINE[Layer_BG2].prio[x];
 			top = SpecialEffectTarget_BG2;
 		}
 
-		if((mask & LayerMask_OBJ) && ((uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(color >>24))) {
-			color = RENDERER_LINE[Layer_OBJ][x];
+		if((mask & LayerMask_OBJ) && (RENDERER_LINE[Layer_OBJ].prio[x] < prio)) {
+			color = RENDERER_LINE[Layer_OBJ].color[x];
+			prio = RENDERER_LINE[Layer_OBJ].prio[x];
 			top = SpecialEffectTarget_OBJ;
 		}
 
-		if(color & 0x00010000) {
+		if(prio & GFX_PRIO_SEMI) {
 			// semi-transparent OBJ
 			uint32_t back = background;
 			uint8_t top2 = SpecialEffectTarget_BD;
 
-			if((mask & LayerMask_BG2) && RENDERER_LINE[Layer_BG2][x] < background) {
-				back = RENDERER_LINE[Layer_BG2][x];
+			if((mask & LayerMask_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP) {
+				back = RENDERER_LINE[Layer_BG2].color[x];
 				top2 = SpecialEffectTarget_BG2;
 			}
 
@@ -10893,41 +11766,43 @@ static void mode3RenderLineAll (void)
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
 					{
 						uint32_t back = background;
+						uint8_t backPrio = GFX_PRIO_BACKDROP;
 						uint8_t top2 = SpecialEffectTarget_BD;
 
-						if((mask & LayerMask_BG2) && (top != SpecialEffectTarget_BG2) && RENDERER_LINE[Layer_BG2][x] < back) {
-							back = RENDERER_LINE[Layer_BG2][x];
+						if((mask & LayerMask_BG2) && (top != SpecialEffectTarget_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_BG2].color[x];
+							backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 							top2 = SpecialEffectTarget_BG2;
 						}
 
-						if((mask & LayerMask_OBJ) && (top != SpecialEffectTarget_OBJ) && (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_OBJ][x];
+						if((mask & LayerMask_OBJ) && (top != SpecialEffectTarget_OBJ) && RENDERER_LINE[Layer_OBJ].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_OBJ].color[x];
+							backPrio = RENDERER_LINE[Layer_OBJ].prio[x];
 							top2 = SpecialEffectTarget_OBJ;
 						}
 
-						if(RENDERER_R_BLDCNT_IsTarget2(top2) && color < 0x80000000)
+						if(RENDERER_R_BLDCNT_IsTarget2(top2) && prio < GFX_PRIO_TRANSPARENT)
 						{
-							GFX_ALPHA_BLEND(color, back, coeff[COLEV & 0x1F], coeff[(COLEV >> 8) & 0x1F]);
+							GFX_ALPHA_BLEND(color, back, RENDERER_BLEND);
 						}
 					}
 					break;
 				case SpecialEffect_Brightness_Increase:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxIncreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxIncreaseBrightness(color, RENDERER_BLEND);
 					break;
 				case SpecialEffect_Brightness_Decrease:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxDecreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxDecreaseBrightness(color, RENDERER_BLEND);
 					break;
 			}
 		}
 
-		lineMix[x] = CONVERT_COLOR(color);
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
 	}
 
-#if !THREADED_RENDERER
-	RENDERER_BG2C = 0;
-#endif
 }
 
 /*
@@ -10950,38 +11825,38 @@ static void mode4RenderLine (void)
 	fprintf(stderr, "MODE 4: Render Line\n");
 #endif
 	uint16_t* lineMix;
-	if (draw_right_screen == 0){
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
 		lineMix = GET_LINE_MIX_L;
 	} else {
 		lineMix = GET_LINE_MIX_R;	
 	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
 	uint32_t backdrop = RENDERER_BACKDROP;
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		gfxDrawRotScreen256<renderer_idx>(RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C);
-	}
-
 	for(int x = 0; x < 240; ++x)
 	{
 		uint32_t color = backdrop;
+		uint8_t prio = GFX_PRIO_BACKDROP;
 		uint8_t top = SpecialEffectTarget_BD;
 
-		if(RENDERER_LINE[Layer_BG2][x] < backdrop) {
-			color = RENDERER_LINE[Layer_BG2][x];
+		if(RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP) {
+			color = RENDERER_LINE[Layer_BG2].color[x];
+			prio = RENDERER_LINE[Layer_BG2].prio[x];
 			top = SpecialEffectTarget_BG2;
 		}
 
-		if((uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(color >> 24)) {
-			color = RENDERER_LINE[Layer_OBJ][x];
+		if(RENDERER_LINE[Layer_OBJ].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_OBJ].color[x];
+			prio = RENDERER_LINE[Layer_OBJ].prio[x];
 			top = SpecialEffectTarget_OBJ;
 
-			if(color & 0x00010000) {
+			if(prio & GFX_PRIO_SEMI) {
 				// semi-transparent OBJ
 				uint32_t back = backdrop;
 				uint8_t top2 = SpecialEffectTarget_BD;
 
-				if(RENDERER_LINE[Layer_BG2][x] < backdrop) {
-					back = RENDERER_LINE[Layer_BG2][x];
+				if(RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP) {
+					back = RENDERER_LINE[Layer_BG2].color[x];
 					top2 = SpecialEffectTarget_BG2;
 				}
 
@@ -10989,12 +11864,11 @@ static void mode4RenderLine (void)
 			}
 		}
 
-		lineMix[x] = CONVERT_COLOR(color);
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
 	}
 
-#if !THREADED_RENDERER
-	RENDERER_BG2C = 0;
-#endif
 }
 
 template<int renderer_idx>
@@ -11009,33 +11883,33 @@ static void mode4RenderLineNoWindow (void)
 	fprintf(stderr, "MODE 4: Render Line No Window\n");
 #endif
 	uint16_t* lineMix;
-	if (draw_right_screen == 0){
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
 		lineMix = GET_LINE_MIX_L;
 	} else {
 		lineMix = GET_LINE_MIX_R;	
 	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
 	uint32_t backdrop = RENDERER_BACKDROP;
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		gfxDrawRotScreen256<renderer_idx>(RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C);
-	}
-
 	for(int x = 0; x < 240; ++x)
 	{
 		uint32_t color = backdrop;
+		uint8_t prio = GFX_PRIO_BACKDROP;
 		uint8_t top = SpecialEffectTarget_BD;
 
-		if(RENDERER_LINE[Layer_BG2][x] < backdrop) {
-			color = RENDERER_LINE[Layer_BG2][x];
+		if(RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP) {
+			color = RENDERER_LINE[Layer_BG2].color[x];
+			prio = RENDERER_LINE[Layer_BG2].prio[x];
 			top = SpecialEffectTarget_BG2;
 		}
 
-		if((uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(color >> 24)) {
-			color = RENDERER_LINE[Layer_OBJ][x];
+		if(RENDERER_LINE[Layer_OBJ].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_OBJ].color[x];
+			prio = RENDERER_LINE[Layer_OBJ].prio[x];
 			top = SpecialEffectTarget_OBJ;
 		}
 
-		if(!(color & 0x00010000)) {
+		if(!(prio & GFX_PRIO_SEMI)) {
 			switch(RENDERER_R_BLDCNT_Color_Special_Effect)
 			{
 				case SpecialEffect_None:
@@ -11044,52 +11918,56 @@ static void mode4RenderLineNoWindow (void)
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
 					{
 						uint32_t back = backdrop;
+						uint8_t backPrio = GFX_PRIO_BACKDROP;
 						uint8_t top2 = SpecialEffectTarget_BD;
 
-						if((top != SpecialEffectTarget_BG2) && RENDERER_LINE[Layer_BG2][x] < backdrop) {
-							back = RENDERER_LINE[Layer_BG2][x];
+						if((top != SpecialEffectTarget_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP) {
+							back = RENDERER_LINE[Layer_BG2].color[x];
+							backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 							top2 = SpecialEffectTarget_BG2;
 						}
 
-						if((top != SpecialEffectTarget_OBJ) && (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_OBJ][x];
+						if((top != SpecialEffectTarget_OBJ) && RENDERER_LINE[Layer_OBJ].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_OBJ].color[x];
+							backPrio = RENDERER_LINE[Layer_OBJ].prio[x];
 							top2 = SpecialEffectTarget_OBJ;
 						}
 
-						if(RENDERER_R_BLDCNT_IsTarget2(top2) && color < 0x80000000)
+						if(RENDERER_R_BLDCNT_IsTarget2(top2) && prio < GFX_PRIO_TRANSPARENT)
 						{
-							GFX_ALPHA_BLEND(color, back, coeff[COLEV & 0x1F], coeff[(COLEV >> 8) & 0x1F]);
+							GFX_ALPHA_BLEND(color, back, RENDERER_BLEND);
 						}
 					}
 					break;
 				case SpecialEffect_Brightness_Increase:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxIncreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxIncreaseBrightness(color, RENDERER_BLEND);
 					break;
 				case SpecialEffect_Brightness_Decrease:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxDecreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxDecreaseBrightness(color, RENDERER_BLEND);
 					break;
 			}
 		} else {
 			// semi-transparent OBJ
 			uint32_t back = backdrop;
+			uint8_t backPrio = GFX_PRIO_BACKDROP;
 			uint8_t top2 = SpecialEffectTarget_BD;
 
-			if(RENDERER_LINE[Layer_BG2][x] < back) {
-				back = RENDERER_LINE[Layer_BG2][x];
+			if(RENDERER_LINE[Layer_BG2].prio[x] < backPrio) {
+				back = RENDERER_LINE[Layer_BG2].color[x];
+				backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 				top2 = SpecialEffectTarget_BG2;
 			}
 
 			alpha_blend_brightness_switch();
 		}
 
-		lineMix[x] = CONVERT_COLOR(color);
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
 	}
 
-#if !THREADED_RENDERER
-	RENDERER_BG2C = 0;
-#endif
 }
 
 template<int renderer_idx>
@@ -11104,11 +11982,13 @@ static void mode4RenderLineAll (void)
 	fprintf(stderr, "MODE 4: Render Line All\n");
 #endif
 	uint16_t* lineMix;
-	if (draw_right_screen == 0){
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
 		lineMix = GET_LINE_MIX_L;
 	} else {
 		lineMix = GET_LINE_MIX_R;	
-	}	uint32_t backdrop = RENDERER_BACKDROP;
+	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
+	uint32_t backdrop = RENDERER_BACKDROP;
 	
 	bool inWindow0 = false;
 	bool inWindow1 = false;
@@ -11127,44 +12007,38 @@ static void mode4RenderLineAll (void)
 		inWindow1 = (uint8_t)(RENDERER_R_VCOUNT - v0) < (uint8_t)(v1 - v0) || ((v0 == v1) && (v0 >= 0xe8));
 	}
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		gfxDrawRotScreen256<renderer_idx>(RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C);
-	}
-
-	uint8_t inWin0Mask = RENDERER_R_WIN_Window0_Mask;
-	uint8_t inWin1Mask = RENDERER_R_WIN_Window1_Mask;
-	uint8_t outMask = RENDERER_R_WIN_Outside_Mask;
+	uint8_t windowMask[240];
+	gfxWindowLineMasks<renderer_idx>(windowMask, inWindow0, inWindow1);
 
 	for(int x = 0; x < 240; ++x) {
 		uint32_t color = backdrop;
+		uint8_t prio = GFX_PRIO_BACKDROP;
 		uint8_t top = SpecialEffectTarget_BD;
-		uint8_t mask = outMask;
-
-		if(!(RENDERER_LINE[Layer_WIN_OBJ][x] & 0x80000000))
-			mask = RENDERER_R_WIN_OBJ_Mask;
-
-		mask = SELECT(inWindow1 && RENDERER_GFX_IN_WIN[1][x], inWin1Mask, mask);
-		mask = SELECT(inWindow0 && RENDERER_GFX_IN_WIN[0][x], inWin0Mask, mask);
+		uint8_t mask = windowMask[x];
 
-		if((mask & LayerMask_BG2) && (RENDERER_LINE[Layer_BG2][x] < backdrop))
+		if((mask & LayerMask_BG2) && (RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP))
 		{
-			color = RENDERER_LINE[Layer_BG2][x];
+			color = RENDERER_LINE[Layer_BG2].color[x];
+			prio = RENDERER_LINE[Layer_BG2].prio[x];
 			top = SpecialEffectTarget_BG2;
 		}
 
-		if((mask & LayerMask_OBJ) && ((uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(color >>24)))
+		if((mask & LayerMask_OBJ) && (RENDERER_LINE[Layer_OBJ].prio[x] < prio))
 		{
-			color = RENDERER_LINE[Layer_OBJ][x];
+			color = RENDERER_LINE[Layer_OBJ].color[x];
+			prio = RENDERER_LINE[Layer_OBJ].prio[x];
 			top = SpecialEffectTarget_OBJ;
 		}
 
-		if(color & 0x00010000) {
+		if(prio & GFX_PRIO_SEMI) {
 			// semi-transparent OBJ
 			uint32_t back = backdrop;
+			uint8_t backPrio = GFX_PRIO_BACKDROP;
 			uint8_t top2 = SpecialEffectTarget_BD;
 
-			if((mask & LayerMask_BG2) && RENDERER_LINE[Layer_BG2][x] < back) {
-				back = RENDERER_LINE[Layer_BG2][x];
+			if((mask & LayerMask_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < backPrio) {
+				back = RENDERER_LINE[Layer_BG2].color[x];
+				backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 				top2 = SpecialEffectTarget_BG2;
 			}
 
@@ -11178,41 +12052,43 @@ static void mode4RenderLineAll (void)
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
 					{
 						uint32_t back = backdrop;
+						uint8_t backPrio = GFX_PRIO_BACKDROP;
 						uint8_t top2 = SpecialEffectTarget_BD;
 
-						if((mask & LayerMask_BG2) && (top != SpecialEffectTarget_BG2) && (RENDERER_LINE[Layer_BG2][x] < backdrop)) {
-							back = RENDERER_LINE[Layer_BG2][x];
+						if((mask & LayerMask_BG2) && (top != SpecialEffectTarget_BG2) && (RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP)) {
+							back = RENDERER_LINE[Layer_BG2].color[x];
+							backPrio = RENDERER_LINE[Layer_BG2].prio[x];
 							top2 = SpecialEffectTarget_BG2;
 						}
 
-						if((mask & LayerMask_OBJ) && (top != SpecialEffectTarget_OBJ) && (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_OBJ][x];
+						if((mask & LayerMask_OBJ) && (top != SpecialEffectTarget_OBJ) && RENDERER_LINE[Layer_OBJ].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_OBJ].color[x];
+							backPrio = RENDERER_LINE[Layer_OBJ].prio[x];
 							top2 = SpecialEffectTarget_OBJ;
 						}
 
-						if(RENDERER_R_BLDCNT_IsTarget2(top2) && color < 0x80000000)
+						if(RENDERER_R_BLDCNT_IsTarget2(top2) && prio < GFX_PRIO_TRANSPARENT)
 						{
-							GFX_ALPHA_BLEND(color, back, coeff[COLEV & 0x1F], coeff[(COLEV >> 8) & 0x1F]);
+							GFX_ALPHA_BLEND(color, back, RENDERER_BLEND);
 						}
 					}
 					break;
 				case SpecialEffect_Brightness_Increase:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxIncreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxIncreaseBrightness(color, RENDERER_BLEND);
 					break;
 				case SpecialEffect_Brightness_Decrease:
 					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxDecreaseBrightness(color, coeff[COLY & 0x1F]);
+						color = gfxDecreaseBrightness(color, RENDERER_BLEND);
 					break;
 			}
 		}
 
-		lineMix[x] = CONVERT_COLOR(color);
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
 	}
 
-#if !THREADED_RENDERER
-	RENDERER_BG2C = 0;
-#endif
 }
 
 /*
@@ -11229,361 +12105,1540 @@ static void mode5RenderLine (void)
 {
 	INIT_RENDERER_CONTEXT(renderer_idx);
 
-#if !DEBUG_RENDERER_MODE5
-	return;
-#endif
-#ifdef REPORT_VIDEO_MODES
-	fprintf(stderr, "MODE 5: Render Line\n");
+#if !DEBUG_RENDERER_MODE5
+	return;
+#endif
+#ifdef REPORT_VIDEO_MODES
+	fprintf(stderr, "MODE 5: Render Line\n");
+#endif
+	uint16_t* lineMix;
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
+		lineMix = GET_LINE_MIX_L;
+	} else {
+		lineMix = GET_LINE_MIX_R;	
+	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
+	uint32_t background = RENDERER_BACKDROP;
+
+	for(int x = 0; x < 240; ++x) {
+		uint32_t color = background;
+		uint8_t prio = GFX_PRIO_BACKDROP;
+		uint8_t top = SpecialEffectTarget_BD;
+
+		if(RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP) {
+			color = RENDERER_LINE[Layer_BG2].color[x];
+			prio = RENDERER_LINE[Layer_BG2].prio[x];
+			top = SpecialEffectTarget_BG2;
+		}
+
+		if(RENDERER_LINE[Layer_OBJ].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_OBJ].color[x];
+			prio = RENDERER_LINE[Layer_OBJ].prio[x];
+			top = SpecialEffectTarget_OBJ;
+
+			if(prio & GFX_PRIO_SEMI) {
+				// semi-transparent OBJ
+				uint32_t back = background;
+				uint8_t backPrio = GFX_PRIO_BACKDROP;
+				uint8_t top2 = SpecialEffectTarget_BD;
+
+				if(RENDERER_LINE[Layer_BG2].prio[x] < backPrio) {
+					back = RENDERER_LINE[Layer_BG2].color[x];
+					backPrio = RENDERER_LINE[Layer_BG2].prio[x];
+					top2 = SpecialEffectTarget_BG2;
+				}
+
+				alpha_blend_brightness_switch();
+			}
+		}
+
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
+	}
+
+}
+
+template<int renderer_idx>
+static void mode5RenderLineNoWindow (void)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+#if !DEBUG_RENDERER_MODE5
+	return;
+#endif
+#ifdef REPORT_VIDEO_MODES
+	fprintf(stderr, "MODE 5: Render Line No Window\n");
+#endif
+	uint16_t* lineMix;
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
+		lineMix = GET_LINE_MIX_L;
+	} else {
+		lineMix = GET_LINE_MIX_R;	
+	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
+	uint32_t background = RENDERER_BACKDROP;
+
+	for(int x = 0; x < 240; ++x) {
+		uint32_t color = background;
+		uint8_t prio = GFX_PRIO_BACKDROP;
+		uint8_t top = SpecialEffectTarget_BD;
+
+		if(RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP) {
+			color = RENDERER_LINE[Layer_BG2].color[x];
+			prio = RENDERER_LINE[Layer_BG2].prio[x];
+			top = SpecialEffectTarget_BG2;
+		}
+
+		if(RENDERER_LINE[Layer_OBJ].prio[x] < prio) {
+			color = RENDERER_LINE[Layer_OBJ].color[x];
+			prio = RENDERER_LINE[Layer_OBJ].prio[x];
+			top = SpecialEffectTarget_OBJ;
+		}
+
+		if(!(prio & GFX_PRIO_SEMI)) {
+			switch(RENDERER_R_BLDCNT_Color_Special_Effect)
+			{
+				case SpecialEffect_None:
+					break;
+				case SpecialEffect_Alpha_Blending:
+					if(RENDERER_R_BLDCNT_IsTarget1(top))
+					{
+						uint32_t back = background;
+						uint8_t backPrio = GFX_PRIO_BACKDROP;
+						uint8_t top2 = SpecialEffectTarget_BD;
+
+						if((top != SpecialEffectTarget_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP) {
+							back = RENDERER_LINE[Layer_BG2].color[x];
+							backPrio = RENDERER_LINE[Layer_BG2].prio[x];
+							top2 = SpecialEffectTarget_BG2;
+						}
+
+						if((top != SpecialEffectTarget_OBJ) && RENDERER_LINE[Layer_OBJ].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_OBJ].color[x];
+							backPrio = RENDERER_LINE[Layer_OBJ].prio[x];
+							top2 = SpecialEffectTarget_OBJ;
+						}
+
+						if(RENDERER_R_BLDCNT_IsTarget2(top2) && prio < GFX_PRIO_TRANSPARENT)
+						{
+							GFX_ALPHA_BLEND(color, back, RENDERER_BLEND);
+						}
+
+					}
+					break;
+				case SpecialEffect_Brightness_Increase:
+					if(RENDERER_R_BLDCNT_IsTarget1(top))
+						color = gfxIncreaseBrightness(color, RENDERER_BLEND);
+					break;
+				case SpecialEffect_Brightness_Decrease:
+					if(RENDERER_R_BLDCNT_IsTarget1(top))
+						color = gfxDecreaseBrightness(color, RENDERER_BLEND);
+					break;
+			}
+		} else {
+			// semi-transparent OBJ
+			uint32_t back = background;
+			uint8_t backPrio = GFX_PRIO_BACKDROP;
+			uint8_t top2 = SpecialEffectTarget_BD;
+
+			if(RENDERER_LINE[Layer_BG2].prio[x] < backPrio) {
+				back = RENDERER_LINE[Layer_BG2].color[x];
+				backPrio = RENDERER_LINE[Layer_BG2].prio[x];
+				top2 = SpecialEffectTarget_BG2;
+			}
+
+			alpha_blend_brightness_switch();
+		}
+
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
+	}
+
+}
+
+template<int renderer_idx>
+static void mode5RenderLineAll (void)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+#if !DEBUG_RENDERER_MODE5
+	return;
+#endif
+#ifdef REPORT_VIDEO_MODES
+	fprintf(stderr, "MODE 5: Render Line All\n");
+#endif
+	uint16_t* lineMix;
+	if (RENDERER_DRAW_RIGHT_SCREEN == 0){
+		lineMix = GET_LINE_MIX_L;
+	} else {
+		lineMix = GET_LINE_MIX_R;	
+	}
+	uint8_t* lineDepth = GET_LINE_DEPTH;
+	uint32_t background = RENDERER_BACKDROP;
+
+	bool inWindow0 = false;
+	bool inWindow1 = false;
+
+	if(RENDERER_R_DISPCNT_Window_0_Display)
+	{
+		uint8_t v0 = RENDERER_R_WIN_Window0_Y1;
+		uint8_t v1 = RENDERER_R_WIN_Window0_Y2;
+		inWindow0 = (uint8_t)(RENDERER_R_VCOUNT - v0) < (uint8_t)(v1 - v0) || ((v0 == v1) && (v0 >= 0xe8));
+	}
+
+	if(RENDERER_R_DISPCNT_Window_1_Display)
+	{
+		uint8_t v0 = RENDERER_R_WIN_Window1_Y1;
+		uint8_t v1 = RENDERER_R_WIN_Window1_Y2;
+		inWindow1 = (uint8_t)(RENDERER_R_VCOUNT - v0) < (uint8_t)(v1 - v0) || ((v0 == v1) && (v0 >= 0xe8));
+	}
+
+	uint8_t windowMask[240];
+	gfxWindowLineMasks<renderer_idx>(windowMask, inWindow0, inWindow1);
+
+	for(int x = 0; x < 240; ++x) {
+		uint32_t color = background;
+		uint8_t prio = GFX_PRIO_BACKDROP;
+		uint8_t top = SpecialEffectTarget_BD;
+		uint8_t mask = windowMask[x];
+
+		if((mask & LayerMask_BG2) && (RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP)) {
+			color = RENDERER_LINE[Layer_BG2].color[x];
+			prio = RENDERER_LINE[Layer_BG2].prio[x];
+			top = SpecialEffectTarget_BG2;
+		}
+
+		if((mask & LayerMask_OBJ) && (RENDERER_LINE[Layer_OBJ].prio[x] < prio)) {
+			color = RENDERER_LINE[Layer_OBJ].color[x];
+			prio = RENDERER_LINE[Layer_OBJ].prio[x];
+			top = SpecialEffectTarget_OBJ;
+		}
+
+		if(prio & GFX_PRIO_SEMI) {
+			// semi-transparent OBJ
+			uint32_t back = background;
+			uint8_t backPrio = GFX_PRIO_BACKDROP;
+			uint8_t top2 = SpecialEffectTarget_BD;
+
+			if((mask & LayerMask_BG2) && RENDERER_LINE[Layer_BG2].prio[x] < backPrio) {
+				back = RENDERER_LINE[Layer_BG2].color[x];
+				backPrio = RENDERER_LINE[Layer_BG2].prio[x];
+				top2 = SpecialEffectTarget_BG2;
+			}
+
+			alpha_blend_brightness_switch();
+		} else if(mask & LayerMask_SFX) {
+			switch(RENDERER_R_BLDCNT_Color_Special_Effect)
+			{
+				case SpecialEffect_None:
+					break;
+				case SpecialEffect_Alpha_Blending:
+					if(RENDERER_R_BLDCNT_IsTarget1(top))
+					{
+						uint32_t back = background;
+						uint8_t backPrio = GFX_PRIO_BACKDROP;
+						uint8_t top2 = SpecialEffectTarget_BD;
+
+						if((mask & LayerMask_BG2) && (top != SpecialEffectTarget_BG2) && (RENDERER_LINE[Layer_BG2].prio[x] < GFX_PRIO_BACKDROP)) {
+							back = RENDERER_LINE[Layer_BG2].color[x];
+							backPrio = RENDERER_LINE[Layer_BG2].prio[x];
+							top2 = SpecialEffectTarget_BG2;
+						}
+
+						if((mask & LayerMask_OBJ) && (top != SpecialEffectTarget_OBJ) && RENDERER_LINE[Layer_OBJ].prio[x] < backPrio) {
+							back = RENDERER_LINE[Layer_OBJ].color[x];
+							backPrio = RENDERER_LINE[Layer_OBJ].prio[x];
+							top2 = SpecialEffectTarget_OBJ;
+						}
+
+						if(RENDERER_R_BLDCNT_IsTarget2(top2) && prio < GFX_PRIO_TRANSPARENT)
+						{
+							GFX_ALPHA_BLEND(color, back, RENDERER_BLEND);
+						}
+					}
+					break;
+				case SpecialEffect_Brightness_Increase:
+					if(RENDERER_R_BLDCNT_IsTarget1(top))
+						color = gfxIncreaseBrightness(color, RENDERER_BLEND);
+					break;
+				case SpecialEffect_Brightness_Decrease:
+					if(RENDERER_R_BLDCNT_IsTarget1(top))
+						color = gfxDecreaseBrightness(color, RENDERER_BLEND);
+					break;
+			}
+		}
+
+		if(lineDepth)
+			lineDepth[x] = gfxPixelDepth(RENDERER_LINE, top, x);
+		lineMix[x] = (u16)color;
+	}
+
+}
+
+/*
+Vectorized compositor for the line renderers without windows.
+
+Every layer of the mode is walked once per group of pixels, keeping both the
+visible entry and the one right behind it, which is the second target of
+semi-transparent sprites and alpha blending. Blending and brightness then
+run on 16 bit colour channels. The kernel is picked at startup; without one
+a scalar compositor specialized for the enabled layers and the effect is
+used. CPUUpdateRender picks the entry of gfxCompositeTable whenever DISPCNT
+or BLDCNT change, and only the enabled layers are passed in.
+*/
+
+struct gfxCompositeArgs {
+	const u16 *colors[5];
+	const u8 *prios[5];
+	u32 targets[5];
+	int count;
+	u16 backdrop;
+	u16 *dst;
+	int effect;
+	u32 target1;
+	u32 target2;
+	u16 eva;
+	u16 evb;
+	u16 evy;
+	const gfxBlendTables *blend;
+};
+
+template<int layers, int effect>
+static void gfxCompositeLineScalar(const gfxCompositeArgs& a)
+{
+	for(int x = 0; x < 240; ++x) {
+		u32 color = a.backdrop, back = a.backdrop;
+		u8 prio = GFX_PRIO_BACKDROP, backPrio = GFX_PRIO_BACKDROP;
+		u32 top = SpecialEffectTarget_BD, top2 = SpecialEffectTarget_BD;
+
+		int i = 0;
+		for(int layer = Layer_BG0; layer <= Layer_OBJ; ++layer) {
+			if(layer != Layer_OBJ && !(layers & (1 << layer)))
+				continue;
+			u8 p = a.prios[i][x];
+			if(p < prio) {
+				back = color;
+				backPrio = prio;
+				top2 = top;
+				color = a.colors[i][x];
+				prio = p;
+				top = a.targets[i];
+			} else if(p < backPrio) {
+				back = a.colors[i][x];
+				backPrio = p;
+				top2 = a.targets[i];
+			}
+			++i;
+		}
+
+		if(top == SpecialEffectTarget_OBJ && (prio & GFX_PRIO_SEMI)) {
+			// semi-transparent OBJ
+			if(a.target2 & top2)
+				GFX_ALPHA_BLEND(color, back, *a.blend);
+		} else if(effect == SpecialEffect_Alpha_Blending) {
+			if((a.target1 & top) && (a.target2 & top2))
+				GFX_ALPHA_BLEND(color, back, *a.blend);
+		} else if(effect == SpecialEffect_Brightness_Increase) {
+			if(a.target1 & top)
+				color = gfxIncreaseBrightness(color, *a.blend);
+		} else if(effect == SpecialEffect_Brightness_Decrease) {
+			if(a.target1 & top)
+				color = gfxDecreaseBrightness(color, *a.blend);
+		}
+
+		a.dst[x] = (u16)color;
+	}
+}
+
+#define GFX_COMPOSITE_EFFECTS(layers) { \
+	gfxCompositeLineScalar<layers, SpecialEffect_None>, \
+	gfxCompositeLineScalar<layers, SpecialEffect_Alpha_Blending>, \
+	gfxCompositeLineScalar<layers, SpecialEffect_Brightness_Increase>, \
+	gfxCompositeLineScalar<layers, SpecialEffect_Brightness_Decrease> }
+
+static gfxcompositefunc_t gfxCompositeTable[16][4] = {
+	GFX_COMPOSITE_EFFECTS(0x0), GFX_COMPOSITE_EFFECTS(0x1), GFX_COMPOSITE_EFFECTS(0x2), GFX_COMPOSITE_EFFECTS(0x3),
+	GFX_COMPOSITE_EFFECTS(0x4), GFX_COMPOSITE_EFFECTS(0x5), GFX_COMPOSITE_EFFECTS(0x6), GFX_COMPOSITE_EFFECTS(0x7),
+	GFX_COMPOSITE_EFFECTS(0x8), GFX_COMPOSITE_EFFECTS(0x9), GFX_COMPOSITE_EFFECTS(0xA), GFX_COMPOSITE_EFFECTS(0xB),
+	GFX_COMPOSITE_EFFECTS(0xC), GFX_COMPOSITE_EFFECTS(0xD), GFX_COMPOSITE_EFFECTS(0xE), GFX_COMPOSITE_EFFECTS(0xF)
+};
+
+// BG layers each video mode draws
+static const int gfxModeLayers[8] = { 0xF, 0x7, 0xC, 0x4, 0x4, 0x4, 0x0, 0x0 };
+
+static INLINE gfxcompositefunc_t gfxSelectComposite(int mode, int type, int layers, u16 bldmod)
+{
+	if(type >= 2 || mode > 5)
+		return NULL;
+	return gfxCompositeTable[layers][type == 1 ? (bldmod >> 6) & 3 : SpecialEffect_None];
+}
+
+/*
+The vector kernels take 16 pixels per step: one vector of priority bytes
+and the matching colours, one or two vectors of 16 bit lanes. Layer order
+and the blend and brightness selection are resolved on the bytes, and the
+masks are only widened to 16 bits for the colour selects and the blend.
+*/
+#if GFX_SSE2
+#define GFX_SEL128(m, a, b) _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b))
+
+// SSE2 only compares signed bytes, so the keys are kept with the top bit flipped
+static INLINE void gfxResolveSSE2(const gfxCompositeArgs& a, int x, __m128i color[2], __m128i back[2], __m128i& key, __m128i& top, __m128i& top2)
+{
+	const __m128i bias = _mm_set1_epi8((char)0x80);
+	color[0] = color[1] = back[0] = back[1] = _mm_set1_epi16(a.backdrop);
+	top = top2 = _mm_set1_epi8(SpecialEffectTarget_BD);
+	key = _mm_set1_epi8((char)(GFX_PRIO_BACKDROP ^ 0x80));
+	__m128i key2 = key;
+
+	for(int i = 0; i < a.count; ++i) {
+		__m128i k = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a.prios[i] + x)), bias);
+		__m128i t = _mm_set1_epi8((char)a.targets[i]);
+		__m128i front = _mm_cmplt_epi8(k, key);
+		__m128i behind = _mm_andnot_si128(front, _mm_cmplt_epi8(k, key2));
+
+		top2 = GFX_SEL128(front, top, GFX_SEL128(behind, t, top2));
+		key2 = GFX_SEL128(front, key, GFX_SEL128(behind, k, key2));
+		top = GFX_SEL128(front, t, top);
+		key = GFX_SEL128(front, k, key);
+
+		for(int h = 0; h < 2; ++h) {
+			__m128i c = _mm_loadu_si128((const __m128i *)(a.colors[i] + x + h * 8));
+			__m128i f = h ? _mm_unpackhi_epi8(front, front) : _mm_unpacklo_epi8(front, front);
+			__m128i b = h ? _mm_unpackhi_epi8(behind, behind) : _mm_unpacklo_epi8(behind, behind);
+			back[h] = GFX_SEL128(f, color[h], GFX_SEL128(b, c, back[h]));
+			color[h] = GFX_SEL128(f, c, color[h]);
+		}
+	}
+}
+
+static INLINE __m128i gfxBlendSSE2(const gfxCompositeArgs& a, __m128i c, __m128i b, __m128i blendMask, __m128i brightMask)
+{
+	const __m128i mask5 = _mm_set1_epi16(0x1F);
+	const __m128i eva = _mm_set1_epi16(a.eva);
+	const __m128i evb = _mm_set1_epi16(a.evb);
+	const __m128i evy = _mm_set1_epi16(a.evy);
+
+	__m128i cr = _mm_and_si128(_mm_srli_epi16(c, GFX_SHIFT_R), mask5);
+	__m128i cg = _mm_and_si128(_mm_srli_epi16(c, GFX_SHIFT_G), mask5);
+	__m128i cb = _mm_and_si128(c, mask5);
+	__m128i br = _mm_and_si128(_mm_srli_epi16(b, GFX_SHIFT_R), mask5);
+	__m128i bg = _mm_and_si128(_mm_srli_epi16(b, GFX_SHIFT_G), mask5);
+	__m128i bb = _mm_and_si128(b, mask5);
+
+	__m128i ar = _mm_min_epi16(mask5, _mm_add_epi16(_mm_srli_epi16(_mm_mullo_epi16(cr, eva), 4), _mm_srli_epi16(_mm_mullo_epi16(br, evb), 4)));
+	__m128i ag = _mm_min_epi16(mask5, _mm_add_epi16(_mm_srli_epi16(_mm_mullo_epi16(cg, eva), 4), _mm_srli_epi16(_mm_mullo_epi16(bg, evb), 4)));
+	__m128i ab = _mm_min_epi16(mask5, _mm_add_epi16(_mm_srli_epi16(_mm_mullo_epi16(cb, eva), 4), _mm_srli_epi16(_mm_mullo_epi16(bb, evb), 4)));
+
+	__m128i yr, yg, yb;
+	if(a.effect == SpecialEffect_Brightness_Increase) {
+		yr = _mm_add_epi16(cr, _mm_srli_epi16(_mm_mullo_epi16(_mm_sub_epi16(mask5, cr), evy), 4));
+		yg = _mm_add_epi16(cg, _mm_srli_epi16(_mm_mullo_epi16(_mm_sub_epi16(mask5, cg), evy), 4));
+		yb = _mm_add_epi16(cb, _mm_srli_epi16(_mm_mullo_epi16(_mm_sub_epi16(mask5, cb), evy), 4));
+	} else {
+		yr = _mm_sub_epi16(cr, _mm_srli_epi16(_mm_mullo_epi16(cr, evy), 4));
+		yg = _mm_sub_epi16(cg, _mm_srli_epi16(_mm_mullo_epi16(cg, evy), 4));
+		yb = _mm_sub_epi16(cb, _mm_srli_epi16(_mm_mullo_epi16(cb, evy), 4));
+	}
+
+	cr = GFX_SEL128(blendMask, ar, GFX_SEL128(brightMask, yr, cr));
+	cg = GFX_SEL128(blendMask, ag, GFX_SEL128(brightMask, yg, cg));
+	cb = GFX_SEL128(blendMask, ab, GFX_SEL128(brightMask, yb, cb));
+
+	c = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(cr, GFX_SHIFT_R), _mm_slli_epi16(cg, GFX_SHIFT_G)), cb);
+#ifdef FRONTEND_SUPPORTS_RGB565
+	c = _mm_or_si128(c, _mm_and_si128(_mm_srli_epi16(c, 5), _mm_set1_epi16(0x20)));
+#endif
+	return c;
+}
+
+static void gfxCompositeLineSSE2(const gfxCompositeArgs& a)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi8(-1);
+	const __m128i semiBit = _mm_set1_epi8(GFX_PRIO_SEMI);
+	const __m128i obj = _mm_set1_epi8(SpecialEffectTarget_OBJ);
+	const __m128i target1 = _mm_set1_epi8((char)a.target1);
+	const __m128i target2 = _mm_set1_epi8((char)a.target2);
+
+	for(int x = 0; x < 240; x += 16) {
+		__m128i color[2], back[2], key, top, top2;
+		gfxResolveSSE2(a, x, color, back, key, top, top2);
+
+		__m128i semi = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_and_si128(key, semiBit), zero), _mm_cmpeq_epi8(top, obj));
+		__m128i isTarget1 = _mm_xor_si128(_mm_cmpeq_epi8(_mm_and_si128(top, target1), zero), ones);
+		__m128i isTarget2 = _mm_xor_si128(_mm_cmpeq_epi8(_mm_and_si128(top2, target2), zero), ones);
+
+		__m128i blend = _mm_and_si128(semi, isTarget2);
+		__m128i bright = zero;
+		if(a.effect == SpecialEffect_Alpha_Blending)
+			blend = _mm_or_si128(blend, _mm_andnot_si128(semi, _mm_and_si128(isTarget1, isTarget2)));
+		else if(a.effect != SpecialEffect_None)
+			bright = _mm_andnot_si128(semi, isTarget1);
+
+		_mm_storeu_si128((__m128i *)(a.dst + x), gfxBlendSSE2(a, color[0], back[0],
+			_mm_unpacklo_epi8(blend, blend), _mm_unpacklo_epi8(bright, bright)));
+		_mm_storeu_si128((__m128i *)(a.dst + x + 8), gfxBlendSSE2(a, color[1], back[1],
+			_mm_unpackhi_epi8(blend, blend), _mm_unpackhi_epi8(bright, bright)));
+	}
+}
+#endif
+
+#if GFX_AVX2
+#define GFX_SEL256(m, a, b) _mm256_blendv_epi8(b, a, m)
+
+// the priority bytes of 16 pixels fit in one SSE vector, their colours in one AVX2 vector
+static GFX_AVX2_TARGET INLINE void gfxResolveAVX2(const gfxCompositeArgs& a, int x, __m256i& color, __m256i& back, __m128i& key, __m128i& top, __m128i& top2)
+{
+	const __m128i bias = _mm_set1_epi8((char)0x80);
+	color = back = _mm256_set1_epi16(a.backdrop);
+	top = top2 = _mm_set1_epi8(SpecialEffectTarget_BD);
+	key = _mm_set1_epi8((char)(GFX_PRIO_BACKDROP ^ 0x80));
+	__m128i key2 = key;
+
+	for(int i = 0; i < a.count; ++i) {
+		__m128i k = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a.prios[i] + x)), bias);
+		__m256i c = _mm256_loadu_si256((const __m256i *)(a.colors[i] + x));
+		__m128i t = _mm_set1_epi8((char)a.targets[i]);
+		__m128i front = _mm_cmplt_epi8(k, key);
+		__m128i behind = _mm_andnot_si128(front, _mm_cmplt_epi8(k, key2));
+		__m256i f = _mm256_cvtepi8_epi16(front);
+		__m256i b = _mm256_cvtepi8_epi16(behind);
+
+		back = GFX_SEL256(f, color, GFX_SEL256(b, c, back));
+		color = GFX_SEL256(f, c, color);
+		top2 = _mm_blendv_epi8(_mm_blendv_epi8(top2, t, behind), top, front);
+		key2 = _mm_blendv_epi8(_mm_blendv_epi8(key2, k, behind), key, front);
+		top = _mm_blendv_epi8(top, t, front);
+		key = _mm_blendv_epi8(key, k, front);
+	}
+}
+
+static GFX_AVX2_TARGET void gfxCompositeLineAVX2(const gfxCompositeArgs& a)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi8(-1);
+	const __m128i semiBit = _mm_set1_epi8(GFX_PRIO_SEMI);
+	const __m128i obj = _mm_set1_epi8(SpecialEffectTarget_OBJ);
+	const __m128i target1 = _mm_set1_epi8((char)a.target1);
+	const __m128i target2 = _mm_set1_epi8((char)a.target2);
+	const __m256i mask5 = _mm256_set1_epi16(0x1F);
+	const __m256i eva = _mm256_set1_epi16(a.eva);
+	const __m256i evb = _mm256_set1_epi16(a.evb);
+	const __m256i evy = _mm256_set1_epi16(a.evy);
+
+	for(int x = 0; x < 240; x += 16) {
+		__m256i c, b;
+		__m128i key, top, top2;
+		gfxResolveAVX2(a, x, c, b, key, top, top2);
+
+		__m128i semi = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_and_si128(key, semiBit), zero), _mm_cmpeq_epi8(top, obj));
+		__m128i isTarget1 = _mm_xor_si128(_mm_cmpeq_epi8(_mm_and_si128(top, target1), zero), ones);
+		__m128i isTarget2 = _mm_xor_si128(_mm_cmpeq_epi8(_mm_and_si128(top2, target2), zero), ones);
+
+		__m128i blend = _mm_and_si128(semi, isTarget2);
+		__m128i bright = zero;
+		if(a.effect == SpecialEffect_Alpha_Blending)
+			blend = _mm_or_si128(blend, _mm_andnot_si128(semi, _mm_and_si128(isTarget1, isTarget2)));
+		else if(a.effect != SpecialEffect_None)
+			bright = _mm_andnot_si128(semi, isTarget1);
+
+		__m256i blendMask = _mm256_cvtepi8_epi16(blend);
+		__m256i brightMask = _mm256_cvtepi8_epi16(bright);
+
+		__m256i cr = _mm256_and_si256(_mm256_srli_epi16(c, GFX_SHIFT_R), mask5);
+		__m256i cg = _mm256_and_si256(_mm256_srli_epi16(c, GFX_SHIFT_G), mask5);
+		__m256i cb = _mm256_and_si256(c, mask5);
+		__m256i br = _mm256_and_si256(_mm256_srli_epi16(b, GFX_SHIFT_R), mask5);
+		__m256i bg = _mm256_and_si256(_mm256_srli_epi16(b, GFX_SHIFT_G), mask5);
+		__m256i bb = _mm256_and_si256(b, mask5);
+
+		__m256i ar = _mm256_min_epi16(mask5, _mm256_add_epi16(_mm256_srli_epi16(_mm256_mullo_epi16(cr, eva), 4), _mm256_srli_epi16(_mm256_mullo_epi16(br, evb), 4)));
+		__m256i ag = _mm256_min_epi16(mask5, _mm256_add_epi16(_mm256_srli_epi16(_mm256_mullo_epi16(cg, eva), 4), _mm256_srli_epi16(_mm256_mullo_epi16(bg, evb), 4)));
+		__m256i ab = _mm256_min_epi16(mask5, _mm256_add_epi16(_mm256_srli_epi16(_mm256_mullo_epi16(cb, eva), 4), _mm256_srli_epi16(_mm256_mullo_epi16(bb, evb), 4)));
+
+		__m256i yr, yg, yb;
+		if(a.effect == SpecialEffect_Brightness_Increase) {
+			yr = _mm256_add_epi16(cr, _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(mask5, cr), evy), 4));
+			yg = _mm256_add_epi16(cg, _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(mask5, cg), evy), 4));
+			yb = _mm256_add_epi16(cb, _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(mask5, cb), evy), 4));
+		} else {
+			yr = _mm256_sub_epi16(cr, _mm256_srli_epi16(_mm256_mullo_epi16(cr, evy), 4));
+			yg = _mm256_sub_epi16(cg, _mm256_srli_epi16(_mm256_mullo_epi16(cg, evy), 4));
+			yb = _mm256_sub_epi16(cb, _mm256_srli_epi16(_mm256_mullo_epi16(cb, evy), 4));
+		}
+
+		cr = GFX_SEL256(blendMask, ar, GFX_SEL256(brightMask, yr, cr));
+		cg = GFX_SEL256(blendMask, ag, GFX_SEL256(brightMask, yg, cg));
+		cb = GFX_SEL256(blendMask, ab, GFX_SEL256(brightMask, yb, cb));
+
+		c = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(cr, GFX_SHIFT_R), _mm256_slli_epi16(cg, GFX_SHIFT_G)), cb);
+#ifdef FRONTEND_SUPPORTS_RGB565
+		c = _mm256_or_si256(c, _mm256_and_si256(_mm256_srli_epi16(c, 5), _mm256_set1_epi16(0x20)));
+#endif
+		_mm256_storeu_si256((__m256i *)(a.dst + x), c);
+	}
+}
+#endif
+
+#if GFX_NEON
+static INLINE uint16x8_t gfxWidenMaskNEON(uint8x8_t m)
+{
+	return vreinterpretq_u16_s16(vmovl_s8(vreinterpret_s8_u8(m)));
+}
+
+static INLINE void gfxResolveNEON(const gfxCompositeArgs& a, int x, uint16x8_t color[2], uint16x8_t back[2], uint8x16_t& key, uint8x16_t& top, uint8x16_t& top2)
+{
+	color[0] = color[1] = back[0] = back[1] = vdupq_n_u16(a.backdrop);
+	top = top2 = vdupq_n_u8(SpecialEffectTarget_BD);
+	key = vdupq_n_u8(GFX_PRIO_BACKDROP);
+	uint8x16_t key2 = key;
+
+	for(int i = 0; i < a.count; ++i) {
+		uint8x16_t k = vld1q_u8(a.prios[i] + x);
+		uint8x16_t t = vdupq_n_u8((u8)a.targets[i]);
+		uint8x16_t front = vcltq_u8(k, key);
+		uint8x16_t behind = vbicq_u8(vcltq_u8(k, key2), front);
+
+		top2 = vbslq_u8(front, top, vbslq_u8(behind, t, top2));
+		key2 = vbslq_u8(front, key, vbslq_u8(behind, k, key2));
+		top = vbslq_u8(front, t, top);
+		key = vbslq_u8(front, k, key);
+
+		for(int h = 0; h < 2; ++h) {
+			uint16x8_t c = vld1q_u16(a.colors[i] + x + h * 8);
+			uint16x8_t f = gfxWidenMaskNEON(h ? vget_high_u8(front) : vget_low_u8(front));
+			uint16x8_t b = gfxWidenMaskNEON(h ? vget_high_u8(behind) : vget_low_u8(behind));
+			back[h] = vbslq_u16(f, color[h], vbslq_u16(b, c, back[h]));
+			color[h] = vbslq_u16(f, c, color[h]);
+		}
+	}
+}
+
+static INLINE uint16x8_t gfxBlendNEON(const gfxCompositeArgs& a, uint16x8_t c, uint16x8_t b, uint16x8_t blendMask, uint16x8_t brightMask)
+{
+	const uint16x8_t mask5 = vdupq_n_u16(0x1F);
+
+	uint16x8_t cr = vandq_u16(vshrq_n_u16(c, GFX_SHIFT_R), mask5);
+	uint16x8_t cg = vandq_u16(vshrq_n_u16(c, GFX_SHIFT_G), mask5);
+	uint16x8_t cb = vandq_u16(c, mask5);
+	uint16x8_t br = vandq_u16(vshrq_n_u16(b, GFX_SHIFT_R), mask5);
+	uint16x8_t bg = vandq_u16(vshrq_n_u16(b, GFX_SHIFT_G), mask5);
+	uint16x8_t bb = vandq_u16(b, mask5);
+
+	uint16x8_t ar = vminq_u16(mask5, vaddq_u16(vshrq_n_u16(vmulq_n_u16(cr, a.eva), 4), vshrq_n_u16(vmulq_n_u16(br, a.evb), 4)));
+	uint16x8_t ag = vminq_u16(mask5, vaddq_u16(vshrq_n_u16(vmulq_n_u16(cg, a.eva), 4), vshrq_n_u16(vmulq_n_u16(bg, a.evb), 4)));
+	uint16x8_t ab = vminq_u16(mask5, vaddq_u16(vshrq_n_u16(vmulq_n_u16(cb, a.eva), 4), vshrq_n_u16(vmulq_n_u16(bb, a.evb), 4)));
+
+	uint16x8_t yr, yg, yb;
+	if(a.effect == SpecialEffect_Brightness_Increase) {
+		yr = vaddq_u16(cr, vshrq_n_u16(vmulq_n_u16(vsubq_u16(mask5, cr), a.evy), 4));
+		yg = vaddq_u16(cg, vshrq_n_u16(vmulq_n_u16(vsubq_u16(mask5, cg), a.evy), 4));
+		yb = vaddq_u16(cb, vshrq_n_u16(vmulq_n_u16(vsubq_u16(mask5, cb), a.evy), 4));
+	} else {
+		yr = vsubq_u16(cr, vshrq_n_u16(vmulq_n_u16(cr, a.evy), 4));
+		yg = vsubq_u16(cg, vshrq_n_u16(vmulq_n_u16(cg, a.evy), 4));
+		yb = vsubq_u16(cb, vshrq_n_u16(vmulq_n_u16(cb, a.evy), 4));
+	}
+
+	cr = vbslq_u16(blendMask, ar, vbslq_u16(brightMask, yr, cr));
+	cg = vbslq_u16(blendMask, ag, vbslq_u16(brightMask, yg, cg));
+	cb = vbslq_u16(blendMask, ab, vbslq_u16(brightMask, yb, cb));
+
+	c = vorrq_u16(vorrq_u16(vshlq_n_u16(cr, GFX_SHIFT_R), vshlq_n_u16(cg, GFX_SHIFT_G)), cb);
+#ifdef FRONTEND_SUPPORTS_RGB565
+	c = vorrq_u16(c, vandq_u16(vshrq_n_u16(c, 5), vdupq_n_u16(0x20)));
+#endif
+	return c;
+}
+
+static void gfxCompositeLineNEON(const gfxCompositeArgs& a)
+{
+	const uint8x16_t semiBit = vdupq_n_u8(GFX_PRIO_SEMI);
+	const uint8x16_t obj = vdupq_n_u8(SpecialEffectTarget_OBJ);
+	const uint8x16_t target1 = vdupq_n_u8((u8)a.target1);
+	const uint8x16_t target2 = vdupq_n_u8((u8)a.target2);
+
+	for(int x = 0; x < 240; x += 16) {
+		uint16x8_t color[2], back[2];
+		uint8x16_t key, top, top2;
+		gfxResolveNEON(a, x, color, back, key, top, top2);
+
+		uint8x16_t semi = vandq_u8(vceqq_u8(top, obj), vtstq_u8(key, semiBit));
+		uint8x16_t isTarget1 = vtstq_u8(top, target1);
+		uint8x16_t isTarget2 = vtstq_u8(top2, target2);
+
+		uint8x16_t blend = vandq_u8(semi, isTarget2);
+		uint8x16_t bright = vdupq_n_u8(0);
+		if(a.effect == SpecialEffect_Alpha_Blending)
+			blend = vorrq_u8(blend, vbicq_u8(vandq_u8(isTarget1, isTarget2), semi));
+		else if(a.effect != SpecialEffect_None)
+			bright = vbicq_u8(isTarget1, semi);
+
+		vst1q_u16(a.dst + x, gfxBlendNEON(a, color[0], back[0],
+			gfxWidenMaskNEON(vget_low_u8(blend)), gfxWidenMaskNEON(vget_low_u8(bright))));
+		vst1q_u16(a.dst + x + 8, gfxBlendNEON(a, color[1], back[1],
+			gfxWidenMaskNEON(vget_high_u8(blend)), gfxWidenMaskNEON(vget_high_u8(bright))));
+	}
+}
+#endif
+
+static void gfxSelectCompositor(void)
+{
+	gfxcompositefunc_t kernel = NULL;
+#if GFX_AVX2
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) {
+		kernel = gfxCompositeLineAVX2;
+		gfxAffineGather = true;
+	}
+#endif
+#if GFX_SSE2
+	if(kernel == NULL)
+		kernel = gfxCompositeLineSSE2;
+#elif GFX_NEON
+	kernel = gfxCompositeLineNEON;
+#endif
+	if(kernel == NULL)
+		return;
+
+	for(int layers = 0; layers < 16; ++layers)
+		for(int effect = 0; effect < 4; ++effect)
+			gfxCompositeTable[layers][effect] = kernel;
+}
+
+template<int renderer_idx>
+static bool gfxCompositeLine(void)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+	if(RENDERER_RENDERFUNC_COMPOSITE == NULL || GET_LINE_DEPTH != NULL)
+		return false;
+
+	gfxCompositeArgs a;
+	a.count = 0;
+	for(int layer = Layer_BG0; layer <= Layer_BG3; ++layer) {
+		if(RENDERER_RENDERFUNC_LAYERS & (1 << layer)) {
+			a.colors[a.count] = RENDERER_LINE[layer].color;
+			a.prios[a.count] = RENDERER_LINE[layer].prio;
+			a.targets[a.count++] = 1 << layer;
+		}
+	}
+	a.colors[a.count] = RENDERER_LINE[Layer_OBJ].color;
+	a.prios[a.count] = RENDERER_LINE[Layer_OBJ].prio;
+	a.targets[a.count++] = SpecialEffectTarget_OBJ;
+
+	a.backdrop = RENDERER_BACKDROP;
+	a.dst = RENDERER_DRAW_RIGHT_SCREEN == 0 ? GET_LINE_MIX_L : GET_LINE_MIX_R;
+	a.effect = RENDERER_RENDERFUNC_TYPE == 1 ? RENDERER_R_BLDCNT_Color_Special_Effect : SpecialEffect_None;
+	a.target1 = RENDERER_BLDMOD & 0xFF;
+	a.target2 = (RENDERER_BLDMOD >> 8) & 0xFF;
+	a.eva = coeff[RENDERER_COLEV & 0x1F];
+	a.evb = coeff[(RENDERER_COLEV >> 8) & 0x1F];
+	a.evy = coeff[RENDERER_COLY & 0x1F];
+	a.blend = &RENDERER_BLEND;
+
+	RENDERER_RENDERFUNC_COMPOSITE(a);
+	return true;
+}
+
+/*
+Stereo line rendering.
+
+Sprites, the OBJ window and every background are decoded once per line and
+every view is composited from the same line buffers. View 0 is the left eye,
+view 1 the right eye, and further views of a multi-view frame continue in
+the same direction. Backgrounds are decoded wide enough to cover all views,
+each of which reads them through a window moved by parallax_offset pixels
+per priority level and view. For rotation and bitmap backgrounds that is the
+same as offsetting the reference point. Sprites with depth are written to
+one extra OBJ line per view in the same pass.
+*/
+
+// Window offsets of the first and last view drawn for a layer shifted by shift.
+template<int renderer_idx>
+static INLINE void gfxViewSpan(int shift, int& lo, int& hi)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+	lo = RENDERER_FIRST_EYE * shift;
+	hi = RENDERER_LAST_EYE * shift;
+	if(lo > hi) {
+		int t = lo;
+		lo = hi;
+		hi = t;
+	}
+}
+
+template<int layer, int renderer_idx>
+static INLINE void gfxDrawTextScreenEye(int eye, bool decode)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+	u16 control = RENDERER_IO_REGISTERS[REG_BG0CNT + layer];
+	u16 hofs = RENDERER_IO_REGISTERS[REG_BG0HOFS + (layer << 1)];
+	u16 vofs = RENDERER_IO_REGISTERS[REG_BG0VOFS + (layer << 1)];
+	int shift = (control & 3) * parallax_offset;
+
+	// Every view reads the one wide line decoded below, except a mosaic layer
+	// with parallax: its blocks are aligned to each eye's own screen edge and
+	// applying them in place would spoil the other eye's window, so each eye
+	// decodes its own 240 pixels.
+	if(shift != 0 && (control & 0x40)) {
+		gfxDrawTextScreen<layer, renderer_idx>(control, hofs + eye * shift, vofs, 0, 240);
+		return;
+	}
+
+	if(decode) {
+		int lo, hi;
+		gfxViewSpan<renderer_idx>(shift, lo, hi);
+		int x0 = (lo < 0) ? -((7 - lo) & ~7) : 0;
+		int x1 = (hi > 0) ? 240 + ((hi + 7) & ~7) : 240;
+		gfxDrawTextScreen<layer, renderer_idx>(control, hofs, vofs, x0, x1);
+	}
+
+	RENDERER_LINE[layer] = gfxLineAt(RENDERER_LINE_BUFFER[layer], eye * shift);
+}
+
+template<int renderer_idx>
+static void gfxDrawBackgrounds(int eye, bool decode)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+	switch(RENDERER_R_DISPCNT_Video_Mode) {
+	case 0:
+		if(RENDERER_R_DISPCNT_Screen_Display_BG0)
+			gfxDrawTextScreenEye<Layer_BG0, renderer_idx>(eye, decode);
+		if(RENDERER_R_DISPCNT_Screen_Display_BG1)
+			gfxDrawTextScreenEye<Layer_BG1, renderer_idx>(eye, decode);
+		if(RENDERER_R_DISPCNT_Screen_Display_BG2)
+			gfxDrawTextScreenEye<Layer_BG2, renderer_idx>(eye, decode);
+		if(RENDERER_R_DISPCNT_Screen_Display_BG3)
+			gfxDrawTextScreenEye<Layer_BG3, renderer_idx>(eye, decode);
+		return;
+	case 1:
+		if(RENDERER_R_DISPCNT_Screen_Display_BG0)
+			gfxDrawTextScreenEye<Layer_BG0, renderer_idx>(eye, decode);
+		if(RENDERER_R_DISPCNT_Screen_Display_BG1)
+			gfxDrawTextScreenEye<Layer_BG1, renderer_idx>(eye, decode);
+		break;
+	}
+
+	// rotation and bitmap backgrounds are sampled once from the current
+	// reference point, over the pixels both eyes need
+	int shift2 = (RENDERER_IO_REGISTERS[REG_BG2CNT] & 3) * parallax_offset;
+	int shift3 = (RENDERER_IO_REGISTERS[REG_BG3CNT] & 3) * parallax_offset;
+
+	if(decode) {
+		int lo, hi;
+		gfxViewSpan<renderer_idx>(shift2, lo, hi);
+		int x0 = min(0, lo);
+		int x1 = 240 + max(0, hi);
+
+		switch(RENDERER_R_DISPCNT_Video_Mode) {
+		case 1:
+			if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
+				gfxDrawRotScreen<Layer_BG2, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG2CNT], RENDERER_BG2X_L, RENDERER_BG2X_H, RENDERER_BG2Y_L, RENDERER_BG2Y_H,
+						RENDERER_IO_REGISTERS[REG_BG2PA], RENDERER_IO_REGISTERS[REG_BG2PB], RENDERER_IO_REGISTERS[REG_BG2PC], RENDERER_IO_REGISTERS[REG_BG2PD],
+						RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C, x0, x1);
+			}
+			break;
+		case 2:
+			if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
+				gfxDrawRotScreen<Layer_BG2, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG2CNT], RENDERER_BG2X_L, RENDERER_BG2X_H, RENDERER_BG2Y_L, RENDERER_BG2Y_H,
+						RENDERER_IO_REGISTERS[REG_BG2PA], RENDERER_IO_REGISTERS[REG_BG2PB], RENDERER_IO_REGISTERS[REG_BG2PC], RENDERER_IO_REGISTERS[REG_BG2PD],
+						RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C, x0, x1);
+			}
+			if(RENDERER_R_DISPCNT_Screen_Display_BG3) {
+				gfxViewSpan<renderer_idx>(shift3, lo, hi);
+				gfxDrawRotScreen<Layer_BG3, renderer_idx>(RENDERER_IO_REGISTERS[REG_BG3CNT], RENDERER_BG3X_L, RENDERER_BG3X_H, RENDERER_BG3Y_L, RENDERER_BG3Y_H,
+						RENDERER_IO_REGISTERS[REG_BG3PA], RENDERER_IO_REGISTERS[REG_BG3PB], RENDERER_IO_REGISTERS[REG_BG3PC], RENDERER_IO_REGISTERS[REG_BG3PD],
+						RENDERER_BG3X, RENDERER_BG3Y, RENDERER_BG3C, min(0, lo), 240 + max(0, hi));
+			}
+#if !THREADED_RENDERER
+			RENDERER_BG3C = 0;
+#endif
+			break;
+		case 3:
+			if(RENDERER_R_DISPCNT_Screen_Display_BG2)
+				gfxDrawRotScreen16Bit<renderer_idx>(RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C, x0, x1);
+			break;
+		case 4:
+			if(RENDERER_R_DISPCNT_Screen_Display_BG2)
+				gfxDrawRotScreen256<renderer_idx>(RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C, x0, x1);
+			break;
+		case 5:
+			if(RENDERER_R_DISPCNT_Screen_Display_BG2)
+				gfxDrawRotScreen16Bit160<renderer_idx>(RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C, x0, x1);
+			break;
+		default:
+			return;
+		}
+
+#if !THREADED_RENDERER
+		RENDERER_BG2C = 0;
+#endif
+	}
+
+	// moving the view by the shift moves the reference point by shift*PA, shift*PC
+	RENDERER_LINE[Layer_BG2] = gfxLineAt(RENDERER_LINE_BUFFER[Layer_BG2], eye * shift2);
+	if(RENDERER_R_DISPCNT_Video_Mode == 2)
+		RENDERER_LINE[Layer_BG3] = gfxLineAt(RENDERER_LINE_BUFFER[Layer_BG3], eye * shift3);
+}
+
+// Sprites sit at the depth of the backgrounds sharing their priority. The
+// shift of every OBJ is taken from OAM once per frame.
+template<int renderer_idx>
+static void gfxUpdateOBJParallax(void)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+	RENDERER_OBJ_PARALLAX_ENABLED = (parallax_offset != 0) && (RENDERER_LAST_EYE >= 1);
+
+	u16 *sprites = (u16 *)RENDERER_OAM;
+	for(int x = 0; x < 128; x++, sprites += 4)
+		RENDERER_OBJ_PARALLAX[x] = ((READ16LE(&sprites[2]) >> 10) & 3) * parallax_offset;
+}
+
+// The other views only differ from the left eye when a background or a
+// sprite on the line sits behind priority 0.
+template<int renderer_idx>
+static bool gfxLineHasDisparity(void)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+	if(parallax_offset == 0)
+		return false;
+	if(RENDERER_OBJ_DISPARITY)
+		return true;
+
+	int layers = 0;
+	switch(RENDERER_R_DISPCNT_Video_Mode) {
+	case 0:
+		layers = (1 << Layer_BG0) | (1 << Layer_BG1) | (1 << Layer_BG2) | (1 << Layer_BG3);
+		break;
+	case 1:
+		layers = (1 << Layer_BG0) | (1 << Layer_BG1) | (1 << Layer_BG2);
+		break;
+	case 2:
+		layers = (1 << Layer_BG2) | (1 << Layer_BG3);
+		break;
+	case 3:
+	case 4:
+	case 5:
+		layers = (1 << Layer_BG2);
+		break;
+	}
+
+	for(int layer = Layer_BG0; layer <= Layer_BG3; ++layer) {
+		if((layers & (1 << layer)) && (RENDERER_GRAPHICS_LAYERS & (0x100 << layer)) &&
+				(RENDERER_IO_REGISTERS[REG_BG0CNT + layer] & 3))
+			return true;
+	}
+	return false;
+}
+
+/*
+Static lines.
+
+A line is fingerprinted from everything it is drawn from: the registers, the
+rotation reference points, the VRAM and palette generation, the OAM entries
+of the sprites on it and the stereo settings. When the fingerprint is the one
+the line had when it was last drawn, its pixels are still in pix and the line
+is not drawn again. Fingerprints are kept apart for contexts drawing the
+right-hand views only.
+*/
+static u64 gfxLineFingerprints[2][160];
+
+static INLINE u64 gfxHashWord(u64 hash, u32 word)
+{
+	return (hash ^ word) * 0x100000001B3ULL;
+}
+
+template<int renderer_idx>
+static u64 gfxLineFingerprint(void)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+	u64 hash = 0xCBF29CE484222325ULL;
+	hash = gfxHashWord(hash, RENDERER_VIDEO_GEN);
+	hash = gfxHashWord(hash, (RENDERER_RENDERFUNC_TYPE << 8) | RENDERER_R_DISPCNT_Video_Mode);
+	hash = gfxHashWord(hash, RENDERER_GRAPHICS_LAYERS);
+	hash = gfxHashWord(hash, RENDERER_BG2C | (RENDERER_BG3C << 2));
+	hash = gfxHashWord(hash, RENDERER_BG2X);
+	hash = gfxHashWord(hash, RENDERER_BG2Y);
+	hash = gfxHashWord(hash, RENDERER_BG3X);
+	hash = gfxHashWord(hash, RENDERER_BG3Y);
+	hash = gfxHashWord(hash, RENDERER_BG2X_L | (RENDERER_BG2X_H << 16));
+	hash = gfxHashWord(hash, RENDERER_BG2Y_L | (RENDERER_BG2Y_H << 16));
+	hash = gfxHashWord(hash, RENDERER_BG3X_L | (RENDERER_BG3X_H << 16));
+	hash = gfxHashWord(hash, RENDERER_BG3Y_L | (RENDERER_BG3Y_H << 16));
+	hash = gfxHashWord(hash, RENDERER_MOSAIC | (RENDERER_BLDMOD << 16));
+	hash = gfxHashWord(hash, RENDERER_COLEV | (RENDERER_COLY << 16));
+	hash = gfxHashWord(hash, parallax_offset);
+	hash = gfxHashWord(hash, (stereo_views << 16) | (RENDERER_FIRST_EYE << 8) | RENDERER_LAST_EYE);
+	hash = gfxHashWord(hash, depth_plane_enabled | (RENDERER_OBJ_PARALLAX_ENABLED << 1));
+
+	// DISPSTAT is the only one the renderer has no use for
+	const u16 *regs = RENDERER_IO_REGISTERS;
+	for(int i = 0; i < RENDERER_IO_REGISTER_COUNT; i += 2)
+		hash = gfxHashWord(hash, (i == REG_DISPSTAT ? 0 : regs[i]) | (regs[i + 1] << 16));
+
+	if(RENDERER_DRAW_SPRITES) {
+		const u32 *lineSprites = gfxOAMLine<renderer_idx>();
+		const u16 *sprites = (const u16 *)RENDERER_OAM;
+		for(int x = 0; x < 128; ++x) {
+			if(!(lineSprites[x >> 5] & (1u << (x & 31))))
+				continue;
+			const u16 *sprite = sprites + x * 4;
+			hash = gfxHashWord(hash, x | (RENDERER_OBJ_PARALLAX[x] << 8));
+			hash = gfxHashWord(hash, READ16LE(&sprite[0]) | (READ16LE(&sprite[1]) << 16));
+			hash = gfxHashWord(hash, READ16LE(&sprite[2]));
+			if(READ16LE(&sprite[0]) & 0x0100) {
+				const u16 *params = sprites + ((READ16LE(&sprite[1]) >> 9) & 31) * 16;
+				hash = gfxHashWord(hash, READ16LE(&params[3]) | (READ16LE(&params[7]) << 16));
+				hash = gfxHashWord(hash, READ16LE(&params[11]) | (READ16LE(&params[15]) << 16));
+			}
+		}
+	}
+
+	return hash | 1;
+}
+
+#if !THREADED_RENDERER
+// A line that is not drawn still moves the rotation reference points on, as
+// gfxDrawBackgrounds would have.
+static void gfxSkipBackgrounds(void)
+{
+	switch(R_DISPCNT_Video_Mode) {
+	case 1:
+	case 2:
+		if(graphics.layerEnable & 0x0400)
+			fetchDrawRotScreen(io_registers[REG_BG2CNT], BG2X_L, BG2X_H, BG2Y_L, BG2Y_H,
+				io_registers[REG_BG2PA], io_registers[REG_BG2PB], io_registers[REG_BG2PC], io_registers[REG_BG2PD],
+				gfxBG2X, gfxBG2Y, gfxBG2Changed);
+		if(R_DISPCNT_Video_Mode == 2) {
+			if(graphics.layerEnable & 0x0800)
+				fetchDrawRotScreen(io_registers[REG_BG3CNT], BG3X_L, BG3X_H, BG3Y_L, BG3Y_H,
+					io_registers[REG_BG3PA], io_registers[REG_BG3PB], io_registers[REG_BG3PC], io_registers[REG_BG3PD],
+					gfxBG3X, gfxBG3Y, gfxBG3Changed);
+			gfxBG3Changed = 0;
+		}
+		break;
+	case 3:
+		if(graphics.layerEnable & 0x0400)
+			fetchDrawRotScreen16Bit(gfxBG2X, gfxBG2Y, gfxBG2Changed);
+		break;
+	case 4:
+		if(graphics.layerEnable & 0x0400)
+			fetchDrawRotScreen256(gfxBG2X, gfxBG2Y, gfxBG2Changed);
+		break;
+	case 5:
+		if(graphics.layerEnable & 0x0400)
+			fetchDrawRotScreen16Bit160(gfxBG2X, gfxBG2Y, gfxBG2Changed);
+		break;
+	default:
+		return;
+	}
+	gfxBG2Changed = 0;
+}
+#endif
+
+template<int renderer_idx>
+static void gfxRenderStereoLine(void)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+
+	if(RENDERER_R_VCOUNT <= RENDERER_OBJ_PARALLAX_VCOUNT)
+		gfxUpdateOBJParallax<renderer_idx>();
+	RENDERER_OBJ_PARALLAX_VCOUNT = RENDERER_R_VCOUNT;
+
+	renderfunc_t renderLine = GetRenderFunc<renderer_idx>(RENDERER_R_DISPCNT_Video_Mode, RENDERER_RENDERFUNC_TYPE);
+	if(renderLine == NULL)
+		return;
+
+	u64 fingerprint = gfxLineFingerprint<renderer_idx>();
+	u64 &last = gfxLineFingerprints[RENDERER_FIRST_EYE != 0][RENDERER_R_VCOUNT];
+	if(last == fingerprint) {
+#if !THREADED_RENDERER
+		gfxSkipBackgrounds();
 #endif
-	uint16_t* lineMix;
-	if (draw_right_screen == 0){
-		lineMix = GET_LINE_MIX_L;
-	} else {
-		lineMix = GET_LINE_MIX_R;	
+		return;
 	}
-	uint32_t background = RENDERER_BACKDROP;
+	last = fingerprint;
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		gfxDrawRotScreen16Bit160<renderer_idx>(RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C);
+	memset(RENDERER_LINE[Layer_OBJ].prio, -1, 240);	// erase all sprites
+	if(RENDERER_OBJ_PARALLAX_ENABLED) {
+		for(int eye = max(1, RENDERER_FIRST_EYE); eye <= RENDERER_LAST_EYE; ++eye)
+			memset(RENDERER_LINE_OBJ_VIEWS[eye - 1].prio + LINE_BUFFER_MARGIN, -1, 240);
 	}
+	RENDERER_OBJ_DISPARITY = false;
+	if(RENDERER_RENDERFUNC_TYPE == 2)
+		memset(RENDERER_LINE[Layer_WIN_OBJ].prio, -1, 240);	// erase all OBJ Win
+	if(RENDERER_DRAW_SPRITES)
+		gfxDrawSprites<renderer_idx>();	// also draws the OBJ window on windowed lines
 
-	for(int x = 0; x < 240; ++x) {
-		uint32_t color = background;
-		uint8_t top = SpecialEffectTarget_BD;
-
-		if(RENDERER_LINE[Layer_BG2][x] < background) {
-			color = RENDERER_LINE[Layer_BG2][x];
-			top = SpecialEffectTarget_BG2;
-		}
+	bool disparity = gfxLineHasDisparity<renderer_idx>();
 
-		if((uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(color >>24)) {
-			color = RENDERER_LINE[Layer_OBJ][x];
-			top = SpecialEffectTarget_OBJ;
+	for(int eye = RENDERER_FIRST_EYE; eye <= RENDERER_LAST_EYE; ++eye) {
+		if(eye >= 1 && !disparity)
+			break;
 
-			if(color & 0x00010000) {
-				// semi-transparent OBJ
-				uint32_t back = background;
-				uint8_t top2 = SpecialEffectTarget_BD;
+		RENDERER_DRAW_RIGHT_SCREEN = eye;
+		gfxDrawBackgrounds<renderer_idx>(eye, eye == RENDERER_FIRST_EYE);
+		if(eye >= 1 && RENDERER_OBJ_PARALLAX_ENABLED)
+			RENDERER_LINE[Layer_OBJ] = gfxLineAt(RENDERER_LINE_OBJ_VIEWS[eye - 1], 0);
+		if(!gfxCompositeLine<renderer_idx>())
+			renderLine();
+	}
 
-				if(RENDERER_LINE[Layer_BG2][x] < back) {
-					back = RENDERER_LINE[Layer_BG2][x];
-					top2 = SpecialEffectTarget_BG2;
-				}
+	// without disparity every other view is a copy of the left eye, made by
+	// whichever context drew the left eye
+	if(!disparity && RENDERER_FIRST_EYE == 0) {
+		for(int view = 1; view < stereo_views; ++view)
+			memcpy(GET_LINE_MIX_VIEW(view), GET_LINE_MIX_L, 240 * sizeof(u16));
+	}
 
-				alpha_blend_brightness_switch();
-			}
-		}
+	for(int layer = Layer_BG0; layer <= Layer_OBJ; ++layer)
+		RENDERER_LINE[layer] = gfxLineAt(RENDERER_LINE_BUFFER[layer], 0);
+}
 
-		lineMix[x] = CONVERT_COLOR(color);
-	}
+#if THREADED_RENDERER
+// what the renderer reads of the registers for one line
+typedef struct {
+	u32 renderfunc_mode;
+	u32 renderfunc_type;
+	u32 renderfunc_layers;
+	u32 draw_objwin;
+	u32 draw_sprites;
+	u32 layers;
+	u32 mosaic;
+	u32 bldmod;
+	u32 colev;
+	u32 coly;
+	u32 vcount;
+	u32 video_gen;
+	u32 background_ver;
+	s32 bg2c;
+	s32 bg2x;
+	s32 bg2y;
+	s32 bg2x_l;
+	s32 bg2x_h;
+	s32 bg2y_l;
+	s32 bg2y_h;
+	s32 bg3c;
+	s32 bg3x;
+	s32 bg3y;
+	s32 bg3x_l;
+	s32 bg3x_h;
+	s32 bg3y_l;
+	s32 bg3y_h;
+	u16 io_registers[RENDERER_IO_REGISTER_COUNT];
+} gfxLineState;
+
+#define GFX_STATE_WORDS (sizeof(gfxLineState) / sizeof(u32))
+
+static void gfxFillLineState(gfxLineState& state)
+{
+	state.renderfunc_mode = renderfunc_mode;
+	state.renderfunc_type = renderfunc_type;
+	state.renderfunc_layers = renderfunc_layers;
+	state.draw_objwin = (graphics.layerEnable & 0x9000) == 0x9000;
+	state.draw_sprites = R_DISPCNT_Screen_Display_OBJ ? 1 : 0;
+	state.layers = graphics.layerEnable;
+	state.mosaic = MOSAIC;
+	state.bldmod = BLDMOD;
+	state.colev = COLEV;
+	state.coly = COLY;
+	state.vcount = io_registers[REG_VCOUNT];
+	state.video_gen = gfxVideoGen;
+	state.background_ver = threaded_background_ver;
+	state.bg2c = gfxBG2Changed;
+	state.bg2x = gfxBG2X;
+	state.bg2y = gfxBG2Y;
+	state.bg2x_l = BG2X_L;
+	state.bg2x_h = BG2X_H;
+	state.bg2y_l = BG2Y_L;
+	state.bg2y_h = BG2Y_H;
+	state.bg3c = gfxBG3Changed;
+	state.bg3x = gfxBG3X;
+	state.bg3y = gfxBG3Y;
+	state.bg3x_l = BG3X_L;
+	state.bg3x_h = BG3X_H;
+	state.bg3y_l = BG3Y_L;
+	state.bg3y_h = BG3Y_H;
+	memcpy(state.io_registers, io_registers, sizeof(state.io_registers));
 
-#if !THREADED_RENDERER
-	RENDERER_BG2C = 0;
-#endif
 }
 
 template<int renderer_idx>
-static void mode5RenderLineNoWindow (void)
+static void gfxLoadLineState(const gfxLineState& state)
 {
 	INIT_RENDERER_CONTEXT(renderer_idx);
 
-#if !DEBUG_RENDERER_MODE5
-	return;
-#endif
-#ifdef REPORT_VIDEO_MODES
-	fprintf(stderr, "MODE 5: Render Line No Window\n");
-#endif
-	uint16_t* lineMix;
-	if (draw_right_screen == 0){
-		lineMix = GET_LINE_MIX_L;
-	} else {
-		lineMix = GET_LINE_MIX_R;	
+	renderer_ctx.renderfunc_mode = state.renderfunc_mode;
+	renderer_ctx.renderfunc_type = state.renderfunc_type;
+	renderer_ctx.renderfunc_layers = state.renderfunc_layers;
+	renderer_ctx.renderfunc_composite = gfxSelectComposite(state.renderfunc_mode, state.renderfunc_type,
+		state.renderfunc_layers, state.bldmod);
+	renderer_ctx.draw_objwin = state.draw_objwin != 0;
+	renderer_ctx.draw_sprites = state.draw_sprites != 0;
+	renderer_ctx.layers = state.layers;
+	renderer_ctx.mosaic = state.mosaic;
+	renderer_ctx.bldmod = state.bldmod;
+	renderer_ctx.colev = state.colev;
+	renderer_ctx.coly = state.coly;
+	if(renderer_ctx.blend_key != (state.colev | (state.coly << 16))) {
+		renderer_ctx.blend_key = state.colev | (state.coly << 16);
+		gfxBuildBlendTables(renderer_ctx.blend, state.colev, state.coly);
 	}
-	uint32_t background = RENDERER_BACKDROP;
+	renderer_ctx.vcount = state.vcount;
+	renderer_ctx.video_gen = state.video_gen;
+	renderer_ctx.bg2c = state.bg2c;
+	renderer_ctx.bg2x = state.bg2x;
+	renderer_ctx.bg2y = state.bg2y;
+	renderer_ctx.bg2x_l = state.bg2x_l;
+	renderer_ctx.bg2x_h = state.bg2x_h;
+	renderer_ctx.bg2y_l = state.bg2y_l;
+	renderer_ctx.bg2y_h = state.bg2y_h;
+	renderer_ctx.bg3c = state.bg3c;
+	renderer_ctx.bg3x = state.bg3x;
+	renderer_ctx.bg3y = state.bg3y;
+	renderer_ctx.bg3x_l = state.bg3x_l;
+	renderer_ctx.bg3x_h = state.bg3x_h;
+	renderer_ctx.bg3y_l = state.bg3y_l;
+	renderer_ctx.bg3y_h = state.bg3y_h;
+	memcpy(renderer_ctx.io_registers, state.io_registers, sizeof(state.io_registers));
+}
+
+#if !THREADED_RENDERER_DEFERRED
+typedef struct {
+	gfxLineState state;
+	int first_eye;
+	int last_eye;
+	int window_changed;
+	u32 window[2][GFX_WIN_WORDS];
+} gfxLineJob;
+
+static gfxLineJob threaded_renderer_jobs[THREADED_RENDERER_COUNT][THREADED_RENDERER_QUEUE_SIZE];
+
+static void gfxQueueLine(int idx, int first_eye, int last_eye)
+{
+	renderer_context& ctx = threaded_renderer_contexts[idx];
+	gfxLineJob& job = threaded_renderer_jobs[idx][THREADED_QUEUE_SLOT(ctx.queue_tail)];
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		gfxDrawRotScreen16Bit160<renderer_idx>(RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C);
+	gfxFillLineState(job.state);
+	job.first_eye = first_eye;
+	job.last_eye = last_eye;
+	job.window_changed = 0;
+	for(int u = 0; u < 2; ++u) {
+		if(ctx.gfxinwin_ver[u] < threaded_gfxinwin_ver[u]) {
+			ctx.gfxinwin_ver[u] = threaded_gfxinwin_ver[u];
+			job.window_changed |= 1 << u;
+#if HAVE_NEON
+			neon_memcpy(job.window[u], gfxInWin[u], sizeof(gfxInWin) / 2);
+#else
+			memcpy(job.window[u], gfxInWin[u], sizeof(gfxInWin) / 2);
+#endif
+		}
 	}
+}
 
-	for(int x = 0; x < 240; ++x) {
-		uint32_t color = background;
-		uint8_t top = SpecialEffectTarget_BD;
-
-		if(RENDERER_LINE[Layer_BG2][x] < background) {
-			color = RENDERER_LINE[Layer_BG2][x];
-			top = SpecialEffectTarget_BG2;
-		}
+template<int renderer_idx>
+static void gfxRenderQueuedLine(void)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
+	const gfxLineJob& job = threaded_renderer_jobs[renderer_idx][THREADED_QUEUE_SLOT(renderer_ctx.queue_head)];
 
-		if((uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(color >>24)) {
-			color = RENDERER_LINE[Layer_OBJ][x];
-			top = SpecialEffectTarget_OBJ;
-		}
+	gfxLoadLineState<renderer_idx>(job.state);
+	renderer_ctx.first_eye = job.first_eye;
+	renderer_ctx.last_eye = job.last_eye;
+	for(int u = 0; u < 2; ++u) {
+		if(job.window_changed & (1 << u))
+			memcpy(renderer_ctx.gfxInWin[u], job.window[u], sizeof(job.window[u]));
+	}
 
-		if(!(color & 0x00010000)) {
-			switch(RENDERER_R_BLDCNT_Color_Special_Effect)
-			{
-				case SpecialEffect_None:
-					break;
-				case SpecialEffect_Alpha_Blending:
-					if(RENDERER_R_BLDCNT_IsTarget1(top))
-					{
-						uint32_t back = background;
-						uint8_t top2 = SpecialEffectTarget_BD;
+	if(renderer_ctx.background_ver < job.state.background_ver) {
+		renderer_ctx.background_ver = job.state.background_ver;
+		if(!RENDERER_R_DISPCNT_Screen_Display_BG0)
+			gfxClearLineBuffer(renderer_ctx.line_buffer[Layer_BG0]);
+		if(!RENDERER_R_DISPCNT_Screen_Display_BG1)
+			gfxClearLineBuffer(renderer_ctx.line_buffer[Layer_BG1]);
+		if(!RENDERER_R_DISPCNT_Screen_Display_BG2)
+			gfxClearLineBuffer(renderer_ctx.line_buffer[Layer_BG2]);
+		if(!RENDERER_R_DISPCNT_Screen_Display_BG3)
+			gfxClearLineBuffer(renderer_ctx.line_buffer[Layer_BG3]);
+	}
 
-						if((top != SpecialEffectTarget_BG2) && RENDERER_LINE[Layer_BG2][x] < background) {
-							back = RENDERER_LINE[Layer_BG2][x];
-							top2 = SpecialEffectTarget_BG2;
-						}
+	gfxRenderStereoLine<renderer_idx>();
+}
+#endif
 
-						if((top != SpecialEffectTarget_OBJ) && (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_OBJ][x];
-							top2 = SpecialEffectTarget_OBJ;
-						}
+#endif
 
-						if(RENDERER_R_BLDCNT_IsTarget2(top2) && color < 0x80000000)
-						{
-							GFX_ALPHA_BLEND(color, back, coeff[COLEV & 0x1F], coeff[(COLEV >> 8) & 0x1F]);
-						}
+#if THREADED_RENDERER_DEFERRED
+/*
+Deferred renderer.
+
+postRender only logs a line: the registers the renderer reads, as changes
+against the line logged before it, and the copy-on-write pages written since
+then. At VBlank gfxDeferredRenderFrame hands every context a band of lines.
+A context replays the log up to its first line, copies the pages it ends up
+with into its own VRAM, OAM, palette and window masks, and from there on
+draws its lines one after another, patching in the pages each line changes.
+*/
 
-					}
-					break;
-				case SpecialEffect_Brightness_Increase:
-					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxIncreaseBrightness(color, coeff[COLY & 0x1F]);
-					break;
-				case SpecialEffect_Brightness_Decrease:
-					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxDecreaseBrightness(color, coeff[COLY & 0x1F]);
-					break;
-			}
-		} else {
-			// semi-transparent OBJ
-			uint32_t back = background;
-			uint8_t top2 = SpecialEffectTarget_BD;
+typedef struct {
+	bool logged;
+	u16 first_reg;
+	u16 reg_count;
+	u16 first_page;
+	u16 page_count;
+} gfxLogLine;
 
-			if(RENDERER_LINE[Layer_BG2][x] < back) {
-				back = RENDERER_LINE[Layer_BG2][x];
-				top2 = SpecialEffectTarget_BG2;
-			}
+typedef struct {
+	u16 word;
+	u32 value;
+} gfxLogReg;
+
+typedef struct {
+	u16 page;
+	u8 *data;
+} gfxLogPage;
+
+static bool gfxLogOpen = false;
+static gfxLineState gfxLogBase;
+static gfxLineState gfxLogLast;
+static u8 *gfxLogBasePages[GFX_PAGE_COUNT];
+static gfxLogLine gfxLogLines[160];
+static gfxLogReg gfxLogRegs[160 * GFX_STATE_WORDS];
+static gfxLogPage gfxLogPages[160 * GFX_PAGE_COUNT];
+static int gfxLogRegCount = 0;
+static int gfxLogPageCount = 0;
+
+static u8 *gfxPageSource(int page)
+{
+	if(page < GFX_PAGE_OAM)
+		return vram + (page << GFX_PAGE_SHIFT);
+	if(page == GFX_PAGE_OAM)
+		return oam;
+	if(page == GFX_PAGE_PALETTE)
+		return (u8 *)gfxPalette;
+	return (u8 *)gfxInWin;
+}
 
-			alpha_blend_brightness_switch();
+static void gfxLogRenderLine(void)
+{
+	gfxLineState state;
+	gfxFillLineState(state);
+
+	if(!gfxLogOpen) {
+		gfxLogOpen = true;
+		memset(gfxLogLines, 0, sizeof(gfxLogLines));
+		gfxLogRegCount = 0;
+		gfxLogPageCount = 0;
+		gfxLogBase = state;
+		gfxLogLast = state;
+		for(int page = 0; page < GFX_PAGE_COUNT; ++page) {
+			gfxLogBasePages[page] = gfxPageSource(page);
+			gfxPageSlot[page] = &gfxLogBasePages[page];
 		}
+		gfxPageWrittenCount = 0;
+	}
 
-		lineMix[x] = CONVERT_COLOR(color);
+	gfxLogLine& line = gfxLogLines[state.vcount];
+	line.logged = true;
+
+	const u32 *words = (const u32 *)&state;
+	const u32 *last = (const u32 *)&gfxLogLast;
+	line.first_reg = gfxLogRegCount;
+	for(u32 w = 0; w < GFX_STATE_WORDS; ++w) {
+		if(words[w] != last[w]) {
+			gfxLogRegs[gfxLogRegCount].word = w;
+			gfxLogRegs[gfxLogRegCount].value = words[w];
+			++gfxLogRegCount;
+		}
 	}
+	line.reg_count = gfxLogRegCount - line.first_reg;
+
+	// the written pages go back to live memory until they are written again
+	line.first_page = gfxLogPageCount;
+	for(int i = 0; i < gfxPageWrittenCount; ++i) {
+		int page = gfxPageWritten[i];
+		gfxLogPages[gfxLogPageCount].page = page;
+		gfxLogPages[gfxLogPageCount].data = gfxPageSource(page);
+		gfxPageSlot[page] = &gfxLogPages[gfxLogPageCount].data;
+		++gfxLogPageCount;
+	}
+	gfxPageWrittenCount = 0;
+	line.page_count = gfxLogPageCount - line.first_page;
 
-#if !THREADED_RENDERER
-	RENDERER_BG2C = 0;
-#endif
+	gfxLogLast = state;
 }
 
 template<int renderer_idx>
-static void mode5RenderLineAll (void)
+static void gfxLoadPage(int page, const u8 *data)
 {
 	INIT_RENDERER_CONTEXT(renderer_idx);
 
-#if !DEBUG_RENDERER_MODE5
-	return;
-#endif
-#ifdef REPORT_VIDEO_MODES
-	fprintf(stderr, "MODE 5: Render Line All\n");
-#endif
-	uint16_t* lineMix;
-	if (draw_right_screen == 0){
-		lineMix = GET_LINE_MIX_L;
+	if(page < GFX_PAGE_OAM) {
+		memcpy(renderer_ctx.vram + (page << GFX_PAGE_SHIFT), data, GFX_PAGE_SIZE);
+		memset(renderer_ctx.tile_dirty4 + (page << (GFX_PAGE_SHIFT - 5)), 1, GFX_PAGE_SIZE >> 5);
+		memset(renderer_ctx.tile_dirty8 + (page << (GFX_PAGE_SHIFT - 6)), 1, GFX_PAGE_SIZE >> 6);
+	} else if(page == GFX_PAGE_OAM) {
+		memcpy(renderer_ctx.oam, data, sizeof(renderer_ctx.oam));
+		renderer_ctx.oam_lines_ver = 0;
+	} else if(page == GFX_PAGE_PALETTE) {
+		memcpy(renderer_ctx.palette, data, sizeof(renderer_ctx.palette));
 	} else {
-		lineMix = GET_LINE_MIX_R;	
+		memcpy(renderer_ctx.gfxInWin, data, sizeof(renderer_ctx.gfxInWin));
 	}
-	uint32_t background = RENDERER_BACKDROP;
+}
 
-	if(RENDERER_R_DISPCNT_Screen_Display_BG2) {
-		gfxDrawRotScreen16Bit160<renderer_idx>(RENDERER_BG2X, RENDERER_BG2Y, RENDERER_BG2C);
-	}
+template<int renderer_idx>
+static void gfxDeferredRenderBand(void)
+{
+	INIT_RENDERER_CONTEXT(renderer_idx);
 
-	bool inWindow0 = false;
-	bool inWindow1 = false;
+	gfxLineState state = gfxLogBase;
+	u8 *pages[GFX_PAGE_COUNT];
+	memcpy(pages, gfxLogBasePages, sizeof(pages));
 
-	if(RENDERER_R_DISPCNT_Window_0_Display)
-	{
-		uint8_t v0 = RENDERER_R_WIN_Window0_Y1;
-		uint8_t v1 = RENDERER_R_WIN_Window0_Y2;
-		inWindow0 = (uint8_t)(RENDERER_R_VCOUNT - v0) < (uint8_t)(v1 - v0) || ((v0 == v1) && (v0 >= 0xe8));
-	}
+	renderer_ctx.first_eye = 0;
+	renderer_ctx.last_eye = stereo_views - 1;
 
-	if(RENDERER_R_DISPCNT_Window_1_Display)
-	{
-		uint8_t v0 = RENDERER_R_WIN_Window1_Y1;
-		uint8_t v1 = RENDERER_R_WIN_Window1_Y2;
-		inWindow1 = (uint8_t)(RENDERER_R_VCOUNT - v0) < (uint8_t)(v1 - v0) || ((v0 == v1) && (v0 >= 0xe8));
-	}
+	// sprite depths are taken once per frame, from the OAM of its first line
+	memcpy(renderer_ctx.oam, pages[GFX_PAGE_OAM], sizeof(renderer_ctx.oam));
+	gfxUpdateOBJParallax<renderer_idx>();
+	RENDERER_OBJ_PARALLAX_VCOUNT = -1;
 
-	uint8_t inWin0Mask = RENDERER_R_WIN_Window0_Mask;
-	uint8_t inWin1Mask = RENDERER_R_WIN_Window1_Mask;
-	uint8_t outMask = RENDERER_R_WIN_Outside_Mask;
+	bool loaded = false;
+	for(int y = 0; y <= renderer_ctx.last_line; ++y) {
+		const gfxLogLine& line = gfxLogLines[y];
+		if(!line.logged)
+			continue;
 
-	for(int x = 0; x < 240; ++x) {
-		uint32_t color = background;
-		uint8_t top = SpecialEffectTarget_BD;
-		uint8_t mask = outMask;
+		u32 *words = (u32 *)&state;
+		for(int i = line.first_reg; i < line.first_reg + line.reg_count; ++i)
+			words[gfxLogRegs[i].word] = gfxLogRegs[i].value;
 
-		if(!(RENDERER_LINE[Layer_WIN_OBJ][x] & 0x80000000)) {
-			mask = RENDERER_R_WIN_OBJ_Mask;
+		for(int i = line.first_page; i < line.first_page + line.page_count; ++i) {
+			if(loaded)
+				gfxLoadPage<renderer_idx>(gfxLogPages[i].page, gfxLogPages[i].data);
+			else
+				pages[gfxLogPages[i].page] = gfxLogPages[i].data;
 		}
 
-		mask = SELECT(inWindow1 && RENDERER_GFX_IN_WIN[1][x], inWin1Mask, mask);
-		mask = SELECT(inWindow0 && RENDERER_GFX_IN_WIN[0][x], inWin0Mask, mask);
-
-		if((mask & LayerMask_BG2) && (RENDERER_LINE[Layer_BG2][x] < background)) {
-			color = RENDERER_LINE[Layer_BG2][x];
-			top = SpecialEffectTarget_BG2;
-		}
+		if(y < renderer_ctx.first_line)
+			continue;
 
-		if((mask & LayerMask_OBJ) && ((uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(color >>24))) {
-			color = RENDERER_LINE[Layer_OBJ][x];
-			top = SpecialEffectTarget_OBJ;
+		gfxLoadLineState<renderer_idx>(state);
+		if(!loaded) {
+			for(int page = 0; page < GFX_PAGE_COUNT; ++page)
+				gfxLoadPage<renderer_idx>(page, pages[page]);
 		}
 
-		if(color & 0x00010000) {
-			// semi-transparent OBJ
-			uint32_t back = background;
-			uint8_t top2 = SpecialEffectTarget_BD;
-
-			if((mask & LayerMask_BG2) && RENDERER_LINE[Layer_BG2][x] < back) {
-				back = RENDERER_LINE[Layer_BG2][x];
-				top2 = SpecialEffectTarget_BG2;
-			}
-
-			alpha_blend_brightness_switch();
-		} else if(mask & LayerMask_SFX) {
-			switch(RENDERER_R_BLDCNT_Color_Special_Effect)
-			{
-				case SpecialEffect_None:
-					break;
-				case SpecialEffect_Alpha_Blending:
-					if(RENDERER_R_BLDCNT_IsTarget1(top))
-					{
-						uint32_t back = background;
-						uint8_t top2 = SpecialEffectTarget_BD;
-
-						if((mask & LayerMask_BG2) && (top != SpecialEffectTarget_BG2) && (RENDERER_LINE[Layer_BG2][x] < background)) {
-							back = RENDERER_LINE[Layer_BG2][x];
-							top2 = SpecialEffectTarget_BG2;
-						}
-
-						if((mask & LayerMask_OBJ) && (top != SpecialEffectTarget_OBJ) && (uint8_t)(RENDERER_LINE[Layer_OBJ][x]>>24) < (uint8_t)(back >> 24)) {
-							back = RENDERER_LINE[Layer_OBJ][x];
-							top2 = SpecialEffectTarget_OBJ;
-						}
-
-						if(RENDERER_R_BLDCNT_IsTarget2(top2) && color < 0x80000000)
-						{
-							GFX_ALPHA_BLEND(color, back, coeff[COLEV & 0x1F], coeff[(COLEV >> 8) & 0x1F]);
-						}
-					}
-					break;
-				case SpecialEffect_Brightness_Increase:
-					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxIncreaseBrightness(color, coeff[COLY & 0x1F]);
-					break;
-				case SpecialEffect_Brightness_Decrease:
-					if(RENDERER_R_BLDCNT_IsTarget1(top))
-						color = gfxDecreaseBrightness(color, coeff[COLY & 0x1F]);
-					break;
-			}
+		if(!loaded || renderer_ctx.background_ver != state.background_ver) {
+			renderer_ctx.background_ver = state.background_ver;
+			if(!RENDERER_R_DISPCNT_Screen_Display_BG0)
+				gfxClearLineBuffer(renderer_ctx.line_buffer[Layer_BG0]);
+			if(!RENDERER_R_DISPCNT_Screen_Display_BG1)
+				gfxClearLineBuffer(renderer_ctx.line_buffer[Layer_BG1]);
+			if(!RENDERER_R_DISPCNT_Screen_Display_BG2)
+				gfxClearLineBuffer(renderer_ctx.line_buffer[Layer_BG2]);
+			if(!RENDERER_R_DISPCNT_Screen_Display_BG3)
+				gfxClearLineBuffer(renderer_ctx.line_buffer[Layer_BG3]);
 		}
+		loaded = true;
 
-		lineMix[x] = CONVERT_COLOR(color);
+		gfxRenderStereoLine<renderer_idx>();
 	}
-
-#if !THREADED_RENDERER
-	RENDERER_BG2C = 0;
-#endif
 }
 
-#if THREADED_RENDERER
-#define threaded_renderer_loop_impl() \
-do { \
-	if(renderer_ctx.renderer_state == 0) continue; \
-	\
-	if(renderer_ctx.background_ver < threaded_background_ver) { \
-		renderer_ctx.background_ver = threaded_background_ver; \
-		if(!RENDERER_R_DISPCNT_Screen_Display_BG0) \
-			memset(renderer_ctx.line[Layer_BG0], -1, 240 * sizeof(u32)); \
-		if(!RENDERER_R_DISPCNT_Screen_Display_BG1) \
-			memset(renderer_ctx.line[Layer_BG1], -1, 240 * sizeof(u32)); \
-		if(!RENDERER_R_DISPCNT_Screen_Display_BG2) \
-			memset(renderer_ctx.line[Layer_BG2], -1, 240 * sizeof(u32)); \
-		if(!RENDERER_R_DISPCNT_Screen_Display_BG3) \
-			memset(renderer_ctx.line[Layer_BG3], -1, 240 * sizeof(u32)); \
-	} \
-	\
-	memset(RENDERER_LINE[Layer_OBJ], -1, 240 * sizeof(u32)); \
-	if(renderer_ctx.draw_sprites) (*drawSprites)(); \
-	\
-	if(renderer_ctx.renderfunc_type == 2) { \
-		memset(RENDERER_LINE[Layer_WIN_OBJ], -1, 240 * sizeof(u32)); \
-		if(renderer_ctx.draw_objwin) (*drawOBJWin)(); \
-	} \
-	\
-	(*getRenderFunc)(renderer_ctx.renderfunc_mode, renderer_ctx.renderfunc_type)(); \
-	\
-	renderer_ctx.renderer_state = 0;\
-} while (0)
-
-static void threaded_renderer_loop0(void* p) {
-	int renderer_idx = 0;
-	INIT_RENDERER_CONTEXT(renderer_idx);
-
-	renderfunc_t drawSprites = gfxDrawSprites<0>;
-	renderfunc_t drawOBJWin = gfxDrawOBJWin<0>;
-	renderfunc_t (*getRenderFunc)(int, int) = GetRenderFunc<0>;
+static void gfxDeferredRenderFrame(void)
+{
+	if(!gfxLogOpen)
+		return;
 
-	while(renderer_ctx.renderer_control == 1) {
-		if(threaded_renderer_ready) {
-			threaded_renderer_ready = 0;
-			systemDrawScreen();
-			
-		    
-		}
-		threaded_renderer_loop_impl();
+	for(int u = 0; u < THREADED_RENDERER_COUNT; ++u) {
+		threaded_renderer_contexts[u].first_line = 160 * u / THREADED_RENDERER_COUNT;
+		threaded_renderer_contexts[u].last_line = 160 * (u + 1) / THREADED_RENDERER_COUNT - 1;
 	}
 
-	renderer_ctx.renderer_control = 0; //loop is terminated.
+	for(int u = 0; u < THREADED_RENDERER_COUNT; ++u)
+		threaded_queue_push(threaded_renderer_contexts[u]);
+	for(int u = 0; u < THREADED_RENDERER_COUNT; ++u)
+		threaded_queue_wait(threaded_renderer_contexts[u], 0);
+
+	for(int page = 0; page < GFX_PAGE_COUNT; ++page)
+		gfxPageSlot[page] = NULL;
+	gfxPageWrittenCount = 0;
+	gfxPagePoolUsed = 0;
+	gfxLogOpen = false;
 }
+#endif
 
+#if THREADED_RENDERER
 static void threaded_renderer_loop(void* p) {
 	int renderer_idx = reinterpret_cast<intptr_t>(p);
 	INIT_RENDERER_CONTEXT(renderer_idx);
 
-	renderfunc_t drawSprites = NULL;
-	renderfunc_t drawOBJWin = NULL;
-	renderfunc_t (*getRenderFunc)(int, int) = NULL;
+	renderfunc_t renderLine = NULL;
 
+#if THREADED_RENDERER_DEFERRED
+	switch(renderer_idx) {
+	case 0:
+		renderLine = gfxDeferredRenderBand<0>;
+		break;
+	case 1:
+		renderLine = gfxDeferredRenderBand<1>;
+		break;
+#if THREADED_RENDERER_COUNT > 2
+	case 2:
+		renderLine = gfxDeferredRenderBand<2>;
+		break;
+#endif
+#if THREADED_RENDERER_COUNT > 3
+	case 3:
+		renderLine = gfxDeferredRenderBand<3>;
+		break;
+#endif
+	default:
+		return;
+	}
+
+#else
 	switch(renderer_idx) {
+	case 0:
+		renderLine = gfxRenderQueuedLine<0>;
+		break;
 	case 1:
-		drawSprites = gfxDrawSprites<1>;
-		drawOBJWin = gfxDrawOBJWin<1>;
-		getRenderFunc = GetRenderFunc<1>;
+		renderLine = gfxRenderQueuedLine<1>;
 		break;
+#if THREADED_RENDERER_COUNT > 2
 	case 2:
-		drawSprites = gfxDrawSprites<2>;
-		drawOBJWin = gfxDrawOBJWin<2>;
-		getRenderFunc = GetRenderFunc<2>;
+		renderLine = gfxRenderQueuedLine<2>;
 		break;
+#endif
+#if THREADED_RENDERER_COUNT > 3
 	case 3:
-		drawSprites = gfxDrawSprites<3>;
-		drawOBJWin = gfxDrawOBJWin<3>;
-		getRenderFunc = GetRenderFunc<3>;
+		renderLine = gfxRenderQueuedLine<3>;
 		break;
+#endif
 	default:
 		return;
 	}
 
-	while(renderer_ctx.renderer_control == 1) {		
-		threaded_renderer_loop_impl();
+#endif
+
+	while(threaded_queue_next(renderer_ctx)) {
+		(*renderLine)();
+		threaded_queue_pop(renderer_ctx);
 	}
 
-	renderer_ctx.renderer_control = 0; //loop is terminated.
+	thread_store_release(&renderer_ctx.renderer_control, 0); //loop is terminated.
 }
 
 static void fetchBackgroundOffset(int video_mode) {
@@ -11621,132 +13676,50 @@ static void fetchBackgroundOffset(int video_mode) {
 static void postRender() {
 	
 	int video_mode = R_DISPCNT_Video_Mode;
-	bool draw_objwin = (graphics.layerEnable & 0x9000) == 0x9000;
-	bool draw_sprites = R_DISPCNT_Screen_Display_OBJ;
 
+#if THREADED_RENDERER_DEFERRED
+	gfxLogRenderLine();
+#else
+#if THREADED_RENDERER_SPLIT_EYES
+	int first = 0;
+	int count = (stereo_views < 2) ? 1 : 2;
+	int views[2][2] = { { 0, stereo_views / 2 - 1 }, { stereo_views / 2, stereo_views - 1 } };
+	if(count == 1)
+		views[0][1] = 0;
+#else
+	int first = threaded_renderer_idx;
+	int count = 1;
+#endif
+
+	for(int u = first; u < first + count; ++u) {
 #if DEBUG_RENDERER_NOSYNC
-	if (threaded_renderer_contexts[threaded_renderer_idx].renderer_state) return;
+		if (THREADED_QUEUE_PENDING(threaded_renderer_contexts[u]) == THREADED_RENDERER_QUEUE_SIZE) return;
 #else
-	while(threaded_renderer_contexts[threaded_renderer_idx].renderer_state);
-#endif
-
-	INIT_RENDERER_CONTEXT(threaded_renderer_idx);
-
-	renderer_ctx.renderfunc_mode = renderfunc_mode;
-	renderer_ctx.renderfunc_type = renderfunc_type;
-	renderer_ctx.draw_objwin = draw_objwin;
-	renderer_ctx.draw_sprites = draw_sprites;
-	renderer_ctx.layers = graphics.layerEnable;
-	renderer_ctx.mosaic = MOSAIC;
-	renderer_ctx.bldmod = BLDMOD;
-	renderer_ctx.vcount = io_registers[REG_VCOUNT];
-
-	renderer_ctx.io_registers[REG_DISPCNT] = io_registers[REG_DISPCNT];
-	renderer_ctx.io_registers[REG_DISPSTAT] = io_registers[REG_DISPSTAT];
-	renderer_ctx.io_registers[REG_VCOUNT] = io_registers[REG_VCOUNT];
-
-	renderer_ctx.io_registers[REG_BG0CNT] = io_registers[REG_BG0CNT];
-	renderer_ctx.io_registers[REG_BG1CNT] = io_registers[REG_BG1CNT];
-	renderer_ctx.io_registers[REG_BG2CNT] = io_registers[REG_BG2CNT];
-	renderer_ctx.io_registers[REG_BG3CNT] = io_registers[REG_BG3CNT];
-
-	renderer_ctx.io_registers[REG_BG0HOFS] = io_registers[REG_BG0HOFS];
-	renderer_ctx.io_registers[REG_BG1HOFS] = io_registers[REG_BG1HOFS];
-	renderer_ctx.io_registers[REG_BG2HOFS] = io_registers[REG_BG2HOFS];
-	renderer_ctx.io_registers[REG_BG3HOFS] = io_registers[REG_BG3HOFS];
-	renderer_ctx.io_registers[REG_BG0VOFS] = io_registers[REG_BG0VOFS];
-	renderer_ctx.io_registers[REG_BG1VOFS] = io_registers[REG_BG1VOFS];
-	renderer_ctx.io_registers[REG_BG2VOFS] = io_registers[REG_BG2VOFS];
-	renderer_ctx.io_registers[REG_BG3VOFS] = io_registers[REG_BG3VOFS];
-
-	renderer_ctx.io_registers[REG_BG2PA] = io_registers[REG_BG2PA];
-	renderer_ctx.io_registers[REG_BG2PB] = io_registers[REG_BG2PB];
-	renderer_ctx.io_registers[REG_BG2PC] = io_registers[REG_BG2PC];
-	renderer_ctx.io_registers[REG_BG2PD] = io_registers[REG_BG2PD];
-	renderer_ctx.io_registers[REG_BG3PA] = io_registers[REG_BG3PA];
-	renderer_ctx.io_registers[REG_BG3PB] = io_registers[REG_BG3PB];
-	renderer_ctx.io_registers[REG_BG3PC] = io_registers[REG_BG3PC];
-	renderer_ctx.io_registers[REG_BG3PD] = io_registers[REG_BG3PD];
-
-	renderer_ctx.io_registers[REG_BG2X_L] = io_registers[REG_BG2X_L];
-	renderer_ctx.io_registers[REG_BG2X_H] = io_registers[REG_BG2X_H];
-	renderer_ctx.io_registers[REG_BG2Y_L] = io_registers[REG_BG2Y_L];
-	renderer_ctx.io_registers[REG_BG2Y_H] = io_registers[REG_BG2Y_H];
-	renderer_ctx.io_registers[REG_BG3X_L] = io_registers[REG_BG3X_L];
-	renderer_ctx.io_registers[REG_BG3X_H] = io_registers[REG_BG3X_H];
-	renderer_ctx.io_registers[REG_BG3Y_L] = io_registers[REG_BG3Y_L];
-	renderer_ctx.io_registers[REG_BG3Y_H] = io_registers[REG_BG3Y_H];
-
-	renderer_ctx.io_registers[REG_WIN0H] = io_registers[REG_WIN0H];
-	renderer_ctx.io_registers[REG_WIN1H] = io_registers[REG_WIN1H];
-	renderer_ctx.io_registers[REG_WIN0V] = io_registers[REG_WIN0V];
-	renderer_ctx.io_registers[REG_WIN1V] = io_registers[REG_WIN1V];
-	renderer_ctx.io_registers[REG_WININ] = io_registers[REG_WININ];
-	renderer_ctx.io_registers[REG_WINOUT] = io_registers[REG_WINOUT];
-
-	renderer_ctx.io_registers[REG_BLDCNT] = io_registers[REG_BLDCNT];
-	renderer_ctx.io_registers[REG_BLDALPHA] = io_registers[REG_BLDALPHA];
-	renderer_ctx.io_registers[REG_BLDY] = io_registers[REG_BLDY];
-
-	renderer_ctx.io_registers[REG_TM0D] = io_registers[REG_TM0D];
-	renderer_ctx.io_registers[REG_TM1D] = io_registers[REG_TM1D];
-	renderer_ctx.io_registers[REG_TM2D] = io_registers[REG_TM2D];
-	renderer_ctx.io_registers[REG_TM3D] = io_registers[REG_TM3D];
-
-	renderer_ctx.io_registers[REG_TM0CNT] = io_registers[REG_TM0CNT];
-	renderer_ctx.io_registers[REG_TM1CNT] = io_registers[REG_TM1CNT];
-	renderer_ctx.io_registers[REG_TM2CNT] = io_registers[REG_TM2CNT];
-	renderer_ctx.io_registers[REG_TM3CNT] = io_registers[REG_TM3CNT];
-
-	renderer_ctx.io_registers[REG_P1] = io_registers[REG_P1];
-	renderer_ctx.io_registers[REG_P1CNT] = io_registers[REG_P1CNT];
-	renderer_ctx.io_registers[REG_RCNT] = io_registers[REG_RCNT];
-	renderer_ctx.io_registers[REG_IE] = io_registers[REG_IE];
-	renderer_ctx.io_registers[REG_IF] = io_registers[REG_IF];
-	renderer_ctx.io_registers[REG_IME] = io_registers[REG_IME];
-	renderer_ctx.io_registers[REG_HALTCNT] = io_registers[REG_HALTCNT];
-
-	renderer_ctx.bg2c = gfxBG2Changed;	
-	renderer_ctx.bg2x = gfxBG2X;
-	renderer_ctx.bg2y = gfxBG2Y;
-	renderer_ctx.bg2x_l = BG2X_L;
-	renderer_ctx.bg2x_h = BG2X_H;
-	renderer_ctx.bg2y_l = BG2Y_L;
-	renderer_ctx.bg2y_h = BG2Y_H;
-
-	if(video_mode == 2) {
-		renderer_ctx.bg3c = gfxBG3Changed;
-		renderer_ctx.bg3x = gfxBG3X;
-		renderer_ctx.bg3y = gfxBG3Y;
-		renderer_ctx.bg3x_l = BG3X_L;
-		renderer_ctx.bg3x_h = BG3X_H;
-		renderer_ctx.bg3y_l = BG3Y_L;
-		renderer_ctx.bg3y_h = BG3Y_H;
+		threaded_queue_wait(threaded_renderer_contexts[u], THREADED_RENDERER_QUEUE_SIZE - 1);
+#endif
 	}
 
-	for(int u = 0; u < 2; ++u) {
-		if(renderer_ctx.gfxinwin_ver[u] < threaded_gfxinwin_ver[u]) {
-			renderer_ctx.gfxinwin_ver[u] = threaded_gfxinwin_ver[u];
-#if HAVE_NEON
-			neon_memcpy(renderer_ctx.gfxInWin[u], gfxInWin[u], sizeof(gfxInWin) / 2);
+	for(int u = first; u < first + count; ++u) {
+#if THREADED_RENDERER_SPLIT_EYES
+		gfxQueueLine(u, views[u][0], views[u][1]);
 #else
-			memcpy(renderer_ctx.gfxInWin[u], gfxInWin[u], sizeof(gfxInWin) / 2);
+		gfxQueueLine(u, 0, stereo_views - 1);
 #endif
-		}
 	}
+#endif
 
 	fetchBackgroundOffset(video_mode);
 
 	gfxBG2Changed = 0;
 	if(video_mode == 2)	gfxBG3Changed = 0;
 
-	//buffer is ready.
-	renderer_ctx.renderer_state = 1;
-
-	//notify screen is done.
-	if(renderer_ctx.vcount == 159) threaded_renderer_ready = 1;
+#if !THREADED_RENDERER_DEFERRED
+	//buffers are ready.
+	for(int u = first; u < first + count; ++u)
+		threaded_queue_push(threaded_renderer_contexts[u]);
 
 	threaded_renderer_idx = (threaded_renderer_idx + 1) % THREADED_RENDERER_COUNT;
+#endif
 }
 
 #endif
@@ -11759,6 +13732,8 @@ static void postRender() {
       	renderfunc_type = 1; \
     else \
       	renderfunc_type = 2; \
+    renderfunc_layers = (R_DISPCNT_Video_Mode <= 5) ? (gfxModeLayers[R_DISPCNT_Video_Mode] & (io_registers[REG_DISPCNT] >> 8)) : 0; \
+    renderfunc_composite = gfxSelectComposite(renderfunc_mode, renderfunc_type, renderfunc_layers, BLDMOD); \
 }
 
 template<int renderer_idx>
@@ -11818,11 +13793,13 @@ bool CPUReadState(const uint8_t* data, unsigned size)
 
 	utilReadMem(internalRAM, data, 0x8000);
 	utilReadMem(paletteRAM, data, 0x400);
+	gfxUpdateAllPalette();
 	utilReadMem(workRAM, data, 0x40000);
 	utilReadMem(vram, data, 0x20000);
+	gfxInvalidateAllTiles();
 	utilReadMem(oam, data, 0x400);
-	utilReadMem(pix[0], data, 4 * PIX_BUFFER_SCREEN_WIDTH * 160);
-	utilReadMem(pix[1], data, 4 * PIX_BUFFER_SCREEN_WIDTH * 160);
+	oamVersion++;
+	utilReadMem(fix, data, 4 * PIX_BUFFER_SCREEN_WIDTH * 160);
 	utilReadMem(ioMem, data, 0x400);
 
 	eepromReadGameMem(data, version);
@@ -11837,14 +13814,15 @@ bool CPUReadState(const uint8_t* data, unsigned size)
 	CPUUpdateRender();
 
 #if !THREADED_RENDERER
-	memset(line[Layer_BG0], -1, 240 * sizeof(u32));
-	memset(line[Layer_BG1], -1, 240 * sizeof(u32));
-	memset(line[Layer_BG2], -1, 240 * sizeof(u32));
-	memset(line[Layer_BG3], -1, 240 * sizeof(u32));
+	gfxClearLineBuffer(line_buffer[Layer_BG0]);
+	gfxClearLineBuffer(line_buffer[Layer_BG1]);
+	gfxClearLineBuffer(line_buffer[Layer_BG2]);
+	gfxClearLineBuffer(line_buffer[Layer_BG3]);
 #endif
 
 	CPUUpdateWindow0();
 	CPUUpdateWindow1();
+	gfxUpdateBlendTables();
 	gbaSaveType = 0;
 	switch(saveType) {
 		case 0:
@@ -12271,13 +14249,13 @@ void CPUUpdateRegister(uint32_t address, uint16_t value)
 					++threaded_background_ver;
 #else
 					if(!R_DISPCNT_Screen_Display_BG0)
-						memset(line[Layer_BG0], -1, 240 * sizeof(u32));
+						gfxClearLineBuffer(line_buffer[Layer_BG0]);
 					if(!R_DISPCNT_Screen_Display_BG1)
-						memset(line[Layer_BG1], -1, 240 * sizeof(u32));
+						gfxClearLineBuffer(line_buffer[Layer_BG1]);
 					if(!R_DISPCNT_Screen_Display_BG2)
-						memset(line[Layer_BG2], -1, 240 * sizeof(u32));
+						gfxClearLineBuffer(line_buffer[Layer_BG2]);
 					if(!R_DISPCNT_Screen_Display_BG3)
-						memset(line[Layer_BG3], -1, 240 * sizeof(u32));
+						gfxClearLineBuffer(line_buffer[Layer_BG3]);
 #endif
 				}
 				break;
@@ -12397,10 +14375,12 @@ void CPUUpdateRegister(uint32_t address, uint16_t value)
 		case 0x52:
 			COLEV = value & 0x1F1F;
 			UPDATE_REG(0x52, COLEV);
+			gfxUpdateBlendTables();
 			break;
 		case 0x54:
 			COLY = value & 0x1F;
 			UPDATE_REG(0x54, COLY);
+			gfxUpdateBlendTables();
 			break;
 		case 0x60:
 		case 0x62:
@@ -12783,6 +14763,8 @@ void CPUInit(const char *biosFileName, bool useBiosFile)
 		*((uint16_t *)&rom[0x1fe209e]) = 0x4770; // BX LR
 	}
 
+	gfxSelectCompositor();
+
 	graphics.layerEnable = 0xff00;
 	graphics.layerEnableDelay = 1;
 	io_registers[REG_DISPCNT] = 0x0080;
@@ -12841,11 +14823,13 @@ void CPUReset (void)
 #endif
 	memset(&bus.reg[0], 0, sizeof(bus.reg));	// clean registers
 	memset(oam, 0, 0x400);				// clean OAM
+	oamVersion++;
 	memset(paletteRAM, 0, 0x400);		// clean palette
-	memset(pix[0], 0, 4 * 160 * 240);		// clean picture
-	memset(pix[1], 0, 4 * 160 * 240);		// clean picture
-	memset(fix, 0, 4 * 160 * (240*2));		// clean picture
+	gfxUpdateAllPalette();
+	memset(fix, 0, 4 * PIX_BUFFER_SCREEN_WIDTH * 160);		// clean picture
+	memset(view_pix, 0, (MAX_STEREO_VIEWS - 2) * 240 * 160 * sizeof(uint16_t));
 	memset(vram, 0, 0x20000);			// clean vram
+	gfxInvalidateAllTiles();
 	memset(ioMem, 0, 0x400);			// clean io memory
 
 	io_registers[REG_DISPCNT]  = 0x0080;
@@ -13015,11 +14999,13 @@ void CPUReset (void)
 	saveType = 0;
 	graphics.layerEnable = io_registers[REG_DISPCNT];
 
+	CPUUpdateRender();
+
 #if !THREADED_RENDERER
-	memset(line[Layer_BG0], -1, 240 * sizeof(u32));
-	memset(line[Layer_BG1], -1, 240 * sizeof(u32));
-	memset(line[Layer_BG2], -1, 240 * sizeof(u32));
-	memset(line[Layer_BG3], -1, 240 * sizeof(u32));
+	gfxClearLineBuffer(line_buffer[Layer_BG0]);
+	gfxClearLineBuffer(line_buffer[Layer_BG1]);
+	gfxClearLineBuffer(line_buffer[Layer_BG2]);
+	gfxClearLineBuffer(line_buffer[Layer_BG3]);
 #endif
 
 	for(int i = 0; i < 256; i++) {
@@ -13059,6 +15045,7 @@ void CPUReset (void)
 
 	CPUUpdateWindow0();
 	CPUUpdateWindow1();
+	gfxUpdateBlendTables();
 
 	// make sure registers are correctly initialized if not using BIOS
 	if(cpuIsMultiBoot) 
@@ -13300,12 +15287,10 @@ updateLoop:
 		            	}
 		            	CPUCheckDMA(1, 0x0f);
 
-#if !THREADED_RENDERER
-		            	systemDrawScreen();
-		            	
-		            	
-
+#if THREADED_RENDERER
+		            	ThreadedRendererSync();
 #endif
+		            	systemDrawScreen();
 
 #if USE_FRAME_SKIP
 						++fs_count;
@@ -13333,49 +15318,8 @@ updateLoop:
 #endif
 #if THREADED_RENDERER
 						postRender();
-#else					
-						bool draw_objwin = (graphics.layerEnable & 0x9000) == 0x9000;
-						bool draw_sprites = R_DISPCNT_Screen_Display_OBJ;
-						draw_right_screen = 0;
-						memset(RENDERER_LINE[Layer_OBJ], -1, 240 * sizeof(u32));	// erase all sprites
-						
-						if(draw_sprites) {
-							
-							gfxDrawSprites<0>();
-							
-						}
-						if(renderfunc_type == 2) {
-							
-							memset(RENDERER_LINE[Layer_WIN_OBJ], -1, 240 * sizeof(u32));	// erase all OBJ Win 
-							
-							if(draw_objwin) {
-								
-								gfxDrawOBJWin<0>();
-							}
-						}
-						draw_right_screen = 0;
-						GetRenderFunc<0>(renderfunc_mode, renderfunc_type)();
-						
-						draw_objwin = (graphics.layerEnable & 0x9000) == 0x9000;
-						draw_sprites = R_DISPCNT_Screen_Display_OBJ;
-						
-						draw_right_screen = 1;
-						memset(RENDERER_LINE[Layer_OBJ], -1, 240 * sizeof(u32));	// erase all sprites
-						if(draw_sprites) {
-							
-							gfxDrawSprites<0>();
-						}
-						if(renderfunc_type == 2) {
-							
-							memset(RENDERER_LINE[Layer_WIN_OBJ], -1, 240 * sizeof(u32));	// erase all OBJ Win 
-							if(draw_objwin) {
-								
-								gfxDrawOBJWin<0>();
-							}
-						}
-						
-						draw_right_screen = 1;
-						GetRenderFunc<0>(renderfunc_mode, renderfunc_type)();
+#else
+						gfxRenderStereoLine<0>();
 #endif
 #if USE_FRAME_SKIP					
 					}
@@ -96,6 +96,11 @@ typedef struct
 
 extern uint64_t joy;
 
+/* Depth of every pixel of the left eye, 240x160 bytes. Bits 0-1 hold the
+ * priority of the visible layer (0 is nearest, the backdrop reports 3) and
+ * bits 4-6 the layer itself: 0-3 for BG0-BG3, 4 for OBJ, 5 for backdrop. */
+extern uint8_t depth_plane[240 * 160];
+
 extern int draw_right_screen;
 
 extern void (*cpuSaveGameFunc)(uint32_t,uint8_t);
@@ -118,6 +123,8 @@ extern void CPUCheckDMA(int,int);
 extern void SetFrameskip(int);
 #endif
 extern void SetParallax(int);
+extern void SetStereoViews(int);
+extern void SetDepthPlane(bool);
 #if THREADED_RENDERER
 extern void ThreadedRendererStart();
 extern void ThreadedRendererStop();
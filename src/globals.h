@@ -10,7 +10,12 @@
 	#define USE_TWEAK_MEMFUNC 1
 #endif
 
-#define PIX_BUFFER_SCREEN_WIDTH 256
+// pitch, in pixels, of the side-by-side frame both eyes are rendered into
+#define PIX_BUFFER_SCREEN_WIDTH 512
+
+// views 0 and 1 go to the side-by-side frame, the others to view_pix as
+// consecutive 240x160 frames
+#define MAX_STEREO_VIEWS 8
 
 extern int saveType;
 extern bool useBios;
@@ -26,8 +31,8 @@ extern int cpuDmaCount;
 extern uint8_t *rom;
 extern uint8_t *bios;
 extern uint8_t *vram;
-extern uint16_t *pix[2];
 extern uint16_t *fix;
+extern uint16_t *view_pix;
 extern uint8_t *oam;
 extern uint8_t *ioMem;
 extern uint8_t *internalRAM;
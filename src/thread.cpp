@@ -1,9 +1,17 @@
 #include <stdint.h>
+#include <stdlib.h>
 #include <retro_miscellaneous.h>
 #include "thread.h"
 
 #ifdef THREADED_RENDERER
 
+#if defined(_MSC_VER)
+	#include <windows.h>
+	void thread_memory_barrier() { MemoryBarrier(); }
+#else
+	void thread_memory_barrier() { __sync_synchronize(); }
+#endif
+
 #if VITA
 	#include <psp2/kernel/threadmgr.h>
 
@@ -43,34 +51,51 @@
 	}
 	
 	thread_t thread_get() { return sceKernelGetThreadId(); }	
+	thread_sem_t thread_sem_new(int value) { return sceKernelCreateSema("my_sema", 0, value, 0x7FFFFFFF, NULL); }
+	void thread_sem_free(thread_sem_t sem) { sceKernelDeleteSema(sem); }
+	void thread_sem_wait(thread_sem_t sem) { sceKernelWaitSema(sem, 1, NULL); }
+	void thread_sem_signal(thread_sem_t sem) { sceKernelSignalSema(sem, 1); }
 	void thread_sleep(int ms) { sceKernelDelayThread(ms * 1000); } //retro_sleep causes crash
 	void thread_set_priority(thread_t id, int priority) { sceKernelChangeThreadPriority(id, 0xFF & _thread_map_priority(priority)); }
 
 #else //non-vita
 
 	#include <rthreads/rthreads.h>
+	#include <rthreads/rsemaphore.h>
 
 	static void _thread_func(void* p)
 	{
 		void** argp = static_cast<void**>(p);
 		threadfunc_t func = reinterpret_cast<threadfunc_t>(argp[0]);
-		(*func)(argp[1]);
+		void* arg = argp[1];
+		free(argp);
+		(*func)(arg);
 	}
 
 	thread_t thread_run(threadfunc_t func, void* p, int priority)
 	{
-		void* argp[2];
+		// the new thread may start after this returns, so its arguments cannot live on our stack
+		void** argp = static_cast<void**>(malloc(2 * sizeof(void*)));
 		sthread_t *thid = NULL;
 		argp[0] = reinterpret_cast<void*>(func);
 		argp[1] = p;
 
-		thid = sthread_create(_thread_func, &argp);
+		thid = sthread_create(_thread_func, argp);
+		if (!thid)
+		{
+			free(argp);
+			return NULL;
+		}
 		sthread_detach(thid);
 			
 		return thid;	
 	}
 
 	thread_t thread_get() { return 0; }
+	thread_sem_t thread_sem_new(int value) { return ssem_new(value); }
+	void thread_sem_free(thread_sem_t sem) { ssem_free(static_cast<ssem_t*>(sem)); }
+	void thread_sem_wait(thread_sem_t sem) { ssem_wait(static_cast<ssem_t*>(sem)); }
+	void thread_sem_signal(thread_sem_t sem) { ssem_signal(static_cast<ssem_t*>(sem)); }
 	void thread_sleep(int ms) { retro_sleep(ms); }
 	void thread_set_priority(thread_t id, int priority) { }
 
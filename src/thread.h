@@ -12,8 +12,10 @@
 #if VITA
 	#include <psp2/types.h>
 	typedef SceUID thread_t;
+	typedef SceUID thread_sem_t;
 #else
 	typedef void* thread_t;
+	typedef void* thread_sem_t;
 #endif
 
 #ifdef THREADED_RENDERER
@@ -23,6 +25,40 @@ thread_t thread_get();
 thread_t thread_run(threadfunc_t func, void* p, int priority);
 void thread_sleep(int ms);
 void thread_set_priority(thread_t id, int priority);
+void thread_memory_barrier();
+
+thread_sem_t thread_sem_new(int value);
+void thread_sem_free(thread_sem_t sem);
+void thread_sem_wait(thread_sem_t sem);
+void thread_sem_signal(thread_sem_t sem);
+
+// acquire/release accesses for flags and indices shared between two threads
+#if defined(_MSC_VER)
+#include <intrin.h>
+static inline int thread_load_acquire(volatile int *p) { return _InterlockedOr((volatile long *)p, 0); }
+static inline void thread_store_release(volatile int *p, int v) { _InterlockedExchange((volatile long *)p, v); }
+static inline int thread_exchange(volatile int *p, int v) { return _InterlockedExchange((volatile long *)p, v); }
+static inline void thread_pause()
+{
+#if defined(_M_IX86) || defined(_M_X64)
+	_mm_pause();
+#else
+	__yield();
+#endif
+}
+#else
+static inline int thread_load_acquire(volatile int *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline void thread_store_release(volatile int *p, int v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+static inline int thread_exchange(volatile int *p, int v) { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+static inline void thread_pause()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#elif defined(__arm__) || defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+#endif
 
 #endif
 